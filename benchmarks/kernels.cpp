@@ -0,0 +1,472 @@
+/*
+ * Micro-benchmarks of the math and geometry kernels which are on the hot paths of the engine:
+ * linalg operations, triangle transform and barycentric coordinates, clipping, bounds transform,
+ * Camera::project() of synthetic meshes, GJK/EPA on random convex pairs and the lighting of points in batches.
+ *
+ * Every kernel is run in batches long enough for the clock resolution (the number of calls per batch is
+ * calibrated), the result is the median and the minimum time of one call over several batches.
+ *
+ * Usage: 3dzavr_bench_kernels [--filter substring] [--output file.json]
+ *
+ * The results are printed as a table; the JSON report is written only into the --output file.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <objects/Camera.h>
+#include <components/geometry/Bounds.h>
+#include <components/geometry/Plane.h>
+#include <components/geometry/Triangle.h>
+#include <components/geometry/TriangleMesh.h>
+#include <components/physics/RigidObject.h>
+#include <components/lighting/DirectionalLight.h>
+#include <components/lighting/PointLight.h>
+#include <components/lighting/SpotLight.h>
+#include <linalg/Matrix4x4.h>
+#include <linalg/Vec2D.h>
+#include <linalg/Vec3D.h>
+#include <linalg/Vec4D.h>
+#include <utils/RadixSort.h>
+
+namespace {
+    constexpr size_t DATA_SIZE = 1024; // inputs are taken cyclically, the size should be a power of 2
+    constexpr double MIN_BATCH_SECONDS = 0.01;
+    constexpr int BATCHES = 9;
+
+    // Prevents the compiler from removing the computation of the value as unused
+    template<typename T>
+    inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static const void* volatile sink;
+        sink = &value;
+#endif
+    }
+
+    struct Kernel final {
+        std::string name;
+        // Runs the kernel the given number of times
+        std::function<void(size_t)> run;
+    };
+
+    struct Result final {
+        double medianNs;
+        double minNs;
+        size_t callsPerBatch;
+    };
+
+    double seconds(const Kernel& kernel, size_t calls) {
+        auto start = std::chrono::steady_clock::now();
+        kernel.run(calls);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    Result measure(const Kernel& kernel) {
+        size_t calls = 1;
+        while (seconds(kernel, calls) < MIN_BATCH_SECONDS) {
+            calls *= 2;
+        }
+
+        std::vector<double> times;
+        for (int i = 0; i < BATCHES; i++) {
+            times.push_back(seconds(kernel, calls) * 1e9 / static_cast<double>(calls));
+        }
+        std::sort(times.begin(), times.end());
+        return {times[times.size() / 2], times.front(), calls};
+    }
+
+    std::mt19937 rng(42);
+
+    double random(double from, double to) {
+        return std::uniform_real_distribution<double>(from, to)(rng);
+    }
+
+    Vec3D randomVec3D(double range) {
+        return Vec3D(random(-range, range), random(-range, range), random(-range, range));
+    }
+
+    Vec4D randomVec4D(double range) {
+        return Vec4D(random(-range, range), random(-range, range), random(-range, range), 1);
+    }
+
+    Matrix4x4 randomTransform() {
+        return Matrix4x4::Translation(randomVec3D(10)) * Matrix4x4::Rotation(randomVec3D(Consts::PI)) *
+               Matrix4x4::Scale(Vec3D(random(0.5, 2), random(0.5, 2), random(0.5, 2)));
+    }
+
+    Triangle randomTriangle(const Vec3D& center, double size) {
+        return Triangle({(center + randomVec3D(size)).makePoint4D(),
+                         (center + randomVec3D(size)).makePoint4D(),
+                         (center + randomVec3D(size)).makePoint4D()},
+                        {Vec3D(random(0, 1), random(0, 1), 1),
+                         Vec3D(random(0, 1), random(0, 1), 1),
+                         Vec3D(random(0, 1), random(0, 1), 1)});
+    }
+
+    template<typename T>
+    std::vector<T> generate(const std::function<T()>& generator) {
+        std::vector<T> data;
+        data.reserve(DATA_SIZE);
+        for (size_t i = 0; i < DATA_SIZE; i++) {
+            data.emplace_back(generator());
+        }
+        return data;
+    }
+
+    // Object with a mesh of random triangles around the origin: the mesh is a 'sphere' of the given radius
+    std::shared_ptr<Object> randomMeshObject(const std::string& name, size_t triangles, double radius) {
+        std::vector<Triangle> tris;
+        tris.reserve(triangles);
+        for (size_t i = 0; i < triangles; i++) {
+            tris.emplace_back(randomTriangle(randomVec3D(1).normalized() * radius, radius * 0.05));
+        }
+        auto object = std::make_shared<Object>(ObjectTag(name));
+        object->addComponent<TriangleMesh>(tris);
+        return object;
+    }
+
+    // Convex body for GJK: the hit box is the convex hull of the points of the mesh
+    std::shared_ptr<Object> randomConvexObject(const std::string& name, const Vec3D& position) {
+        std::vector<Triangle> tris;
+        for (int i = 0; i < 16; i++) {
+            tris.emplace_back(randomTriangle(Vec3D(0, 0, 0), 1));
+        }
+        auto object = std::make_shared<Object>(ObjectTag(name));
+        object->addComponent<TriangleMesh>(tris);
+        object->addComponent<RigidObject>(false);
+        object->getComponent<TransformMatrix>()->translate(position);
+        return object;
+    }
+
+    std::vector<Kernel> linalgKernels() {
+        auto vec3 = std::make_shared<std::vector<Vec3D>>(generate<Vec3D>([] { return randomVec3D(10); }));
+        auto vec4 = std::make_shared<std::vector<Vec4D>>(generate<Vec4D>([] { return randomVec4D(10); }));
+        auto matrices = std::make_shared<std::vector<Matrix4x4>>(generate<Matrix4x4>(randomTransform));
+
+        return {
+            {"Vec3D::operator+", [vec3](size_t n) {
+                const auto& v = *vec3;
+                for (size_t i = 0; i < n; i++) {
+                    keep(v[i % DATA_SIZE] + v[(i + 1) % DATA_SIZE]);
+                }
+            }},
+            {"Vec3D::dot", [vec3](size_t n) {
+                const auto& v = *vec3;
+                for (size_t i = 0; i < n; i++) {
+                    keep(v[i % DATA_SIZE].dot(v[(i + 1) % DATA_SIZE]));
+                }
+            }},
+            {"Vec3D::cross", [vec3](size_t n) {
+                const auto& v = *vec3;
+                for (size_t i = 0; i < n; i++) {
+                    keep(v[i % DATA_SIZE].cross(v[(i + 1) % DATA_SIZE]));
+                }
+            }},
+            {"Vec3D::normalized", [vec3](size_t n) {
+                const auto& v = *vec3;
+                for (size_t i = 0; i < n; i++) {
+                    keep(v[i % DATA_SIZE].normalized());
+                }
+            }},
+            {"Vec4D::operator*(double)", [vec4](size_t n) {
+                const auto& v = *vec4;
+                for (size_t i = 0; i < n; i++) {
+                    keep(v[i % DATA_SIZE] * 0.5);
+                }
+            }},
+            {"Vec4D::operator-", [vec4](size_t n) {
+                const auto& v = *vec4;
+                for (size_t i = 0; i < n; i++) {
+                    keep(v[i % DATA_SIZE] - v[(i + 1) % DATA_SIZE]);
+                }
+            }},
+            {"Matrix4x4*Vec4D", [matrices, vec4](size_t n) {
+                const auto& m = *matrices;
+                const auto& v = *vec4;
+                for (size_t i = 0; i < n; i++) {
+                    keep(m[i % DATA_SIZE] * v[(i + 1) % DATA_SIZE]);
+                }
+            }},
+            {"Matrix4x4*Vec3D", [matrices, vec3](size_t n) {
+                const auto& m = *matrices;
+                const auto& v = *vec3;
+                for (size_t i = 0; i < n; i++) {
+                    keep(m[i % DATA_SIZE] * v[(i + 1) % DATA_SIZE]);
+                }
+            }},
+            {"Matrix4x4*Matrix4x4", [matrices](size_t n) {
+                const auto& m = *matrices;
+                for (size_t i = 0; i < n; i++) {
+                    keep(m[i % DATA_SIZE] * m[(i + 1) % DATA_SIZE]);
+                }
+            }},
+            {"Matrix4x4::inverse", [matrices](size_t n) {
+                const auto& m = *matrices;
+                for (size_t i = 0; i < n; i++) {
+                    keep(m[i % DATA_SIZE].inverse());
+                }
+            }},
+        };
+    }
+
+    std::vector<Kernel> geometryKernels() {
+        auto triangles = std::make_shared<std::vector<Triangle>>(
+                generate<Triangle>([] { return randomTriangle(Vec3D(0, 0, 0), 10); }));
+        auto matrices = std::make_shared<std::vector<Matrix4x4>>(generate<Matrix4x4>(randomTransform));
+        auto points = std::make_shared<std::vector<Vec2D>>(
+                generate<Vec2D>([] { return Vec2D(random(-10, 10), random(-10, 10)); }));
+        auto bounds = std::make_shared<std::vector<Bounds>>(
+                generate<Bounds>([] { return Bounds{randomVec3D(10), randomVec3D(5)}; }));
+
+        // Triangles crossing the plane z = 0, so every clip() really cuts the polygon
+        auto polygons = std::make_shared<std::vector<std::vector<std::pair<Vec3D, Vec3D>>>>();
+        for (size_t i = 0; i < DATA_SIZE; i++) {
+            polygons->push_back({{Vec3D(random(-1, 1), random(-1, 1), random(-1, -0.1)), Vec3D(0, 0, 1)},
+                                 {Vec3D(random(-1, 1), random(-1, 1), random(0.1, 1)), Vec3D(1, 0, 1)},
+                                 {Vec3D(random(-1, 1), random(-1, 1), random(0.1, 1)), Vec3D(0, 1, 1)}});
+        }
+        auto plane = std::make_shared<Plane>(Vec3D(0, 0, 1), Vec3D(0, 0, 0));
+
+        return {
+            {"Triangle::operator*", [triangles, matrices](size_t n) {
+                const auto& t = *triangles;
+                const auto& m = *matrices;
+                for (size_t i = 0; i < n; i++) {
+                    keep(t[i % DATA_SIZE] * m[(i + 1) % DATA_SIZE]);
+                }
+            }},
+            {"Triangle::abgBarycCoord", [triangles, points](size_t n) {
+                const auto& t = *triangles;
+                const auto& p = *points;
+                for (size_t i = 0; i < n; i++) {
+                    keep(t[i % DATA_SIZE].abgBarycCoord(p[(i + 1) % DATA_SIZE]));
+                }
+            }},
+            {"Plane::clip", [polygons, plane](size_t n) {
+                std::vector<std::pair<Vec3D, Vec3D>> input;
+                std::vector<std::pair<Vec3D, Vec3D>> output;
+                input.reserve(9);
+                output.reserve(9);
+                for (size_t i = 0; i < n; i++) {
+                    const auto& polygon = (*polygons)[i % DATA_SIZE];
+                    input.assign(polygon.begin(), polygon.end());
+                    output.clear();
+                    plane->clip(input, output);
+                    keep(output.data());
+                }
+            }},
+            {"Bounds::operator*", [bounds, matrices](size_t n) {
+                const auto& b = *bounds;
+                const auto& m = *matrices;
+                for (size_t i = 0; i < n; i++) {
+                    keep(b[i % DATA_SIZE] * m[(i + 1) % DATA_SIZE]);
+                }
+            }},
+        };
+    }
+
+    Kernel projectKernel(const std::string& name, size_t triangles, const Vec3D& position) {
+        auto camera = std::make_shared<Camera>();
+        camera->init(Consts::STANDARD_SCREEN_WIDTH, Consts::STANDARD_SCREEN_HEIGHT);
+
+        auto mesh = randomMeshObject(name, triangles, 5);
+        mesh->getComponent<TransformMatrix>()->translate(position);
+
+        return {name, [camera, mesh](size_t n) {
+            auto triangleMesh = mesh->getComponent<TriangleMesh>();
+            // The same as Engine does: projection into a frame arena which is reset every frame
+            FrameArena arena;
+            for (size_t i = 0; i < n; i++) {
+                DrawList drawList{ArenaAllocator<ProjectedTriangle>(&arena)};
+                keep(camera->project(*triangleMesh, drawList));
+                drawList = DrawList(ArenaAllocator<ProjectedTriangle>(&arena));
+                arena.reset();
+            }
+        }};
+    }
+
+    std::vector<Kernel> physicsKernels() {
+        constexpr size_t PAIRS = 64;
+
+        // Distances between the centers are random, so about a half of the pairs collide
+        auto pairs = std::make_shared<std::vector<std::pair<std::shared_ptr<RigidObject>, std::shared_ptr<RigidObject>>>>();
+        auto objects = std::make_shared<std::vector<std::shared_ptr<Object>>>();
+        for (size_t i = 0; i < PAIRS; i++) {
+            auto a = randomConvexObject("a" + std::to_string(i), Vec3D(0, 0, 0));
+            auto b = randomConvexObject("b" + std::to_string(i), randomVec3D(1).normalized() * random(0.5, 2.5));
+            objects->push_back(a);
+            objects->push_back(b);
+            pairs->emplace_back(a->getComponent<RigidObject>(), b->getComponent<RigidObject>());
+        }
+
+        auto colliding = std::make_shared<std::vector<std::pair<size_t, Simplex>>>();
+        for (size_t i = 0; i < PAIRS; i++) {
+            auto [collision, simplex] = (*pairs)[i].first->checkGJKCollision((*pairs)[i].second);
+            if (collision) {
+                colliding->emplace_back(i, simplex);
+            }
+        }
+
+        return {
+            {"RigidObject::checkGJKCollision", [pairs, objects](size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    auto& [a, b] = (*pairs)[i % PAIRS];
+                    keep(a->checkGJKCollision(b).first);
+                }
+            }},
+            {"RigidObject::EPA", [pairs, colliding](size_t n) {
+                if (colliding->empty()) {
+                    return;
+                }
+                for (size_t i = 0; i < n; i++) {
+                    auto& [pair, simplex] = (*colliding)[i % colliding->size()];
+                    keep(pairs->at(pair).first->EPA(simplex, pairs->at(pair).second).depth);
+                }
+            }},
+        };
+    }
+
+    // Sort of the transparent draw list: the keys are depths with the index of the record
+    std::vector<Kernel> sortKernels(size_t size) {
+        auto depths = std::make_shared<std::vector<float>>();
+        for (size_t i = 0; i < size; i++) {
+            depths->push_back(static_cast<float>(random(0, 3)));
+        }
+        std::string suffix = " (" + std::to_string(size / 1000) + "k keys)";
+
+        return {
+            {"radixSort" + suffix, [depths](size_t n) {
+                std::vector<uint64_t> keys(depths->size());
+                std::vector<uint64_t> buffer(depths->size());
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t j = 0; j < keys.size(); j++) {
+                        keys[j] = makeSortKey(~sortableFloat((*depths)[j]), static_cast<uint32_t>(j));
+                    }
+                    radixSort(keys.data(), buffer.data(), keys.size());
+                    keep(keys.front());
+                }
+            }},
+            {"std::sort" + suffix, [depths](size_t n) {
+                std::vector<std::pair<float, uint32_t>> keys(depths->size());
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t j = 0; j < keys.size(); j++) {
+                        keys[j] = {(*depths)[j], static_cast<uint32_t>(j)};
+                    }
+                    std::sort(keys.begin(), keys.end(), [](const auto& k1, const auto& k2) { return k1.first > k2.first; });
+                    keep(keys.front());
+                }
+            }},
+        };
+    }
+
+    /*
+     * Lighting of the same points by a directional, a point and a spot light, split in batches of the given size:
+     * a batch of 1 is a pixel lit alone, 3 is a triangle, 4 is a quad, 64 is a span or a run of triangles.
+     */
+    std::vector<Kernel> lightingKernels(size_t points) {
+        auto lights = std::make_shared<std::vector<std::shared_ptr<Object>>>();
+        for (auto&& [name, light] : std::initializer_list<std::pair<std::string, std::function<void(Object&)>>>{
+                {"directional", [](Object& obj) { obj.addComponent<DirectionalLight>(Vec3D(1, -1, -1), Color::WHITE, 1.5); }},
+                {"point", [](Object& obj) { obj.addComponent<PointLight>(Vec3D(0, 2, 0), Color::LIGHT_YELLOW, 2); }},
+                {"spot", [](Object& obj) { obj.addComponent<SpotLight>(Vec3D(3, 3, 3), Vec3D(0, -1, 0)); }}}) {
+            auto obj = std::make_shared<Object>(ObjectTag(name));
+            light(*obj);
+            obj->getComponent<LightSource>()->prepare();
+            lights->push_back(obj);
+        }
+
+        auto positions = std::make_shared<std::vector<Vec3D>>();
+        auto normals = std::make_shared<std::vector<Vec3D>>();
+        for (size_t i = 0; i < points; i++) {
+            positions->push_back(randomVec3D(5));
+            normals->push_back(randomVec3D(1).normalized());
+        }
+
+        std::vector<Kernel> result;
+        for (size_t batchSize : {1, 3, 4, 64}) {
+            std::string name = "LightingBatch (" + std::to_string(points) + " points, " + std::to_string(batchSize) + " per batch)";
+            result.push_back({name, [lights, positions, normals, batchSize](size_t n) {
+                LightingBatch batch;
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t from = 0; from < positions->size(); from += batchSize) {
+                        size_t to = std::min(from + batchSize, positions->size());
+                        batch.clear();
+                        for (size_t j = from; j < to; j++) {
+                            batch.add((*positions)[j], (*normals)[j], 0);
+                        }
+                        for (const auto& light : *lights) {
+                            light->getComponent<LightSource>()->illuminate(batch);
+                        }
+                        keep(batch.r[0]);
+                    }
+                }
+            }});
+        }
+        return result;
+    }
+
+    std::vector<Kernel> kernels() {
+        std::vector<Kernel> result;
+        for (auto&& group : {linalgKernels(), geometryKernels(), physicsKernels(), sortKernels(20000), sortKernels(200000),
+                             lightingKernels(192)}) {
+            result.insert(result.end(), group.begin(), group.end());
+        }
+        // The mesh completely in front of the camera, and the one crossing the near and side planes
+        result.push_back(projectKernel("Camera::project (10k triangles, inside)", 10000, Vec3D(0, 0, 20)));
+        result.push_back(projectKernel("Camera::project (10k triangles, clipped)", 10000, Vec3D(3, 0, 2)));
+        return result;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string filter;
+    std::string output;
+
+    for (int i = 1; i < argc; i += 2) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--filter") {
+            filter = argv[i + 1];
+        } else if (i + 1 < argc && arg == "--output") {
+            output = argv[i + 1];
+        } else {
+            std::cerr << "Usage: 3dzavr_bench_kernels [--filter substring] [--output file.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"build\": \"" << Consts::BUILD_INFO << "\",\n  \"kernels\": [";
+
+    bool first = true;
+    for (const auto& kernel : kernels()) {
+        if (!filter.empty() && kernel.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        auto [medianNs, minNs, calls] = measure(kernel);
+        std::cout << kernel.name << ": median " << medianNs << " ns, min " << minNs << " ns" << std::endl;
+
+        json << (first ? "\n" : ",\n");
+        first = false;
+        json << "    {\"name\": \"" << kernel.name << "\", \"median_ns\": " << medianNs << ", \"min_ns\": " << minNs
+             << ", \"calls_per_batch\": " << calls << "}";
+    }
+    json << "\n  ]\n}\n";
+
+    if (!output.empty()) {
+        std::ofstream(output) << json.str();
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Benchmark of the mip chain generation for big (4K) textures.
+ * It compares Texture construction (the whole mip chain + transparency check)
+ * with the reference per-pixel implementation based on get_pixel()/set_pixel().
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <io/Image.h>
+#include <components/props/Texture.h>
+
+namespace {
+    constexpr uint16_t TEXTURE_SIZE = 4096;
+    constexpr int ITERATIONS = 10;
+
+    Image makeImage(const std::vector<png_byte>& pixels) {
+        Image image(TEXTURE_SIZE, TEXTURE_SIZE);
+        std::memcpy(image.data(), pixels.data(), pixels.size());
+        return image;
+    }
+
+    // The mip chain as it is computed with the generic per-pixel API
+    void referenceMipChain(const Image& image) {
+        bool isTransparent = false;
+        for (uint16_t y = 0; y < image.height(); y++) {
+            for (uint16_t x = 0; x < image.width(); x++) {
+                isTransparent |= image.get_pixel(x, y).a() != 255;
+            }
+        }
+
+        std::vector<Image> chain;
+        const Image* current = &image;
+        while (current->width() * current->height() != 1) {
+            Image next(std::max<uint16_t>(current->width() / 2, 1), std::max<uint16_t>(current->height() / 2, 1));
+            for (uint16_t y = 0; y < next.height(); y++) {
+                for (uint16_t x = 0; x < next.width(); x++) {
+                    uint16_t sum[4] = {};
+                    for (uint16_t dy = 0; dy < 2; dy++) {
+                        for (uint16_t dx = 0; dx < 2; dx++) {
+                            Color c = current->get_pixel(2 * x + dx, 2 * y + dy);
+                            for (int i = 0; i < 4; i++) {
+                                sum[i] += c[i];
+                            }
+                        }
+                    }
+                    next.set_pixel(x, y, Color(sum[0] / 4, sum[1] / 4, sum[2] / 4, sum[3] / 4));
+                }
+            }
+            chain.emplace_back(std::move(next));
+            current = &chain.back();
+        }
+    }
+
+    std::pair<double, double> measure(const std::vector<png_byte>& pixels, const std::function<void(Image&)>& func) {
+        std::vector<double> times;
+        for (int i = 0; i < ITERATIONS; i++) {
+            Image image = makeImage(pixels);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            func(image);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        return {times[times.size() / 2], times.front()};
+    }
+}
+
+int main() {
+    std::vector<png_byte> pixels(static_cast<size_t>(TEXTURE_SIZE) * TEXTURE_SIZE * 4);
+    std::mt19937 rng(42);
+    for (auto& p : pixels) {
+        p = static_cast<png_byte>(rng());
+    }
+
+    auto [textureMedian, textureMin] = measure(pixels, [](Image& image) {
+        Texture texture(image);
+    });
+    auto [referenceMedian, referenceMin] = measure(pixels, [](Image& image) {
+        referenceMipChain(image);
+    });
+
+    std::cout << "{\n"
+              << "  \"texture_size\": " << TEXTURE_SIZE << ",\n"
+              << "  \"iterations\": " << ITERATIONS << ",\n"
+              << "  \"texture_mips_ms\": {\"median\": " << textureMedian << ", \"min\": " << textureMin << "},\n"
+              << "  \"reference_mips_ms\": {\"median\": " << referenceMedian << ", \"min\": " << referenceMin << "},\n"
+              << "  \"speedup\": " << referenceMedian / textureMedian << "\n"
+              << "}" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,265 @@
+/*
+ * Frame benchmark in representative scenes. Every scene is rendered headless (without a window)
+ * for a fixed number of frames with a scripted camera path and a fixed time step, so runs on different
+ * commits are comparable. Times of the stages are taken from the profiler zones of every frame.
+ *
+ * Usage: 3dzavr_bench [--frames N] [--scene name] [--output file.json]
+ * It should be started from the root of the repository (the scenes use resources/).
+ * The times are printed as a table; the JSON report is written only into the --output file.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Engine.h>
+#include <utils/Profiler.h>
+#include <components/lighting/PointLight.h>
+#include <components/lighting/SpotLight.h>
+
+namespace {
+    constexpr int WARMUP_FRAMES = 5;
+    constexpr double FRAME_STEP = 1.0 / 60;
+
+    struct Scene final {
+        std::string name;
+        int frames;
+        std::function<void(World&, Camera&)> setup;
+        // Called after every frame with the number of the frame and the progress of the path (0..1)
+        std::function<void(World&, Camera&, int, double)> step;
+    };
+
+    void loadPastVillage(World& world) {
+        auto village = world.loadObject(ObjectTag("PastVillage"), FilePath("resources/obj/PastVillage/PastVillage.obj"));
+        village->getComponent<TransformMatrix>()->scale(Vec3D{0.01, 0.01, 0.01});
+        village->getComponent<TransformMatrix>()->translate(Vec3D{0, -0.3, -14.5});
+    }
+
+    void loadCars(World& world) {
+        for (int i = 1; i <= 8; i++) {
+            auto car = world.loadObject(
+                    ObjectTag("car" + std::to_string(i)),
+                    FilePath("resources/obj/cars/car" + std::to_string(i) + "/Car" + std::to_string(i) + ".obj"));
+            car->getComponent<TransformMatrix>()->rotate(Vec3D{0, Consts::PI, 0});
+            car->getComponent<TransformMatrix>()->translate(Vec3D(-13.5 + 3*i, -4, 13));
+        }
+    }
+
+    template<typename T, typename... Args>
+    void addLight(World& world, const std::string& name, Args&&... args) {
+        auto object = std::make_shared<Object>(ObjectTag(name));
+        object->addComponent<T>(std::forward<Args>(args)...);
+        world.add(object);
+    }
+
+    void addDefaultLights(World& world) {
+        addLight<DirectionalLight>(world, "Dir Light 1", Vec3D(1, -1, -1), Color::WHITE, 1.5);
+        addLight<PointLight>(world, "Point Light 1", Vec3D(0, 0.5, -5), Color::LIGHT_YELLOW, 2);
+        addLight<SpotLight>(world, "Spot Light 1", Vec3D(-7, 3, -12), Vec3D(0, -1, 0));
+    }
+
+    // Walk along the street of the village looking left and right
+    void walkThroughVillage(Camera& camera, int frame, double t) {
+        if (frame == 0) {
+            camera.transformMatrix()->rotateUp(Consts::PI);
+            camera.transformMatrix()->translate(Vec3D(0, 0, 5));
+        }
+        camera.transformMatrix()->translate(Vec3D(0, 0, -0.15));
+        camera.transformMatrix()->rotateUp(0.01 * std::cos(2 * Consts::PI * t));
+    }
+
+    std::vector<Scene> scenes() {
+        return {
+            {"past_village", 120,
+             [](World& world, Camera&) {
+                 loadPastVillage(world);
+                 addDefaultLights(world);
+             },
+             [](World&, Camera& camera, int frame, double t) {
+                 walkThroughVillage(camera, frame, t);
+             }},
+
+            {"cars", 120,
+             [](World& world, Camera& camera) {
+                 loadCars(world);
+                 addDefaultLights(world);
+                 camera.transformMatrix()->translate(Vec3D(0, 0, 3));
+             },
+             [](World&, Camera& camera, int, double) {
+                 // Orbit around the row of the cars
+                 camera.transformMatrix()->rotateRelativePoint(Vec3D(0, -4, 13), Vec3D(0, 2 * Consts::PI / 120, 0));
+             }},
+
+            {"many_lights", 120,
+             [](World& world, Camera&) {
+                 loadPastVillage(world);
+                 addDefaultLights(world);
+                 for (int i = 0; i < 120; i++) {
+                     addLight<PointLight>(world, "Point Light grid " + std::to_string(i),
+                                         Vec3D(-40 + (i % 10) * 8, 0.5, -60 + (i / 10) * 8), Color(255, 200, 150), 0.02);
+                 }
+             },
+             [](World&, Camera& camera, int frame, double t) {
+                 walkThroughVillage(camera, frame, t);
+             }},
+
+            // Collisions of 1000 objects are slow, so the scene is shorter
+            {"physics_pile", 30,
+             [](World& world, Camera& camera) {
+                 auto floor = std::make_shared<Object>(ObjectTag("floor"));
+                 floor->addComponent<RigidObject>();
+                 floor->addComponent<TriangleMesh>(TriangleMesh::Cube(1));
+                 floor->getComponent<TransformMatrix>()->scale(Vec3D(40, 1, 40));
+                 floor->getComponent<TransformMatrix>()->translate(Vec3D(0, -1, 20));
+                 world.add(floor);
+
+                 // 10x10x10 cubes falling on the floor
+                 for (int i = 0; i < 1000; i++) {
+                     auto cube = std::make_shared<Object>(ObjectTag("cube_" + std::to_string(i)));
+                     auto rigidObject = cube->addComponent<RigidObject>();
+                     rigidObject->setCollision(true);
+                     rigidObject->setAcceleration(Vec3D(0, -9.8, 0));
+                     cube->addComponent<TriangleMesh>(TriangleMesh::Cube(0.5));
+                     cube->getComponent<TransformMatrix>()->translate(
+                             Vec3D(-4.5 + (i % 10), 1 + (i / 100) * 0.75, 15 + ((i / 10) % 10)));
+                     world.add(cube);
+                 }
+                 addLight<DirectionalLight>(world, "Dir Light 1", Vec3D(1, -1, 1), Color::WHITE, 1.5);
+                 camera.transformMatrix()->translate(Vec3D(0, 4, 0));
+             },
+             [](World&, Camera& camera, int, double) {
+                 camera.transformMatrix()->rotateLeft(0.002);
+             }},
+
+            {"ray_casts", 120,
+             [](World& world, Camera&) {
+                 loadPastVillage(world);
+                 loadCars(world);
+                 addDefaultLights(world);
+             },
+             [](World& world, Camera& camera, int frame, double t) {
+                 walkThroughVillage(camera, frame, t);
+
+                 // A fan of rays from the camera, as a game does for shooting and picking
+                 PROFILE_SCOPE("ray casts");
+                 auto transform = camera.transformMatrix();
+                 Vec3D from = transform->fullPosition();
+                 for (int i = 0; i < 64; i++) {
+                     double angle = (i - 32) * 0.02;
+                     Vec3D direction = transform->lookAt() * std::cos(angle) + transform->left() * std::sin(angle);
+                     world.rayCast(from, from + direction * 100);
+                 }
+             }},
+        };
+    }
+
+    class BenchScene final : public Engine {
+    private:
+        const Scene& _scene;
+        int _frames;
+        int _frame = 0;
+        std::map<std::string, std::vector<double>> _stageTimes;
+
+        void start() override {
+            _scene.setup(*world, *camera);
+        }
+
+        void update() override {
+            // update() is a part of the frame, so Profiler::lastFrame() is the previous one (with its update())
+            if (_frame > WARMUP_FRAMES) {
+                const auto& zones = Profiler::lastFrame();
+                for (ProfileZoneId zone = 1; zone < zones.size(); zone++) {
+                    if (zones[zone].calls > 0) {
+                        _stageTimes[Profiler::zoneName(zone)].push_back(zones[zone].seconds * 1000);
+                    }
+                }
+            }
+            if (_frame == _frames + WARMUP_FRAMES) {
+                screen->close();
+                return;
+            }
+
+            _scene.step(*world, *camera, _frame, static_cast<double>(_frame) / (_frames + WARMUP_FRAMES));
+            _frame++;
+        }
+    public:
+        BenchScene(const Scene& scene, int frames) : _scene(scene), _frames(frames) {
+            screen->setHeadless(true);
+            Time::setFrameStep(FRAME_STEP);
+        }
+
+        [[nodiscard]] const std::map<std::string, std::vector<double>>& stageTimes() const { return _stageTimes; }
+    };
+
+    double percentile(std::vector<double> values, double p) {
+        std::sort(values.begin(), values.end());
+        auto index = static_cast<size_t>(std::ceil(p * values.size()));
+        return values[std::clamp<size_t>(index, 1, values.size()) - 1];
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int frames = 0;
+    std::string onlyScene;
+    std::string output;
+
+    for (int i = 1; i < argc; i += 2) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--frames") {
+            frames = std::stoi(argv[i + 1]);
+        } else if (i + 1 < argc && arg == "--scene") {
+            onlyScene = argv[i + 1];
+        } else if (i + 1 < argc && arg == "--output") {
+            output = argv[i + 1];
+        } else {
+            std::cerr << "Usage: 3dzavr_bench [--frames N] [--scene name] [--output file.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"build\": \"" << Consts::BUILD_INFO << "\",\n  \"scenes\": [";
+
+    bool firstScene = true;
+    for (const auto& scene : scenes()) {
+        if (!onlyScene.empty() && scene.name != onlyScene) {
+            continue;
+        }
+
+        int sceneFrames = frames > 0 ? frames : scene.frames;
+        std::cerr << "3dzavr_bench: " << scene.name << " (" << sceneFrames << " frames)" << std::endl;
+
+        BenchScene bench(scene, sceneFrames);
+        bench.create();
+
+        json << (firstScene ? "\n" : ",\n");
+        firstScene = false;
+        json << "    {\"name\": \"" << scene.name << "\", \"frames\": " << sceneFrames << ", \"stages\": {";
+
+        bool firstStage = true;
+        for (const auto& [stage, times] : bench.stageTimes()) {
+            json << (firstStage ? "\n" : ",\n");
+            firstStage = false;
+            json << "      \"" << stage << "\": {\"median_ms\": " << percentile(times, 0.5)
+                 << ", \"p99_ms\": " << percentile(times, 0.99) << ", \"samples\": " << times.size() << "}";
+            std::cout << scene.name << " / " << stage << ": median " << percentile(times, 0.5) << " ms, p99 "
+                      << percentile(times, 0.99) << " ms" << std::endl;
+        }
+        json << "\n    }}";
+
+        bench.exit();
+    }
+    json << "\n  ]\n}\n";
+
+    if (!output.empty()) {
+        std::ofstream(output) << json.str();
+    }
+
+    return 0;
+}
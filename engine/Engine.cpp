@@ -1,91 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <functional>
 
 #include <Engine.h>
 #include <utils/Time.h>
+#include <utils/Profiler.h>
+#include <utils/Memory.h>
+#include <utils/RadixSort.h>
 #include <utils/ResourceManager.h>
 #include <animation/Timeline.h>
 #include <io/Keyboard.h>
 #include <io/Mouse.h>
 #include <utils/monitoring.h>
+#include <components/geometry/Occluder.h>
+#include <components/geometry/MeshInstances.h>
 
 Engine::Engine() {
     Time::init();
+    Profiler::init();
     Timeline::init();
     Keyboard::init();
     Mouse::init();
     ResourceManager::init();
 }
 
-void Engine::projectObject(const Object &object) {
+void Engine::resetDrawLists() {
+    size_t opaque = _projectedOpaqueTriangles.size();
+    size_t transparent = _projectedTranspTriangles.size();
+
+    // The lists point into the arena, so they are replaced before the reset
+    _projectedOpaqueTriangles = DrawList(ArenaAllocator<ProjectedTriangle>(&_frameArena));
+    _projectedTranspTriangles = DrawList(ArenaAllocator<ProjectedTriangle>(&_frameArena));
+    _frameArena.reset();
+    _drawMaterials.clear();
+
+    // The scene usually changes a little from frame to frame: the lists do not grow (and waste the arena)
+    _projectedOpaqueTriangles.reserve(opaque);
+    _projectedTranspTriangles.reserve(transparent);
+}
+
+void Engine::collectLights(const Object &object) {
     for(const auto& [objTag, obj] : object) {
+        if(obj->numberOfAttached() > 0) {
+            collectLights(*obj);
+        }
+
+        auto lightSource = obj->getComponent<LightSource>();
+        if(lightSource) {
+            lightSource->prepare();
+            _lightSources.emplace_back(lightSource);
+            _lightBounds.emplace_back(lightSource->bounds());
+        }
+    }
+}
+
+size_t Engine::cullLights(const Bounds &bounds) {
+    if(_numObjectLights == _objectLights.size()) {
+        _objectLights.emplace_back();
+    }
+    auto& lights = _objectLights[_numObjectLights];
+    lights.clear();
+
+    // We check the bounding sphere of the mesh in the world space against the bounds of every light
+    const auto& [center, extents] = bounds;
+    double radius = extents.abs();
+
+    for(size_t i = 0; i < _lightSources.size(); i++) {
+        if(_lightBounds[i].intersects(center, radius)) {
+            lights.emplace_back(_lightSources[i]);
+        }
+    }
+
+    return _numObjectLights++;
+}
+
+void Engine::collectVisible(const Object &object, uint8_t planes) {
+    for(const auto& [objTag, obj] : object) {
+
+        // The whole subtree is skipped when its bounds are outside the frustum.
+        // Planes which have the subtree completely inside are not tested again for the objects below.
+        uint8_t subtreePlanes = planes;
+        if(planes != 0 && obj->isSubtreeBounded()) {
+            auto bounds = obj->subtreeBounds();
+            if(!bounds) {
+                // Nothing to draw here
+                continue;
+            }
+            auto transformMatrix = obj->getComponent<TransformMatrix>();
+            auto crossed = camera->frustumTest(transformMatrix ? *bounds*transformMatrix->fullModel() : *bounds, planes);
+            if(!crossed) {
+                _renderStats.subtreesFrustumCulled++;
+                continue;
+            }
+            subtreePlanes = *crossed;
+        }
 
-        std::shared_ptr<Group> subGroup = std::dynamic_pointer_cast<Group>(obj);
         if(obj->numberOfAttached() > 0) {
-            // We need to recursively continue to project for attached objects
-            projectObject(*obj);
+            // We need to recursively continue to collect for attached objects
+            collectVisible(*obj, subtreePlanes);
         }
 
         auto triangleMesh = obj->getComponent<TriangleMesh>();
-        if(triangleMesh) {
-            auto projected = camera->project(*triangleMesh);
-            std::shared_ptr<Material> material = triangleMesh->getMaterial();
-            bool isTransparent = material->isTransparent();
-
-            if(!isTransparent) {
-                for(const auto& [projectedTriangle, triangle]: projected) {
-                    _projectedOpaqueTriangles.emplace_back(projectedTriangle, triangle, material.get());
-                }
+        if(triangleMesh && triangleMesh->isVisible()) {
+            Matrix4x4 model = triangleMesh->getComponent<TransformMatrix>()->fullModel();
+            auto levelOfDetail = obj->getComponent<LevelOfDetail>();
+            auto instances = obj->getComponent<MeshInstances>();
+
+            if(!instances) {
+                addVisibleMesh(*triangleMesh, levelOfDetail.get(), {model, subtreePlanes}, false);
             } else {
-                for(const auto& [projectedTriangle, triangle]: projected) {
-                    _projectedTranspTriangles.emplace_back(projectedTriangle, triangle, material.get());
+                for(const auto& transform : instances->transforms()) {
+                    Camera::Instance instance{model*transform, subtreePlanes};
+                    // The subtree was tested with all the instances together, now every one is tested on its own
+                    if(subtreePlanes != 0) {
+                        auto crossed = camera->frustumTest(triangleMesh->bounds()*instance.model, subtreePlanes);
+                        if(!crossed) {
+                            _renderStats.objectsVisited++;
+                            _renderStats.objectsFrustumCulled++;
+                            continue;
+                        }
+                        instance.planes = *crossed;
+                    }
+                    addVisibleMesh(*triangleMesh, levelOfDetail.get(), instance, true);
                 }
             }
         }
 
         auto lineMesh = obj->getComponent<LineMesh>();
         if(lineMesh) {
+            if(_incrementalRendering && lineMesh->isVisible()) {
+                _dirtyRegion.addLines(*lineMesh, lineMesh->getComponent<TransformMatrix>()->fullModel());
+            }
             auto projectedLines = camera->project(*lineMesh);
             for(const auto& projectedLine: projectedLines) {
                 _projectedLines.emplace_back(projectedLine, lineMesh->getColor());
             }
         }
+    }
+}
 
-        auto lightSource = obj->getComponent<LightSource>();
-        if(lightSource) {
-            _lightSources.emplace_back(lightSource);
+void Engine::addVisibleMesh(const TriangleMesh &triangleMesh, LevelOfDetail *levelOfDetail,
+                            const Camera::Instance &instance, bool instanced) {
+    _renderStats.objectsVisited++;
+    Bounds bounds = triangleMesh.bounds()*instance.model;
+
+    const TriangleMesh* projected = &triangleMesh;
+    if(levelOfDetail) {
+        // Diameter of the bounds on the screen in pixels
+        double distance = std::max((bounds.center - _cameraPosition).abs(), Consts::EPS);
+        double screenSize = 2*bounds.extents.abs()/distance*_pixelsPerUnit;
+        // The instances share one component, so they can not keep the hysteresis state
+        auto level = instanced ? levelOfDetail->levelFor(screenSize) : levelOfDetail->select(screenSize);
+        if(level) {
+            projected = level;
+            _renderStats.objectsSimplified++;
         }
     }
+    _visibleMeshes.push_back({&triangleMesh, projected, instance, bounds});
 }
 
-void Engine::drawProjectedTriangles() {
+void Engine::rasterizeOccluders() {
+    PROFILE_SCOPE("occlusion culling");
+    _occlusionBuffer.clear(*camera, screen->renderWidth(), screen->renderHeight());
+
+    // The size of a mesh on the screen is about the radius of its bounds over the distance to them
+    _occluders.clear();
+    for(size_t i = 0; i < _visibleMeshes.size(); i++) {
+        const auto& visible = _visibleMeshes[i];
+        if(!visible.mesh->hasComponent<Occluder>() &&
+           (visible.mesh->getMaterial()->isTransparent() ||
+            visible.mesh->triangles().size() > Consts::OCCLUSION_MAX_OCCLUDER_TRIANGLES)) {
+            continue;
+        }
+        double distance = std::max((visible.bounds.center - _cameraPosition).abs(), Consts::EPS);
+        double size = visible.bounds.extents.abs() / distance;
+        if(size >= Consts::OCCLUSION_MIN_OCCLUDER_SIZE) {
+            _occluders.emplace_back(size, i);
+        }
+    }
+
+    size_t numOccluders = std::min(_occluders.size(), Consts::OCCLUSION_MAX_OCCLUDERS);
+    std::partial_sort(_occluders.begin(), _occluders.begin() + static_cast<ptrdiff_t>(numOccluders), _occluders.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    for(size_t i = 0; i < numOccluders; i++) {
+        const auto& visible = _visibleMeshes[_occluders[i].second];
+        auto occluder = visible.mesh->getComponent<Occluder>();
+        _occlusionBuffer.rasterize(occluder ? occluder->triangles() : visible.mesh->triangles(), visible.instance.model);
+    }
+    PROFILE_COUNT("occluders", static_cast<int64_t>(numOccluders));
+}
+
+void Engine::projectMeshes() {
+    for(size_t i = 0; i < _visibleMeshes.size();) {
+        // Consecutive meshes with the same triangles and material (instances or copies of one mesh)
+        // are projected with one call, the setup of the mesh is done once
+        const TriangleMesh& projected = *_visibleMeshes[i].projected;
+        const TriangleMesh& triangleMesh = *_visibleMeshes[i].mesh;
+        _instances.clear();
+        _instanceIndices.clear();
+        for(; i < _visibleMeshes.size(); i++) {
+            const auto& visible = _visibleMeshes[i];
+            if(&visible.projected->triangles() != &projected.triangles() ||
+               visible.mesh->getMaterial() != triangleMesh.getMaterial()) {
+                break;
+            }
+            if(_incrementalRendering && !_dirtyRect.intersects(_dirtyRegion.meshRect(i))) {
+                _renderStats.objectsUnchanged++;
+                continue;
+            }
+            if(_occlusionCulling && _occlusionBuffer.isOccluded(visible.bounds)) {
+                _renderStats.objectsOcclusionCulled++;
+                continue;
+            }
+            _instances.push_back(visible.instance);
+            _instanceIndices.push_back(i);
+        }
+        if(_instances.empty()) {
+            continue;
+        }
 
-    Time::startTimer("d sort triangles");
-    std::sort(_projectedTranspTriangles.begin(), _projectedTranspTriangles.end(), [](const auto& e1, const auto& e2){
-        const auto& [projT1, t1, material1] = e1;
-        const auto& [projT2, t2, material2] = e2;
+        // Triangles are projected straight into the draw list
+        Material* material = triangleMesh.getMaterial().get();
+        auto& drawList = material->isTransparent() ? _projectedTranspTriangles : _projectedOpaqueTriangles;
+        size_t first = drawList.size();
+        size_t projectedTriangles = camera->project(projected, _instances, drawList, _instanceEnds);
+        PROFILE_COUNT("triangles projected", projectedTriangles);
+        if(projectedTriangles == 0) {
+            continue;
+        }
 
-        double z1 = projT1[0].z() + projT1[1].z() + projT1[2].z();
-        double z2 = projT2[0].z() + projT2[1].z() + projT2[2].z();
-        return z1 > z2;
-    });
-    Time::stopTimer("d sort triangles");
+        auto materialIndex = static_cast<uint32_t>(_drawMaterials.size());
+        _drawMaterials.push_back(material);
+        for(size_t k = 0; k < _instances.size(); k++) {
+            size_t begin = k == 0 ? first : _instanceEnds[k - 1];
+            // Objects outside the frustum do not need the lights at all
+            if(begin == _instanceEnds[k]) {
+                continue;
+            }
+            auto lights = static_cast<uint32_t>(cullLights(_visibleMeshes[_instanceIndices[k]].bounds));
+            for(size_t t = begin; t < _instanceEnds[k]; t++) {
+                drawList[t].material = materialIndex;
+                drawList[t].lights = lights;
+            }
+        }
+    }
+}
 
-    Time::startTimer("d rasterization");
+void Engine::sortTransparentTriangles() {
+    size_t size = _projectedTranspTriangles.size();
+    if (size < 2) {
+        return;
+    }
+
+    // Far triangles are drawn first. 1/w is linear in the inverse view-space depth and keeps its precision
+    // far from the camera (unlike the non-linear depth, which is close to 1 there), so the key is the sum of invW:
+    // ascending invW is descending distance
+    ArenaVector<uint64_t> keys{ArenaAllocator<uint64_t>(&_frameArena)};
+    keys.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        const auto& triangle = _projectedTranspTriangles[i];
+        keys.push_back(makeSortKey(sortableFloat(triangle[0].invW + triangle[1].invW + triangle[2].invW), static_cast<uint32_t>(i)));
+    }
+    ArenaVector<uint64_t> buffer(size, ArenaAllocator<uint64_t>(&_frameArena));
+    radixSort(keys.data(), buffer.data(), size);
+
+    // The records are moved only once, in the sorted order
+    DrawList sorted{ArenaAllocator<ProjectedTriangle>(&_frameArena)};
+    sorted.reserve(size);
+    for (uint64_t key : keys) {
+        sorted.push_back(_projectedTranspTriangles[static_cast<uint32_t>(key)]);
+    }
+    _projectedTranspTriangles = std::move(sorted);
+}
+
+void Engine::drawProjectedTriangles() {
+
+    // Order independent transparency does not depend on the order of the triangles
+    if (!screen->orderIndependentTransparency()) {
+        PROFILE_SCOPE("sort triangles");
+        sortTransparentTriangles();
+    }
+
+    PROFILE_SCOPE("rasterization");
     auto cameraPosition = camera->transformMatrix()->fullPosition();
     // Draw opaque (non-transparent) triangles
-    for (const auto& [projectedTriangle, triangle, material]: _projectedOpaqueTriangles) {
-        screen->drawTriangleWithLighting(projectedTriangle, triangle, _lightSources, cameraPosition, material);
-    }
+    screen->drawTrianglesWithLighting(_projectedOpaqueTriangles, _objectLights, _drawMaterials, cameraPosition);
     // Draw transparent triangles
-    for (const auto& [projectedTriangle, triangle, material]: _projectedTranspTriangles) {
-        screen->drawTriangleWithLighting(projectedTriangle, triangle, _lightSources, cameraPosition, material);
-    }
+    screen->drawTrianglesWithLighting(_projectedTranspTriangles, _objectLights, _drawMaterials, cameraPosition);
+    screen->resolveTransparency();
     // Draw lines
     for (const auto& [line, color]: _projectedLines) {
         screen->drawLine(line, color);
     }
+}
 
-    Time::stopTimer("d rasterization");
+ScreenRect Engine::findDirtyRect() {
+    PROFILE_SCOPE("dirty region");
+    _dirtyRegion.begin(*camera, screen->renderWidth(), screen->renderHeight(), screen->settingsVersion());
+    for(const auto& lightSource : _lightSources) {
+        _dirtyRegion.addLight(*lightSource);
+    }
+    collectVisible(*world);
+    for(const auto& visible : _visibleMeshes) {
+        _dirtyRegion.addMesh(*visible.mesh, *visible.projected, visible.instance.model, visible.bounds);
+    }
+    return _dirtyRegion.finish();
 }
 
 int Engine::handleSDLEvents() {
@@ -121,7 +343,12 @@ void Engine::create(uint16_t screenWidth, uint16_t screenHeight, const Color& ba
 
     screen->setDepthTest(true);
 
+    // The rest of the screen is the panel of the editor
+    screen->setViewport(screenWidth, screenHeight);
     camera->init(screenWidth, screenHeight);
+    screen->setLightGrid(&_lightGrid);
+    camera->setRenderStats(&_renderStats);
+    screen->setRenderStats(&_renderStats);
 
     SDL_Init(SDL_INIT_EVERYTHING);
 
@@ -130,6 +357,7 @@ void Engine::create(uint16_t screenWidth, uint16_t screenHeight, const Color& ba
     while (screen->isOpen()) {
 
         Time::update();
+        auto frameStart = std::chrono::high_resolution_clock::now();
 
         Keyboard::clear();
         Mouse::clear();
@@ -140,54 +368,144 @@ void Engine::create(uint16_t screenWidth, uint16_t screenHeight, const Color& ba
             return;
         };
 
-        // 'd' in the beginning of the name means debug.
-        // While printing debug info we will take into account only timer names witch start with 'd '
-        Time::startTimer("d all");
+        {
+            // Zones of the frame are shown in the debug info (see printDebugInfo())
+            PROFILE_SCOPE("frame");
 
-        Time::startTimer("d clear");
-        screen->clear();
-        Time::stopTimer("d clear");
+            _renderStats.reset();
+            resetDrawLists();
+            _renderStats.screenPixels = static_cast<uint64_t>(screen->renderWidth()) * screen->renderHeight();
 
-        if(_updateWorld) {
-            Time::startTimer("d animations");
-            Timeline::update();
-            Time::stopTimer("d animations");
+            {
+                PROFILE_SCOPE("clear");
+                if(_incrementalRendering) {
+                    screen->restoreScene();
+                } else {
+                    screen->clear();
+                }
+            }
 
-            Time::startTimer("d collisions");
-            world->update();
-            Time::stopTimer("d collisions");
-        }
+            if(_updateWorld) {
+                {
+                    PROFILE_SCOPE("animations");
+                    MEMORY_TAG(Animation);
+                    Timeline::update();
+                }
+                {
+                    PROFILE_SCOPE("collisions");
+                    MEMORY_TAG(Physics);
+                    world->update();
+                }
+            }
+
+            _lightSources.clear();
+            _lightBounds.clear();
+            _numObjectLights = 0;
+
+            collectLights(*world);
 
-        _lightSources.clear();
+            // Projected triangles and light lists are rebuilt every frame
+            MEMORY_TAG(DrawLists);
 
-        Time::startTimer("d projections");
-        projectObject(*world);
-        Time::stopTimer("d projections");
+            _visibleMeshes.clear();
+            _cameraPosition = camera->transformMatrix()->fullPosition();
+            _pixelsPerUnit = screen->renderHeight() / (2*std::tan(Consts::PI*camera->fov()/360));
+            if(_incrementalRendering) {
+                // The rest of the scene is restored from the previous frame
+                _dirtyRect = findDirtyRect();
+                _renderStats.pixelsRedrawn = _dirtyRect.area();
+                screen->clear(_dirtyRect);
+                screen->setScissor(_dirtyRect);
+            }
+
+            if(!_incrementalRendering || !_dirtyRect.empty()) {
+                {
+                    PROFILE_SCOPE("shadows");
+                    for(const auto& lightSource : _lightSources) {
+                        lightSource->renderShadows(*world, *camera);
+                    }
+                }
+
+                {
+                    PROFILE_SCOPE("projections");
+                    _lightGrid.build(*camera, screen->renderWidth(), screen->renderHeight(), _lightSources, _lightBounds);
+                    if(!_incrementalRendering) {
+                        collectVisible(*world);
+                    }
+                    if(_occlusionCulling) {
+                        rasterizeOccluders();
+                    }
+                    projectMeshes();
+                }
+
+                drawProjectedTriangles();
+            }
+            _projectedLines.clear();
 
-        drawProjectedTriangles();
-        _projectedOpaqueTriangles.clear();
-        _projectedTranspTriangles.clear();
-        _projectedLines.clear();
+            if(_incrementalRendering) {
+                screen->resetScissor();
+                if(!_dirtyRect.empty()) {
+                    screen->saveScene();
+                }
+            }
 
-        Time::stopTimer("d projections");
-        Time::stopTimer("d rasterization");
+            // The UI and the text are drawn over it at the full resolution
+            screen->upscale();
 
-        Time::stopTimer("d all");
+            // The game logic is a part of the frame (the same as for the dynamic resolution below)
+            {
+                PROFILE_SCOPE("update");
+                update();
+            }
+        }
+        Memory::endFrame();
+        Profiler::endFrame();
 
-        printDebugInfo();
+        {
+            MEMORY_TAG(GUI);
+            printDebugInfo();
+        }
 
-        update();
+        if(_dynamicResolution) {
+            // Waiting for the display is not a part of the frame time: it does not depend on the resolution
+            std::chrono::duration<double> frameTime = std::chrono::high_resolution_clock::now() - frameStart;
+            setRenderScale(_resolutionController.update(frameTime.count()));
+        }
 
         screen->display();
     }
 }
 
+void Engine::setRenderScale(double scale) {
+    auto width = static_cast<uint16_t>(std::lround(screen->viewportWidth()*scale));
+    auto height = static_cast<uint16_t>(std::lround(screen->viewportHeight()*scale));
+    if(width == screen->renderWidth() && height == screen->renderHeight()) {
+        return;
+    }
+    screen->setRenderResolution(width, height);
+    camera->init(screen->renderWidth(), screen->renderHeight(), camera->fov(), camera->zNear(), camera->zFar());
+}
+
+void Engine::setDynamicResolution(bool value) {
+    _dynamicResolution = value;
+    _resolutionController.reset();
+    if(screen->isOpen()) {
+        setRenderScale(value ? _resolutionController.scale() : 1.0);
+    }
+}
+
+void Engine::setIncrementalRendering(bool value) {
+    _incrementalRendering = value;
+    _dirtyRegion.invalidate();
+}
+
 void Engine::exit() {
     if (screen->isOpen()) {
         screen->close();
     }
 
     Time::free();
+    Profiler::free();
     Timeline::free();
     Keyboard::free();
     Mouse::free();
@@ -220,43 +538,100 @@ void Engine::printDebugInfo() {
         //Process info:
         auto res = getProcessSizeMB();
         screen->drawText("Process size: " + std::to_string(res) + " MB", 10, (shift++)*h + offset);
+        if (Memory::TRACKING) {
+            screen->drawText("Allocations: " + std::to_string(Memory::lastFrameAllocations()) + " per frame (" +
+                             std::to_string(Memory::lastFrameBytes() / 1024) + " KB)", 10, (shift++)*h + offset);
+            for (size_t i = 0; i < Memory::TAGS; i++) {
+                auto tag = static_cast<MemoryTag>(i);
+                const auto& memory = Memory::lastFrame(tag);
+                screen->drawText("  " + std::string(Memory::tagName(tag)) + ": " +
+                                 std::to_string(memory.bytes / 1024) + " KB, " +
+                                 std::to_string(memory.frameAllocations) + " per frame", 10, (shift++)*h + offset);
+            }
+        }
+        shift++;
+
+        // Renderer stats:
+        const auto& stats = _renderStats;
+        screen->drawText("Objects: " + std::to_string(stats.objectsVisited) + " (culled " +
+                         std::to_string(stats.objectsFrustumCulled) + ", subtrees culled " +
+                         std::to_string(stats.subtreesFrustumCulled) + ", occluded " +
+                         std::to_string(stats.objectsOcclusionCulled) + ", simplified " +
+                         std::to_string(stats.objectsSimplified) + ", unchanged " +
+                         std::to_string(stats.objectsUnchanged) + ")", 10, (shift++)*h + offset);
+        screen->drawText("Triangles: " + std::to_string(stats.trianglesEmitted) + " (backface " +
+                         std::to_string(stats.trianglesBackfaceCulled) + ", clipped " +
+                         std::to_string(stats.trianglesClipped) + ")", 10, (shift++)*h + offset);
+        screen->drawText("Pixels: " + std::to_string(stats.pixelsWritten) + " / " + std::to_string(stats.pixelsTested) +
+                         " (overdraw " + std::to_string(stats.overdraw()).substr(0, 4) + ")", 10, (shift++)*h + offset);
+        if (_incrementalRendering) {
+            screen->drawText("Pixels redrawn: " + std::to_string(stats.pixelsRedrawn) + " / " +
+                             std::to_string(stats.screenPixels), 10, (shift++)*h + offset);
+        }
+        screen->drawText("Lights evaluated: " + std::to_string(stats.lightsEvaluated), 10, (shift++)*h + offset);
+        screen->drawText("Resolution: " + std::to_string(screen->renderWidth()) + "x" +
+                         std::to_string(screen->renderHeight()), 10, (shift++)*h + offset);
+
+        std::string mips = "Texture samples:";
+        size_t lastMip = 0;
+        for (size_t i = 0; i < RenderStats::MIP_LEVELS; i++) {
+            if (stats.textureSamples[i] > 0) {
+                lastMip = i;
+            }
+        }
+        for (size_t i = 0; i <= lastMip; i++) {
+            mips += " " + std::to_string(stats.textureSamples[i]);
+        }
+        screen->drawText(mips, 10, (shift++)*h + offset);
 
-        // timers:
+        // profiler zones of the last frame:
         int timerWidth = 150;
         int plotWidth = 50;
         float xPos = 10;
-        float yPos = 220;
+        float yPos = (shift + 1)*h + offset;
         int height = 14;
 
-        double totalTime = Time::elapsedTimerSeconds("d all");
+        const auto& zones = Profiler::lastFrame();
+        ProfileZoneId frameZone = ProfileZone<"frame">::id;
+        double totalTime = Profiler::lastFrameSeconds(frameZone);
         double timeSum = 0;
         int i = 0;
 
-        if(!Time::timers()) {
+        if(totalTime <= 0) {
             return;
         }
-        for (auto &[timerName, timer] : Time::timers()->get()) {
-            int width = timerWidth * timer.elapsedSeconds() / totalTime;
 
-            if (timerName == "d all" || timerName[0] != 'd') {
-                continue;
-            }
+        // Nested zones are shown under their parents with an indent
+        std::function<void(ProfileZoneId, int)> drawZones = [&](ProfileZoneId parent, int level) {
+            for (ProfileZoneId zone = 1; zone < zones.size(); zone++) {
+                const auto& stats = zones[zone];
+                if (stats.calls == 0 || stats.parent != parent) {
+                    continue;
+                }
 
-            _histResources[timerName].emplace_back(Time::time(), timer.elapsedSeconds());
+                int width = timerWidth * stats.seconds / totalTime;
+                std::string zoneName = Profiler::zoneName(zone);
 
-            screen->drawStrokeRectangle(xPos, yPos + (1.5*height)*i, width, height,
-                                        Color(width * 255 / timerWidth, 255 - width * 255 / timerWidth, 0, 255));
+                _histResources[zoneName].emplace_back(Time::time(), stats.seconds);
 
-            screen->drawText(
-                    timerName.substr(2, timerName.size()) + " (" +
-                    std::to_string((int) (100 * timer.elapsedSeconds() / totalTime)) + "%)",
-                    xPos+5, yPos + (1.5*height)*i, Color::BLACK, 12);
+                screen->drawStrokeRectangle(xPos + 10*level, yPos + (1.5*height)*i, width, height,
+                                            Color(width * 255 / timerWidth, 255 - width * 255 / timerWidth, 0, 255));
 
-            screen->drawPlot(_histResources[timerName], xPos + timerWidth, yPos + (1.5*height)*i, plotWidth, height);
+                screen->drawText(
+                        zoneName + " (" +
+                        std::to_string((int) (100 * stats.seconds / totalTime)) + "%)",
+                        xPos + 10*level + 5, yPos + (1.5*height)*i, Color::BLACK, 12);
 
-            i++;
-            timeSum += timer.elapsedSeconds();
-        }
+                screen->drawPlot(_histResources[zoneName], xPos + timerWidth + 10*level, yPos + (1.5*height)*i, plotWidth, height);
+
+                i++;
+                if (level == 0) {
+                    timeSum += stats.seconds;
+                }
+                drawZones(zone, level + 1);
+            }
+        };
+        drawZones(frameZone, 0);
 
         int width = timerWidth * (totalTime - timeSum) / totalTime;
         screen->drawStrokeRectangle(xPos, yPos + (1.5*height)*i, width, height,
@@ -265,8 +640,8 @@ void Engine::printDebugInfo() {
         screen->drawText("all other stuff (" + std::to_string((int) (100 * (totalTime - timeSum) / totalTime)) + "%)",
                          xPos+5, yPos + (1.5*height)*i, Color(0, 0, 0, 150), 12);
 
-        _histResources["d other"].emplace_back(Time::time(), totalTime - timeSum);
-        screen->drawPlot(_histResources["d other"], xPos + timerWidth, yPos + (1.5*height)*i, 50, height);
+        _histResources["other"].emplace_back(Time::time(), totalTime - timeSum);
+        screen->drawPlot(_histResources["other"], xPos + timerWidth, yPos + (1.5*height)*i, 50, height);
 
         // Draw a plot of fps
 
@@ -2,8 +2,12 @@
 #define ENGINE_ENGINE_H
 
 #include <io/Screen.h>
+#include <io/OcclusionBuffer.h>
+#include <io/DirtyRegion.h>
 #include <utils/Log.h>
+#include <utils/ResolutionController.h>
 #include <objects/Camera.h>
+#include <components/geometry/LevelOfDetail.h>
 #include <World.h>
 
 /*
@@ -16,14 +20,81 @@ class Engine {
 private:
     bool _updateWorld = true;
 
-    std::vector<std::tuple<Triangle, Triangle, Material*>> _projectedOpaqueTriangles;
-    std::vector<std::tuple<Triangle, Triangle, Material*>> _projectedTranspTriangles;
+    // Memory of the draw lists: it is reset in the beginning of every frame
+    FrameArena _frameArena;
+    /*
+     * ProjectedTriangle::material is the index in _drawMaterials (one entry per projected mesh),
+     * ProjectedTriangle::lights is the index of the light list of the object in _objectLights
+     */
+    DrawList _projectedOpaqueTriangles;
+    DrawList _projectedTranspTriangles;
+    std::vector<Material*> _drawMaterials;
     std::vector<std::pair<Line, Color>> _projectedLines;
 
     std::vector<std::shared_ptr<LightSource>> _lightSources;
-
-    void projectObject(const Object& object);
+    std::vector<LightBounds> _lightBounds;
+
+    /*
+     * Lists of lights which can illuminate the objects, built once per frame.
+     * Lists are reused from frame to frame (only the first _numObjectLights are valid) to reduce allocations.
+     */
+    std::vector<std::vector<std::shared_ptr<LightSource>>> _objectLights;
+    size_t _numObjectLights = 0;
+
+    LightGrid _lightGrid;
+
+    // Meshes which passed the frustum culling of the subtrees, in the order of the traversal
+    struct VisibleMesh final {
+        const TriangleMesh* mesh;
+        const TriangleMesh* projected; // the mesh or its level of detail
+        Camera::Instance instance;     // the model matrix and the frustum planes the mesh may cross
+        Bounds bounds;                 // in the world space
+    };
+    std::vector<VisibleMesh> _visibleMeshes;
+    // One batch of projectMeshes(): the instances and their indices in _visibleMeshes
+    std::vector<Camera::Instance> _instances;
+    std::vector<size_t> _instanceIndices;
+    std::vector<size_t> _instanceEnds;
+    // For the sizes of the meshes on the screen
+    Vec3D _cameraPosition;
+    double _pixelsPerUnit = 1; // at the distance 1
+
+    bool _occlusionCulling = true;
+    OcclusionBuffer _occlusionBuffer;
+    std::vector<std::pair<double, size_t>> _occluders; // (size on the screen, index in _visibleMeshes)
+
+    // Filled by the camera and the screen during the frame
+    RenderStats _renderStats;
+
+    bool _dynamicResolution = false;
+    ResolutionController _resolutionController;
+
+    bool _incrementalRendering = false;
+    DirtyRegion _dirtyRegion;
+    // The part of the screen which is drawn in this frame (incremental rendering)
+    ScreenRect _dirtyRect;
+
+    void resetDrawLists();
+    void collectLights(const Object& object);
+    // bounds are the world space bounds of the mesh
+    size_t cullLights(const Bounds& bounds);
+    /*
+     * Collects the meshes of the objects attached to the object (line meshes are projected right away).
+     * The planes are the frustum planes their bounds may cross.
+     */
+    void collectVisible(const Object& object, uint8_t planes = Camera::ALL_PLANES);
+    void addVisibleMesh(const TriangleMesh& triangleMesh, LevelOfDetail* levelOfDetail,
+                        const Camera::Instance& instance, bool instanced);
+    // Fills the occlusion buffer with the biggest visible meshes (or their Occluder components)
+    void rasterizeOccluders();
+    void projectMeshes();
+    // Back to front, so the transparent triangles are blended in the right order (unless it is order independent)
+    void sortTransparentTriangles();
     void drawProjectedTriangles();
+    // Compares the frame with the previous one: the lights are collected, the visible meshes are collected here
+    ScreenRect findDirtyRect();
+    // The render resolution of the screen and the camera are the viewport scaled by the scale
+    void setRenderScale(double scale);
 
     // For debug purposes
     bool _showDebugInfo = Consts::SHOW_DEBUG_INFO;
@@ -47,6 +118,23 @@ protected:
 
     void setUpdateWorld(bool value) { _updateWorld = value; }
 
+    [[nodiscard]] bool occlusionCulling() const { return _occlusionCulling; }
+    void setOcclusionCulling(bool value) { _occlusionCulling = value; }
+
+    // The scene is rendered at the resolution which keeps the frame in the budget of the resolution controller
+    [[nodiscard]] bool dynamicResolution() const { return _dynamicResolution; }
+    void setDynamicResolution(bool value);
+    [[nodiscard]] ResolutionController& resolutionController() { return _resolutionController; }
+
+    /*
+     * Only the part of the screen which changed since the previous frame is drawn (see DirtyRegion),
+     * a frame without changes does not project and rasterize anything. It pays off for static camera views.
+     */
+    [[nodiscard]] bool incrementalRendering() const { return _incrementalRendering; }
+    void setIncrementalRendering(bool value);
+    // The next frame is drawn completely (for the changes which are not tracked, like textures)
+    void invalidateFrame() { _dirtyRegion.invalidate(); }
+
     virtual void gui() {}
 
 public:
@@ -56,6 +144,9 @@ public:
                 const Color& background = Consts::BACKGROUND_COLOR);
 
     void exit();
+
+    // Counters of the last rendered frame
+    [[nodiscard]] const RenderStats& renderStats() const { return _renderStats; }
 };
 
 
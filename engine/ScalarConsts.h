@@ -1,6 +1,7 @@
 #ifndef ENGINE_SCALAR_CONSTS_H
 #define ENGINE_SCALAR_CONSTS_H
 
+#include <cstddef>
 #include <cstdint>
 
 namespace Consts {
@@ -13,6 +14,7 @@ namespace Consts {
 
     constexpr bool USE_LOG_FILE = true;
     constexpr bool SHOW_DEBUG_INFO = false;
+    constexpr uint32_t TRACE_CAPTURE_FRAMES = 120;
 
     constexpr double PI = 3.14159265358979323846264338327950288;
     constexpr double EPS = 0.00000000001; // 1e-11
@@ -21,6 +23,10 @@ namespace Consts {
     constexpr double LIGHTING_LOD_NEAR_DISTANCE = 5;
     constexpr double LIGHTING_LOD_FAR_DISTANCE = 10;
 
+    constexpr uint16_t DIRECTIONAL_SHADOW_MAP_SIZE = 1024;
+    constexpr uint16_t SPOT_SHADOW_MAP_SIZE = 512;
+    constexpr double SHADOW_DISTANCE = 100;
+
     constexpr unsigned int GJK_MAX_ITERATIONS = 30;
     constexpr unsigned int EPA_MAX_ITERATIONS = 30;
     constexpr double EPA_DEPTH_EPS = 0.0001; // 1e-4
@@ -29,6 +35,42 @@ namespace Consts {
     constexpr double TAP_DELAY = 0.2;
 
     constexpr int MB = 1024*1024;
+
+    // Draw lists of a usual frame fit into one block
+    constexpr size_t FRAME_ARENA_BLOCK_SIZE = 4*MB;
+
+    /*
+     * Triangles are clipped by the side planes of the frustum only when they go beyond the guard band:
+     * CLIP_GUARD_BAND half-sizes of the view from its center. The rasterizer clamps the rest to the screen.
+     */
+    constexpr double CLIP_GUARD_BAND = 4;
+
+    // Dynamic resolution (see ResolutionController): 60 fps by default, the scene goes down to a half of the viewport
+    constexpr double RESOLUTION_FRAME_BUDGET = 1.0 / 60;
+    constexpr double RESOLUTION_MIN_SCALE = 0.5;
+    // The resolution is kept while the frame takes from (1 - RESOLUTION_HEADROOM) of the budget to the whole budget
+    constexpr double RESOLUTION_HEADROOM = 0.15;
+
+    // Radix sort gives every thread at least this many keys (smaller lists are sorted in the calling thread)
+    constexpr size_t RADIX_SORT_MIN_CHUNK = 32768;
+
+    constexpr uint16_t OCCLUSION_BUFFER_WIDTH = 256;
+    constexpr uint16_t OCCLUSION_BUFFER_HEIGHT = 128;
+    // The biggest meshes on the screen are the occluders: their number and size (in triangles) are limited
+    constexpr size_t OCCLUSION_MAX_OCCLUDERS = 16;
+    constexpr size_t OCCLUSION_MAX_OCCLUDER_TRIANGLES = 2000;
+    // Radius of the bounds over the distance to them: smaller meshes hide too little to be occluders
+    constexpr double OCCLUSION_MIN_OCCLUDER_SIZE = 0.1;
+
+    // Every level of detail has LOD_REDUCTION of the triangles of the previous one and is used at the half of its size
+    constexpr size_t LOD_LEVELS = 3;
+    constexpr double LOD_REDUCTION = 0.25;
+    // Size of the bounds on the screen (in pixels) below which the first simplified level is used
+    constexpr double LOD_SCREEN_SIZE = 160;
+    // A level is changed only when the size is this fraction away from the limit (so it does not flicker)
+    constexpr double LOD_HYSTERESIS = 0.1;
+    // Meshes with fewer triangles are not simplified
+    constexpr size_t LOD_MIN_TRIANGLES = 64;
 }
 
 #endif //ENGINE_SCALAR_CONSTS_H
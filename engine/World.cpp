@@ -9,8 +9,9 @@
 
 std::shared_ptr<Group> World::loadObject(const ObjectTag &tag,
                                         const FilePath &meshFile,
-                                        const Vec3D &scale) {
-    auto obj = ResourceManager::loadTriangleMesh(tag, meshFile);
+                                        const Vec3D &scale,
+                                        bool levelsOfDetail) {
+    auto obj = ResourceManager::loadTriangleMesh(tag, meshFile, levelsOfDetail);
     obj->getComponent<TransformMatrix>()->scale(scale);
     add(obj);
 
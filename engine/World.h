@@ -21,9 +21,11 @@ public:
 
     void update();
 
+    // With levelsOfDetail far meshes are drawn simplified (see LevelOfDetail)
     std::shared_ptr<Group> loadObject(const ObjectTag &tag,
                                       const FilePath &meshFile,
-                                      const Vec3D &scale = Vec3D{1, 1, 1});
+                                      const Vec3D &scale = Vec3D{1, 1, 1},
+                                      bool levelsOfDetail = false);
 
     // std::vector<ObjectTag> skipTags is a vector of all objects we want to skip in ray casting
     TriangleMesh::IntersectionInformation rayCast(const Vec3D &from, const Vec3D &to, const std::set<ObjectTag> &skipTags = {});
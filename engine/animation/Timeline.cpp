@@ -31,7 +31,7 @@ void Timeline::deleteAnimationList(const AnimationListTag &listName) {
     if(it != _instance->_animations.end()) {
         _instance->_animations.erase(it);
     } else {
-        Log::log("Timeline::deleteAnimationList(): list '" + listName.str() + "' does not exist");
+        LOG_WARNING("Timeline::deleteAnimationList(): list '" + listName.str() + "' does not exist");
     }
 }
 
@@ -1,16 +1,25 @@
 #include "TransformMatrix.h"
 
+void TransformMatrix::setModel(const Matrix4x4 &model) {
+    _transformMatrix = model;
+
+    // The subtree bounds are in the coordinates of the object, so only the bounds of the objects above it are changed
+    if (assignedToPtr() && assignedToPtr()->attachedTo()) {
+        assignedToPtr()->attachedTo()->invalidateBounds();
+    }
+}
+
 void TransformMatrix::transform(const Matrix4x4 &t) {
-    _transformMatrix = t * _transformMatrix;
+    setModel(t * _transformMatrix);
 }
 
 void TransformMatrix::transformRelativePoint(const Vec3D &point, const Matrix4x4 &transform) {
     // translate object in the new coordinate system (connected with point)
-    _transformMatrix = Matrix4x4::Translation( -point) * _transformMatrix;
+    Matrix4x4 model = Matrix4x4::Translation( -point) * _transformMatrix;
     // transform object in the new coordinate system
-    _transformMatrix = transform * _transformMatrix;
+    model = transform * model;
     // translate object back in self connected coordinate system
-    _transformMatrix = Matrix4x4::Translation(point) * _transformMatrix;
+    setModel(Matrix4x4::Translation(point) * model);
 }
 
 void TransformMatrix::translate(const Vec3D &dv) {
@@ -15,6 +15,8 @@ private:
      */
     Vec3D _angle{0, 0, 0};
     Vec3D _angleLeftUpLookAt{0, 0, 0};
+
+    void setModel(const Matrix4x4 &model);
 public:
     TransformMatrix() = default;
     TransformMatrix(const TransformMatrix& transformMatrix) = default;
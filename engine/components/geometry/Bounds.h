@@ -5,6 +5,8 @@
 #ifndef GEOMETRY_BOUNDS_H
 #define GEOMETRY_BOUNDS_H
 
+#include <algorithm>
+
 #include "linalg/Matrix4x4.h"
 
 struct Bounds {
@@ -24,6 +26,18 @@ struct Bounds {
 
         return {newCenter, newExtents};
     }
+
+    // The smallest box which contains both boxes
+    [[nodiscard]] inline Bounds merged(const Bounds &other) const {
+        Vec3D min(std::min(center.x() - extents.x(), other.center.x() - other.extents.x()),
+                  std::min(center.y() - extents.y(), other.center.y() - other.extents.y()),
+                  std::min(center.z() - extents.z(), other.center.z() - other.extents.z()));
+        Vec3D max(std::max(center.x() + extents.x(), other.center.x() + other.extents.x()),
+                  std::max(center.y() + extents.y(), other.center.y() + other.extents.y()),
+                  std::max(center.z() + extents.z(), other.center.z() + other.extents.z()));
+
+        return {(max + min) / 2, (max - min) / 2};
+    }
 };
 
 #endif //GEOMETRY_BOUNDS_H
@@ -0,0 +1,75 @@
+#include <limits>
+
+#include <components/geometry/LevelOfDetail.h>
+#include <utils/MeshSimplifier.h>
+#include <utils/Memory.h>
+
+LevelOfDetail::LevelOfDetail(const LevelOfDetail &levelOfDetail) : Component(levelOfDetail), _current(levelOfDetail._current) {
+    for (const auto& level : levelOfDetail._levels) {
+        _levels.push_back({std::make_shared<TriangleMesh>(*level.mesh), level.screenSize});
+    }
+}
+
+void LevelOfDetail::start() {
+    if (_levels.empty() && hasComponent<TriangleMesh>()) {
+        generate();
+    }
+}
+
+void LevelOfDetail::generate(size_t levels, double reduction, double screenSize) {
+    MEMORY_TAG(Meshes);
+
+    _levels.clear();
+    _current = 0;
+
+    auto triangleMesh = getComponent<TriangleMesh>();
+    if (!triangleMesh) {
+        return;
+    }
+
+    const std::vector<Triangle>* previous = &triangleMesh->triangles();
+    for (size_t i = 0; i < levels; i++) {
+        auto target = static_cast<size_t>(static_cast<double>(previous->size()) * reduction);
+        if (target < Consts::LOD_MIN_TRIANGLES) {
+            break;
+        }
+        auto simplified = simplifyMesh(*previous, target);
+        // There is no point in a level which is almost the same as the previous one
+        if (simplified.size() > previous->size() * 9 / 10) {
+            break;
+        }
+        addLevel(std::move(simplified), screenSize);
+        previous = &_levels.back().mesh->triangles();
+        screenSize /= 2;
+    }
+}
+
+void LevelOfDetail::addLevel(std::vector<Triangle> triangles, double screenSize) {
+    auto triangleMesh = getComponent<TriangleMesh>();
+    auto mesh = std::make_shared<TriangleMesh>(triangles, triangleMesh ? triangleMesh->getMaterial() : nullptr);
+    _levels.push_back({std::move(mesh), screenSize});
+}
+
+double LevelOfDetail::limit(size_t level) const {
+    return level == 0 ? std::numeric_limits<double>::infinity() : _levels[level - 1].screenSize;
+}
+
+const TriangleMesh* LevelOfDetail::select(double screenSize) {
+    _current = std::min(_current, _levels.size());
+    while (_current > 0 && screenSize > limit(_current) * (1 + Consts::LOD_HYSTERESIS)) {
+        _current--;
+    }
+    while (_current < _levels.size() && screenSize < limit(_current + 1) * (1 - Consts::LOD_HYSTERESIS)) {
+        _current++;
+    }
+
+    return _current == 0 ? nullptr : _levels[_current - 1].mesh.get();
+}
+
+const TriangleMesh* LevelOfDetail::levelFor(double screenSize) const {
+    size_t level = 0;
+    while (level < _levels.size() && screenSize < limit(level + 1)) {
+        level++;
+    }
+    return level == 0 ? nullptr : _levels[level - 1].mesh.get();
+}
@@ -0,0 +1,60 @@
+#ifndef GEOMETRY_LEVELOFDETAIL_H
+#define GEOMETRY_LEVELOFDETAIL_H
+
+#include <memory>
+#include <vector>
+
+#include <components/geometry/TriangleMesh.h>
+
+/*
+ * Simplified versions of the TriangleMesh of the object. Engine projects the level which suits the size
+ * of the mesh on the screen: far objects do not need thousands of sub-pixel triangles.
+ * Level 0 is the TriangleMesh of the object itself, the material is always taken from it.
+ */
+class LevelOfDetail final : public Component {
+public:
+    struct Level final {
+        std::shared_ptr<TriangleMesh> mesh;
+        double screenSize; // the level is used when the mesh is smaller than this on the screen (in pixels)
+    };
+private:
+    std::vector<Level> _levels; // from the finest to the coarsest
+    size_t _current = 0;
+
+    [[nodiscard]] double limit(size_t level) const;
+public:
+    LevelOfDetail() = default;
+    // The meshes are copied (they share the triangles with the originals)
+    LevelOfDetail(const LevelOfDetail& levelOfDetail);
+
+    /*
+     * Replaces the levels with the simplifications of the TriangleMesh of the object (see simplifyMesh()):
+     * every level has `reduction` of the triangles of the previous one and is used at the half of its screen size.
+     * Stops earlier when the meshes get smaller than Consts::LOD_MIN_TRIANGLES or can not be simplified further.
+     */
+    void generate(size_t levels = Consts::LOD_LEVELS, double reduction = Consts::LOD_REDUCTION,
+                  double screenSize = Consts::LOD_SCREEN_SIZE);
+    // The levels should be added from the finest to the coarsest
+    void addLevel(std::vector<Triangle> triangles, double screenSize);
+
+    /*
+     * Chooses the level for the size of the mesh on the screen (in pixels). A level is left only when the size
+     * is Consts::LOD_HYSTERESIS beyond its limits. Returns nullptr for level 0 (the TriangleMesh of the object).
+     */
+    [[nodiscard]] const TriangleMesh* select(double screenSize);
+    // The same without the hysteresis and without changing the current level (for MeshInstances)
+    [[nodiscard]] const TriangleMesh* levelFor(double screenSize) const;
+
+    [[nodiscard]] size_t currentLevel() const { return _current; }
+    [[nodiscard]] size_t levels() const { return _levels.size() + 1; }
+    [[nodiscard]] const Level& level(size_t i) const { return _levels[i - 1]; }
+
+    [[nodiscard]] std::shared_ptr<Component> copy() const override {
+        return std::make_shared<LevelOfDetail>(*this);
+    }
+
+    // Generates the levels for the TriangleMesh of the object if there are none
+    void start() override;
+};
+
+#endif //GEOMETRY_LEVELOFDETAIL_H
@@ -36,6 +36,10 @@ void LineMesh::calculateBounds() {
             .center = (max + min) / 2,
             .extents = (max - min) / 2
     };
+
+    if (assignedToPtr()) {
+        assignedToPtr()->invalidateBounds();
+    }
 }
 
 LineMesh::LineMesh(const LineMesh &lineMesh, bool deepCopy):
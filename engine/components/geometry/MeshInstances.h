@@ -0,0 +1,70 @@
+#ifndef GEOMETRY_MESHINSTANCES_H
+#define GEOMETRY_MESHINSTANCES_H
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <components/geometry/TriangleMesh.h>
+
+/*
+ * Draws the TriangleMesh of the object at many places: every instance is a transform relative to the object.
+ * The triangles are stored once and Engine projects all the visible instances with one Camera::project() call.
+ * With this component the mesh is drawn only at the instances (add the identity to draw it at the object too).
+ * Instances are only drawn and cast shadows: ray casting and collisions see the mesh at the object itself.
+ */
+class MeshInstances final : public Component {
+private:
+    std::vector<Matrix4x4> _transforms;
+
+    void changed() {
+        if (assignedToPtr()) {
+            assignedToPtr()->invalidateBounds();
+        }
+    }
+public:
+    MeshInstances() = default;
+    explicit MeshInstances(std::vector<Matrix4x4> transforms) : _transforms(std::move(transforms)) {}
+    MeshInstances(const MeshInstances& meshInstances) = default;
+
+    // Returns the index of the instance
+    size_t add(const Matrix4x4& transform) {
+        _transforms.push_back(transform);
+        changed();
+        return _transforms.size() - 1;
+    }
+    void set(size_t i, const Matrix4x4& transform) {
+        _transforms[i] = transform;
+        changed();
+    }
+    void clear() {
+        _transforms.clear();
+        changed();
+    }
+
+    [[nodiscard]] const std::vector<Matrix4x4>& transforms() const { return _transforms; }
+    [[nodiscard]] size_t size() const { return _transforms.size(); }
+
+    // Bounds of all the instances in the space of the object (std::nullopt without instances)
+    [[nodiscard]] std::optional<Bounds> bounds(const Bounds& meshBounds) const {
+        std::optional<Bounds> result;
+        for (const auto& transform : _transforms) {
+            Bounds instanceBounds = meshBounds * transform;
+            result = result ? result->merged(instanceBounds) : instanceBounds;
+        }
+        return result;
+    }
+
+    [[nodiscard]] std::shared_ptr<Component> copy() const override {
+        return std::make_shared<MeshInstances>(*this);
+    }
+
+    void start() override {
+        if (!hasComponent<TransformMatrix>()) {
+            // This component requires to work with TransformMatrix component,
+            addComponent<TransformMatrix>();
+        }
+    }
+};
+
+#endif //GEOMETRY_MESHINSTANCES_H
@@ -0,0 +1,37 @@
+#ifndef GEOMETRY_OCCLUDER_H
+#define GEOMETRY_OCCLUDER_H
+
+#include <utility>
+#include <vector>
+
+#include <components/geometry/Triangle.h>
+#include <components/TransformMatrix.h>
+
+/*
+ * Simplified geometry of an object for the occlusion culling (see OcclusionBuffer): a few big triangles
+ * which are used instead of the visible mesh. They are in the object space and should stay inside of the
+ * visible surface, otherwise the objects behind the occluder can disappear while they are still seen.
+ */
+class Occluder final : public Component {
+private:
+    std::vector<Triangle> _tris;
+public:
+    explicit Occluder(std::vector<Triangle> triangles) : _tris(std::move(triangles)) {}
+    Occluder(const Occluder& occluder) = default;
+
+    [[nodiscard]] const std::vector<Triangle>& triangles() const { return _tris; }
+    void setTriangles(std::vector<Triangle> triangles) { _tris = std::move(triangles); }
+
+    [[nodiscard]] std::shared_ptr<Component> copy() const override {
+        return std::make_shared<Occluder>(*this);
+    }
+
+    void start() override {
+        if (!hasComponent<TransformMatrix>()) {
+            // This component requires to work with TransformMatrix component,
+            addComponent<TransformMatrix>();
+        }
+    }
+};
+
+#endif //GEOMETRY_OCCLUDER_H
@@ -4,8 +4,8 @@
 
 TriangleMesh &TriangleMesh::operator*=(const Matrix4x4 &matrix4X4) {
     std::vector<Triangle> newTriangles;
-    newTriangles.reserve(_tris.size());
-    for (auto &t : _tris) {
+    newTriangles.reserve(_tris->size());
+    for (auto &t : *_tris) {
         newTriangles.emplace_back(t * matrix4X4);
     }
     setTriangles(std::move(newTriangles));
@@ -20,12 +20,14 @@ void TriangleMesh::start() {
     }
 }
 
-TriangleMesh::TriangleMesh(const std::vector<Triangle> &tries, const std::shared_ptr<Material>& material) : _tris(tries) {
+TriangleMesh::TriangleMesh(const std::vector<Triangle> &tries, const std::shared_ptr<Material>& material) :
+_tris(std::make_shared<const std::vector<Triangle>>(tries)) {
     if(material) {
         _material = material;
     }
 
     calculateBounds();
+    calculateVertices();
 }
 
 TriangleMesh TriangleMesh::Surface(double w, double h, const std::shared_ptr<Material>& material) {
@@ -158,13 +160,16 @@ TriangleMesh TriangleMesh::ArrowTo(const Vec3D &from, const Vec3D &to, double li
 }
 
 void TriangleMesh::setTriangles(std::vector<Triangle>&& t) {
-    _tris = std::move(t);
+    // The copies which share the old triangles keep them
+    _tris = std::make_shared<const std::vector<Triangle>>(std::move(t));
     calculateBounds();
+    calculateVertices();
 }
 
 void TriangleMesh::setTriangles(const std::vector<Triangle> &t) {
-    _tris = t;
+    _tris = std::make_shared<const std::vector<Triangle>>(t);
     calculateBounds();
+    calculateVertices();
 }
 
 TriangleMesh::IntersectionInformation TriangleMesh::intersect(const Vec3D &from, const Vec3D &to) {
@@ -225,20 +230,19 @@ TriangleMesh::IntersectionInformation TriangleMesh::intersect(const Vec3D &from,
 
 void TriangleMesh::copyTriangles(const TriangleMesh &mesh, bool deepCopy) {
     if(deepCopy) {
-        _tris.reserve(mesh._tris.size());
-        for (const auto& tr : mesh._tris) {
-            _tris.push_back(tr);
-        }
+        _tris = std::make_shared<const std::vector<Triangle>>(*mesh._tris);
     } else {
         _tris = mesh._tris;
     }
+    // The vertices are immutable: even the deep copy can share them
+    _vertices = mesh._vertices;
     _bounds = mesh._bounds;
 }
 
 void TriangleMesh::calculateBounds() {
-    Vec3D min = _tris.empty() ? Vec3D() : Vec3D(_tris[0][0]);
+    Vec3D min = _tris->empty() ? Vec3D() : Vec3D((*_tris)[0][0]);
     Vec3D max = min;
-    for (const auto & t : _tris) {
+    for (const auto & t : *_tris) {
         for (int i = 0; i < 3; i++) {
             for (int j = 0; j < 3; j++) {
                 min[j] = std::min(min[j], t[i][j]);
@@ -250,6 +254,20 @@ void TriangleMesh::calculateBounds() {
         .center = (max + min) / 2,
         .extents = (max - min) / 2
     };
+
+    if (assignedToPtr()) {
+        assignedToPtr()->invalidateBounds();
+    }
+}
+
+void TriangleMesh::calculateVertices() {
+    auto vertices = std::make_shared<Vec3DBatch>();
+    for (const auto & t : *_tris) {
+        for (int i = 0; i < 3; i++) {
+            vertices->add(Vec3D(t[i]));
+        }
+    }
+    _vertices = std::move(vertices);
 }
 
 TriangleMesh::TriangleMesh(const TriangleMesh &mesh, bool deepCopy) :
@@ -4,6 +4,7 @@
 #include <utility>
 #include <vector>
 
+#include <linalg/Vec3DBatch.h>
 #include <components/geometry/Triangle.h>
 #include <components/geometry/Bounds.h>
 #include <components/TransformMatrix.h>
@@ -20,7 +21,13 @@ public:
         Triangle triangle{};
     };
 private:
-    std::vector<Triangle> _tris;
+    /*
+     * The triangles are immutable and shared between the copies of the mesh (instances of a loaded model
+     * keep one copy of the geometry). Changes of the triangles replace the whole list: copy-on-write.
+     */
+    std::shared_ptr<const std::vector<Triangle>> _tris = std::make_shared<const std::vector<Triangle>>();
+    // The vertices of the triangles in single precision (vertex j of the triangle i is 3*i + j), shared as well
+    std::shared_ptr<const Vec3DBatch> _vertices = std::make_shared<const Vec3DBatch>();
     std::shared_ptr<Material> _material = Consts::DEFAULT_MATERIAL;
     Bounds _bounds;
 
@@ -28,6 +35,7 @@ private:
 
     void copyTriangles(const TriangleMesh& mesh, bool deepCopy);
     void calculateBounds();
+    void calculateVertices();
 
 public:
     TriangleMesh() = default;
@@ -37,13 +45,17 @@ public:
 
     explicit TriangleMesh(const std::vector<Triangle> &tries, const std::shared_ptr<Material>& material = Consts::DEFAULT_MATERIAL);
 
-    [[nodiscard]] std::vector<Triangle> const &triangles() const { return _tris; }
+    [[nodiscard]] std::vector<Triangle> const &triangles() const { return *_tris; }
+    // For the batched projection (see Camera::project())
+    [[nodiscard]] const Vec3DBatch& vertices() const { return *_vertices; }
+    // True if the meshes share the same triangles (one of them is a shallow copy of the other)
+    [[nodiscard]] bool sharesTriangles(const TriangleMesh& mesh) const { return _tris == mesh._tris; }
 
     TriangleMesh &operator*=(const Matrix4x4 &matrix4X4);
     void setTriangles(std::vector<Triangle>&& t);
     void setTriangles(const std::vector<Triangle>& t);
 
-    [[nodiscard]] size_t size() const { return _tris.size() * 3; }
+    [[nodiscard]] size_t size() const { return _tris->size() * 3; }
 
     [[nodiscard]] std::shared_ptr<Material> getMaterial() const { return _material; }
     void setMaterial(std::shared_ptr<Material> material) { _material = std::move(material); }
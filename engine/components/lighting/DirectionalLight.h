@@ -2,10 +2,12 @@
 #define LIGHTING_DIRECTIONALLIGHT_H
 
 #include "LightSource.h"
+#include "ShadowMap.h"
 
 class DirectionalLight final : public LightSource {
 private:
     Vec3D _dir;
+    std::shared_ptr<CascadedShadowMap> _shadowMap;
 public:
     explicit DirectionalLight(const Vec3D& direction, const Color& color = Color::WHITE, double intensity = 1.0):
             LightSource(color, intensity), _dir(direction.normalized()) {};
@@ -19,13 +21,53 @@ public:
         // linear interpolation between exact and inexact (with dot = 0.5)
         dot = dot + (0.5 - dot)*simplCoef;
 
+        if (_castShadows && _shadowMap) {
+            dot *= _shadowMap->visibility(pixelPosition, pixelNorm);
+        }
+
         return Color(std::clamp<int>(dot*color().r()*intensity(), 0, 255),
                      std::clamp<int>(dot*color().g()*intensity(), 0, 255),
                      std::clamp<int>(dot*color().b()*intensity(), 0, 255));
     }
 
+    void illuminate(LightingBatch& batch) const override {
+        if (!_castShadows || !_shadowMap) {
+            illuminateDirectional(_params, batch);
+            return;
+        }
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch.visibility[i] = _shadowMap->visibility(Vec3D(batch.x[i], batch.y[i], batch.z[i]),
+                                                         Vec3D(batch.nx[i], batch.ny[i], batch.nz[i]));
+        }
+        illuminateDirectional(_params, batch, batch.visibility.data());
+    }
+
+    void renderShadows(const Object& world, const Camera& camera) override {
+        if (!_castShadows) {
+            _shadowMap = nullptr;
+            return;
+        }
+        if (!_shadowMap) {
+            _shadowMap = std::make_shared<CascadedShadowMap>();
+        }
+        _shadowMap->render(world, camera, direction());
+    }
+
+    void prepare() override {
+        LightSource::prepare();
+
+        Vec3D dir = direction();
+        for (int i = 0; i < 3; i++) {
+            _params.direction[i] = static_cast<float>(dir[i]);
+        }
+    }
+
     [[nodiscard]] std::shared_ptr<Component> copy() const override {
-        return std::make_shared<DirectionalLight>(*this);
+        auto light = std::make_shared<DirectionalLight>(*this);
+        // Copies have their own shadow maps
+        light->_shadowMap = nullptr;
+        return light;
     }
 
 
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cmath>
+
+#include <components/lighting/LightGrid.h>
+#include <utils/Profiler.h>
+
+uint16_t LightGrid::depthSlice(double depth) const {
+    if (!(depth > _zNear)) {
+        return 0;
+    }
+    return std::min<double>(std::log(depth / _zNear) * _depthScale, DEPTH_SLICES - 1);
+}
+
+LightGrid::ClusterRange LightGrid::clusterRange(const LightBounds &bounds, const Matrix4x4 &worldToCamera,
+                                                const Matrix4x4 &SP, double zFar, uint16_t width, uint16_t height) const {
+    ClusterRange range{0, static_cast<uint16_t>(_tilesX - 1),
+                       0, static_cast<uint16_t>(_tilesY - 1),
+                       0, DEPTH_SLICES - 1};
+
+    if (std::isinf(bounds.radius)) {
+        // Lights without attenuation (like directional light) are in every cluster
+        return range;
+    }
+
+    Vec3D center(worldToCamera * bounds.position.makePoint4D());
+    double r = bounds.radius;
+
+    if (center.z() + r < _zNear || center.z() - r > zFar) {
+        range.empty = true;
+        return range;
+    }
+
+    range.z0 = depthSlice(center.z() - r);
+    range.z1 = depthSlice(center.z() + r);
+
+    if (center.z() - r <= _zNear) {
+        // The sphere contains the camera plane: the projection is not bounded, so we take the whole screen
+        return range;
+    }
+
+    // The screen rectangle of the sphere is the rectangle of the projection of its bounding box
+    double xMin = std::numeric_limits<double>::max(), xMax = std::numeric_limits<double>::lowest();
+    double yMin = std::numeric_limits<double>::max(), yMax = std::numeric_limits<double>::lowest();
+    for (int i = 0; i < 8; i++) {
+        Vec4D corner = SP * Vec4D(center.x() + ((i & 1) ? r : -r),
+                                  center.y() + ((i & 2) ? r : -r),
+                                  center.z() + ((i & 4) ? r : -r), 1);
+        double x = corner.x() / corner.w();
+        double y = corner.y() / corner.w();
+        xMin = std::min(xMin, x); xMax = std::max(xMax, x);
+        yMin = std::min(yMin, y); yMax = std::max(yMax, y);
+    }
+
+    if (xMax < 0 || yMax < 0 || xMin >= width || yMin >= height) {
+        range.empty = true;
+        return range;
+    }
+
+    range.x0 = std::clamp<double>(std::floor(xMin) / TILE_SIZE, 0, _tilesX - 1);
+    range.x1 = std::clamp<double>(std::floor(xMax) / TILE_SIZE, 0, _tilesX - 1);
+    range.y0 = std::clamp<double>(std::floor(yMin) / TILE_SIZE, 0, _tilesY - 1);
+    range.y1 = std::clamp<double>(std::floor(yMax) / TILE_SIZE, 0, _tilesY - 1);
+
+    return range;
+}
+
+void LightGrid::build(const Camera &camera, uint16_t width, uint16_t height,
+                      const std::vector<std::shared_ptr<LightSource>> &lights, const std::vector<LightBounds> &bounds) {
+    PROFILE_SCOPE("light grid");
+    _tilesX = std::max((width + TILE_SIZE - 1) / TILE_SIZE, 1);
+    _tilesY = std::max((height + TILE_SIZE - 1) / TILE_SIZE, 1);
+    _zNear = camera.zNear();
+    _depthScale = DEPTH_SLICES / std::log(camera.zFar() / camera.zNear());
+
+    Matrix4x4 worldToCamera = camera.transformMatrix()->fullInvModel();
+
+    _ranges.clear();
+    for (const auto& lightBounds : bounds) {
+        _ranges.emplace_back(clusterRange(lightBounds, worldToCamera, camera.screenSpaceProjection(), camera.zFar(), width, height));
+    }
+
+    // Counting sort of (cluster, light) pairs: first we count lights in every cluster, then we place them
+    size_t numClusters = static_cast<size_t>(_tilesX) * _tilesY * DEPTH_SLICES;
+    _offsets.assign(numClusters + 1, 0);
+
+    for (const auto& range : _ranges) {
+        if (range.empty) continue;
+        for (uint16_t z = range.z0; z <= range.z1; z++)
+            for (uint16_t y = range.y0; y <= range.y1; y++)
+                for (uint16_t x = range.x0; x <= range.x1; x++)
+                    _offsets[clusterIndex(x, y, z) + 1]++;
+    }
+    for (size_t i = 0; i < numClusters; i++) {
+        _offsets[i + 1] += _offsets[i];
+    }
+
+    _lights.resize(_offsets.back());
+    _cursor.assign(_offsets.begin(), _offsets.end() - 1);
+
+    for (size_t i = 0; i < _ranges.size(); i++) {
+        const auto& range = _ranges[i];
+        if (range.empty) continue;
+        for (uint16_t z = range.z0; z <= range.z1; z++)
+            for (uint16_t y = range.y0; y <= range.y1; y++)
+                for (uint16_t x = range.x0; x <= range.x1; x++)
+                    _lights[_cursor[clusterIndex(x, y, z)]++] = lights[i].get();
+    }
+}
+
+std::span<const LightSource* const> LightGrid::lights(uint16_t x, uint16_t y, double depth) const {
+    if (_offsets.empty()) {
+        return {};
+    }
+
+    size_t index = clusterIndex(std::min<uint16_t>(x / TILE_SIZE, _tilesX - 1),
+                                std::min<uint16_t>(y / TILE_SIZE, _tilesY - 1),
+                                depthSlice(depth));
+    return {_lights.data() + _offsets[index], _lights.data() + _offsets[index + 1]};
+}
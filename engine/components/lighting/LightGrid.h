@@ -0,0 +1,55 @@
+#ifndef LIGHTING_LIGHTGRID_H
+#define LIGHTING_LIGHTGRID_H
+
+#include <span>
+#include <vector>
+
+#include <objects/Camera.h>
+#include "LightSource.h"
+
+/*
+ * Clustered light grid: the screen is split into tiles of TILE_SIZE x TILE_SIZE pixels and
+ * the depth range of the camera into DEPTH_SLICES exponential slices. Every cluster keeps
+ * the lights whose bounds intersect it, so per-pixel lighting iterates only over the lights
+ * that can change the color of the pixel, no matter how many lights are in the scene.
+ */
+class LightGrid final {
+public:
+    static constexpr uint16_t TILE_SIZE = 32;
+    static constexpr uint16_t DEPTH_SLICES = 16;
+private:
+    struct ClusterRange final {
+        uint16_t x0 = 0, x1 = 0;
+        uint16_t y0 = 0, y1 = 0;
+        uint16_t z0 = 0, z1 = 0;
+        bool empty = false;
+    };
+
+    uint16_t _tilesX = 0;
+    uint16_t _tilesY = 0;
+    double _zNear = 0;
+    double _depthScale = 0; // DEPTH_SLICES / log(zFar / zNear)
+
+    // Lights of all clusters one after another: cluster i owns [_offsets[i], _offsets[i+1])
+    std::vector<uint32_t> _offsets;
+    std::vector<const LightSource*> _lights;
+
+    // Internal buffers to reduce allocations
+    std::vector<ClusterRange> _ranges;
+    std::vector<uint32_t> _cursor;
+
+    [[nodiscard]] uint16_t depthSlice(double depth) const;
+    [[nodiscard]] size_t clusterIndex(uint16_t x, uint16_t y, uint16_t z) const { return (z*_tilesY + y)*_tilesX + x; }
+    [[nodiscard]] ClusterRange clusterRange(const LightBounds& bounds, const Matrix4x4& worldToCamera,
+                                            const Matrix4x4& SP, double zFar, uint16_t width, uint16_t height) const;
+public:
+    // bounds[i] are the bounds of lights[i] in the world space
+    void build(const Camera& camera, uint16_t width, uint16_t height,
+               const std::vector<std::shared_ptr<LightSource>>& lights, const std::vector<LightBounds>& bounds);
+
+    // depth is the depth of the pixel in the camera space (w after the projection)
+    [[nodiscard]] std::span<const LightSource* const> lights(uint16_t x, uint16_t y, double depth) const;
+};
+
+
+#endif //LIGHTING_LIGHTGRID_H
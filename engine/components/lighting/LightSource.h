@@ -5,13 +5,57 @@
 #ifndef LIGHTING_LIGHTSOURCE_H
 #define LIGHTING_LIGHTSOURCE_H
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "components/Component.h"
+#include "LightingBatch.h"
+
+class Camera;
+
+/*
+ * The region of space where the light source can change the color of a pixel:
+ * a sphere of the given radius, cut by a cone around the direction (for spot lights).
+ * Lights without attenuation have an infinite radius.
+ */
+struct LightBounds final {
+    Vec3D position;
+    double radius = std::numeric_limits<double>::infinity();
+    Vec3D direction{0, 0, 1};
+    double coneCos = -1; // -1 means all directions
+
+    // Conservative test: true if the light might illuminate at least one point of the sphere
+    [[nodiscard]] bool intersects(const Vec3D& center, double sphereRadius) const {
+        Vec3D toCenter = center - position;
+        double distance = toCenter.abs();
+        if (distance > radius + sphereRadius) {
+            return false;
+        }
+        if (coneCos <= -1 || distance <= sphereRadius) {
+            return true;
+        }
+        if (coneCos > 1) {
+            return false;
+        }
+
+        // The angle between the axis of the cone and the center of the sphere
+        // should be less than the half-angle of the cone plus the angular radius of the sphere
+        double angle = std::acos(std::clamp(toCenter.dot(direction) / distance, -1.0, 1.0));
+        return angle <= std::acos(coneCos) + std::asin(sphereRadius / distance);
+    }
+};
 
 class LightSource : public Component {
 protected:
     Color _color = Color::WHITE;
     double _intensity = 1.0;
 
+    // World space parameters of the light for the current frame (see prepare())
+    LightParams _params;
+
+    bool _castShadows = false;
+
 public:
     LightSource(const Color& color, double intensity): _color(color), _intensity(std::max(intensity, 0.0)) {}
 
@@ -19,6 +63,8 @@ public:
 
     [[nodiscard]] inline Color color() const { return _color; };
     [[nodiscard]] inline double intensity() const { return _intensity; };
+    // The snapshot of the last prepare()
+    [[nodiscard]] const LightParams& params() const { return _params; }
 
     /*
      * simplCoef is in range [0, 1], where 0 means exact computation and 1 means simplified.
@@ -27,6 +73,37 @@ public:
      */
     [[nodiscard]] virtual Color illuminate(const Vec3D& pixelNorm, const Vec3D& pixelPosition, double simplCoef) const = 0;
 
+    /*
+     * Bounds of the light in the world space. They are exact in a sense that outside of them
+     * every color channel of illuminate() is less than 1, so it is rounded to 0 anyway.
+     * It involves the full transform chain, so it is better to compute it once per frame.
+     */
+    [[nodiscard]] virtual LightBounds bounds() const { return {}; }
+
+    /*
+     * Snapshots the parameters of the light in the world space. It should be called once per frame
+     * before illuminate(LightingBatch&), so the batch does not go through the transform chain.
+     */
+    virtual void prepare() {
+        _params.color[0] = static_cast<float>(_color.r()*_intensity);
+        _params.color[1] = static_cast<float>(_color.g()*_intensity);
+        _params.color[2] = static_cast<float>(_color.b()*_intensity);
+    }
+
+    /*
+     * Adds the light to every point of the batch. Unlike illuminate() for one point it is not clamped:
+     * the light of all sources is accumulated in float. By default it falls back to illuminate() per point.
+     */
+    virtual void illuminate(LightingBatch& batch) const {
+        for (size_t i = 0; i < batch.size(); i++) {
+            auto c = illuminate(Vec3D(batch.nx[i], batch.ny[i], batch.nz[i]),
+                                Vec3D(batch.x[i], batch.y[i], batch.z[i]), batch.simplCoef[i]);
+            batch.r[i] += c.r();
+            batch.g[i] += c.g();
+            batch.b[i] += c.b();
+        }
+    }
+
     void start() override {
         if (!hasComponent<TransformMatrix>()) {
             // This component requires to work with TransformMatrix component,
@@ -34,6 +111,15 @@ public:
         }
     }
 
+    /*
+     * Renders the shadow maps of the light for the current frame (after prepare()).
+     * Light sources without shadows support ignore it.
+     */
+    virtual void renderShadows(const Object&, const Camera&) {}
+
+    [[nodiscard]] bool castShadows() const { return _castShadows; }
+    void setCastShadows(bool castShadows) { _castShadows = castShadows; }
+
     void setIntensity(double intensity) { _intensity = intensity; }
     void setColor(const Color& color) { _color = color; }
 };
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <components/lighting/LightingBatch.h>
+
+void LightingBatch::clear() {
+    for (auto* v : {&x, &y, &z, &nx, &ny, &nz, &simplCoef, &r, &g, &b, &visibility}) {
+        v->clear();
+    }
+    _size = 0;
+}
+
+void LightingBatch::add(const Vec3D &position, const Vec3D &norm, double simplCoefficient) {
+    if (_size == x.size()) {
+        // Zeros for the new lane group: the light is accumulated into r, g, b
+        for (auto* v : {&x, &y, &z, &nx, &ny, &nz, &simplCoef, &r, &g, &b, &visibility}) {
+            v->resize(v->size() + LANES, 0.0f);
+        }
+    }
+
+    x[_size] = static_cast<float>(position.x());
+    y[_size] = static_cast<float>(position.y());
+    z[_size] = static_cast<float>(position.z());
+    nx[_size] = static_cast<float>(norm.x());
+    ny[_size] = static_cast<float>(norm.y());
+    nz[_size] = static_cast<float>(norm.z());
+    simplCoef[_size] = static_cast<float>(simplCoefficient);
+    _size++;
+}
+
+#if defined(__SSE2__)
+
+static inline __m128 clampPs(__m128 value, float min, float max) {
+    return _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(min)), _mm_set1_ps(max));
+}
+
+// linear interpolation between exact and inexact (with dot = 0.5)
+static inline __m128 simplifyDot(__m128 dot, __m128 simplCoef) {
+    return _mm_add_ps(dot, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(0.5f), dot), simplCoef));
+}
+
+static inline void accumulate(const LightParams &params, LightingBatch &batch, size_t i, __m128 k, const float* visibility) {
+    if (visibility) {
+        k = _mm_mul_ps(k, _mm_loadu_ps(visibility + i));
+    }
+    _mm_storeu_ps(&batch.r[i], _mm_add_ps(_mm_loadu_ps(&batch.r[i]), _mm_mul_ps(k, _mm_set1_ps(params.color[0]))));
+    _mm_storeu_ps(&batch.g[i], _mm_add_ps(_mm_loadu_ps(&batch.g[i]), _mm_mul_ps(k, _mm_set1_ps(params.color[1]))));
+    _mm_storeu_ps(&batch.b[i], _mm_add_ps(_mm_loadu_ps(&batch.b[i]), _mm_mul_ps(k, _mm_set1_ps(params.color[2]))));
+}
+
+void illuminateDirectional(const LightParams &params, LightingBatch &batch, const float* visibility) {
+    const __m128 dx = _mm_set1_ps(params.direction[0]);
+    const __m128 dy = _mm_set1_ps(params.direction[1]);
+    const __m128 dz = _mm_set1_ps(params.direction[2]);
+
+    for (size_t i = 0; i < batch.paddedSize(); i += LightingBatch::LANES) {
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&batch.nx[i]), dx),
+                                           _mm_mul_ps(_mm_loadu_ps(&batch.ny[i]), dy)),
+                                _mm_mul_ps(_mm_loadu_ps(&batch.nz[i]), dz));
+        dot = clampPs(_mm_sub_ps(_mm_setzero_ps(), dot), 0.3f, 1.0f);
+        dot = simplifyDot(dot, _mm_loadu_ps(&batch.simplCoef[i]));
+
+        accumulate(params, batch, i, dot, visibility);
+    }
+}
+
+template<bool Spot>
+static void illuminatePointOrSpot(const LightParams &params, LightingBatch &batch, const float* visibility) {
+    const __m128 px = _mm_set1_ps(params.position[0]);
+    const __m128 py = _mm_set1_ps(params.position[1]);
+    const __m128 pz = _mm_set1_ps(params.position[2]);
+    const __m128 radius = _mm_set1_ps(params.radius);
+
+    const __m128 dx = _mm_set1_ps(params.direction[0]);
+    const __m128 dy = _mm_set1_ps(params.direction[1]);
+    const __m128 dz = _mm_set1_ps(params.direction[2]);
+    const __m128 innerCos = _mm_set1_ps(params.innerConeCos);
+    const __m128 outerCos = _mm_set1_ps(params.outerConeCos);
+    const __m128 coneScale = _mm_set1_ps(params.innerConeCos > params.outerConeCos ?
+                                         1.0f / (params.innerConeCos - params.outerConeCos) : 0.0f);
+
+    for (size_t i = 0; i < batch.paddedSize(); i += LightingBatch::LANES) {
+        __m128 tx = _mm_sub_ps(px, _mm_loadu_ps(&batch.x[i]));
+        __m128 ty = _mm_sub_ps(py, _mm_loadu_ps(&batch.y[i]));
+        __m128 tz = _mm_sub_ps(pz, _mm_loadu_ps(&batch.z[i]));
+
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz)));
+        __m128 invDistance = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(distance, _mm_set1_ps(1e-6f)));
+
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&batch.nx[i]), tx),
+                                           _mm_mul_ps(_mm_loadu_ps(&batch.ny[i]), ty)),
+                                _mm_mul_ps(_mm_loadu_ps(&batch.nz[i]), tz));
+        dot = clampPs(_mm_mul_ps(dot, invDistance), params.minDot, 1.0f);
+        dot = simplifyDot(dot, _mm_loadu_ps(&batch.simplCoef[i]));
+
+        // Beyond the radius of the bounds the light is cut off (see LightSource::bounds())
+        __m128 energy = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(distance, _mm_set1_ps(0.1f)));
+        energy = _mm_and_ps(energy, _mm_cmplt_ps(distance, radius));
+
+        if constexpr (Spot) {
+            __m128 cosAngle = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, dx), _mm_mul_ps(ty, dy)), _mm_mul_ps(tz, dz));
+            cosAngle = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(cosAngle, invDistance));
+
+            energy = _mm_andnot_ps(_mm_cmplt_ps(cosAngle, outerCos), energy);
+            __m128 coneEnergy = _mm_mul_ps(energy, _mm_mul_ps(_mm_sub_ps(cosAngle, outerCos), coneScale));
+            __m128 inner = _mm_cmpgt_ps(cosAngle, innerCos);
+            energy = _mm_or_ps(_mm_and_ps(inner, coneEnergy), _mm_andnot_ps(inner, energy));
+        }
+
+        accumulate(params, batch, i, _mm_mul_ps(dot, energy), visibility);
+    }
+}
+
+#else
+
+// linear interpolation between exact and inexact (with dot = 0.5)
+static inline float simplifyDot(float dot, float simplCoef) {
+    return dot + (0.5f - dot)*simplCoef;
+}
+
+static inline void accumulate(const LightParams &params, LightingBatch &batch, size_t i, float k, const float* visibility) {
+    if (visibility) {
+        k *= visibility[i];
+    }
+    batch.r[i] += k*params.color[0];
+    batch.g[i] += k*params.color[1];
+    batch.b[i] += k*params.color[2];
+}
+
+void illuminateDirectional(const LightParams &params, LightingBatch &batch, const float* visibility) {
+    for (size_t i = 0; i < batch.paddedSize(); i++) {
+        float dot = batch.nx[i]*params.direction[0] + batch.ny[i]*params.direction[1] + batch.nz[i]*params.direction[2];
+        dot = simplifyDot(std::clamp(-dot, 0.3f, 1.0f), batch.simplCoef[i]);
+
+        accumulate(params, batch, i, dot, visibility);
+    }
+}
+
+template<bool Spot>
+static void illuminatePointOrSpot(const LightParams &params, LightingBatch &batch, const float* visibility) {
+    float coneScale = params.innerConeCos > params.outerConeCos ? 1.0f / (params.innerConeCos - params.outerConeCos) : 0.0f;
+
+    for (size_t i = 0; i < batch.paddedSize(); i++) {
+        float tx = params.position[0] - batch.x[i];
+        float ty = params.position[1] - batch.y[i];
+        float tz = params.position[2] - batch.z[i];
+
+        float distance = std::sqrt(tx*tx + ty*ty + tz*tz);
+        float invDistance = 1.0f / std::max(distance, 1e-6f);
+
+        float dot = (batch.nx[i]*tx + batch.ny[i]*ty + batch.nz[i]*tz)*invDistance;
+        dot = simplifyDot(std::clamp(dot, params.minDot, 1.0f), batch.simplCoef[i]);
+
+        // Beyond the radius of the bounds the light is cut off (see LightSource::bounds())
+        float energy = distance < params.radius ? 1.0f / (distance + 0.1f) : 0.0f;
+
+        if constexpr (Spot) {
+            float cosAngle = -(tx*params.direction[0] + ty*params.direction[1] + tz*params.direction[2])*invDistance;
+            if (cosAngle < params.outerConeCos) {
+                energy = 0;
+            }
+            if (cosAngle > params.innerConeCos) {
+                energy *= (cosAngle - params.outerConeCos)*coneScale;
+            }
+        }
+
+        accumulate(params, batch, i, dot*energy, visibility);
+    }
+}
+
+#endif
+
+void illuminatePoint(const LightParams &params, LightingBatch &batch, const float* visibility) {
+    illuminatePointOrSpot<false>(params, batch, visibility);
+}
+
+void illuminateSpot(const LightParams &params, LightingBatch &batch, const float* visibility) {
+    illuminatePointOrSpot<true>(params, batch, visibility);
+}
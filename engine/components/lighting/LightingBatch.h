@@ -0,0 +1,60 @@
+#ifndef LIGHTING_LIGHTINGBATCH_H
+#define LIGHTING_LIGHTINGBATCH_H
+
+#include <vector>
+
+#include <linalg/Vec3D.h>
+
+/*
+ * Points to be illuminated in the SoA layout: positions and normals in the world space,
+ * simplification coefficients (see LightSource::illuminate()) and the accumulated light.
+ * Light is accumulated in float in the 0..255 scale without clamping: a bright point can go above 255.
+ * Arrays are padded with zeros up to a multiple of LANES, so SIMD kernels never need a scalar tail.
+ */
+struct LightingBatch final {
+    static constexpr size_t LANES = 4;
+
+    std::vector<float> x, y, z;
+    std::vector<float> nx, ny, nz;
+    std::vector<float> simplCoef;
+    std::vector<float> r, g, b;
+    // Scratch space for the lights with shadows: the part of the light that reaches the point
+    std::vector<float> visibility;
+
+    [[nodiscard]] size_t size() const { return _size; }
+    [[nodiscard]] size_t paddedSize() const { return x.size(); }
+
+    // Removes all points (memory is kept for the next use)
+    void clear();
+    void add(const Vec3D& position, const Vec3D& norm, double simplCoefficient);
+    [[nodiscard]] Vec3D light(size_t i) const { return Vec3D(r[i], g[i], b[i]); }
+
+private:
+    size_t _size = 0;
+};
+
+/*
+ * World space parameters of a light source, snapshotted once per frame in LightSource::prepare().
+ * color is already multiplied by the intensity.
+ */
+struct LightParams final {
+    float position[3] = {0, 0, 0};
+    float direction[3] = {0, 0, 1};
+    float color[3] = {0, 0, 0};
+    float radius = 0;
+    float minDot = 0;
+    float innerConeCos = 1;
+    float outerConeCos = -1;
+
+    bool operator==(const LightParams& params) const = default;
+};
+
+/*
+ * Kernels for the built-in light sources: they add the light to r, g, b of the batch.
+ * When visibility is not null, the light of every point is multiplied by it (shadows).
+ */
+void illuminateDirectional(const LightParams& params, LightingBatch& batch, const float* visibility = nullptr);
+void illuminatePoint(const LightParams& params, LightingBatch& batch, const float* visibility = nullptr);
+void illuminateSpot(const LightParams& params, LightingBatch& batch, const float* visibility = nullptr);
+
+#endif //LIGHTING_LIGHTINGBATCH_H
@@ -32,6 +32,27 @@ public:
                      std::clamp<int>(dot*color().b()*energy, 0, 255));
     }
 
+    void illuminate(LightingBatch& batch) const override {
+        illuminatePoint(_params, batch);
+    }
+
+    void prepare() override {
+        LightSource::prepare();
+
+        auto bounds = PointLight::bounds();
+        for (int i = 0; i < 3; i++) {
+            _params.position[i] = static_cast<float>(bounds.position[i]);
+        }
+        _params.radius = static_cast<float>(bounds.radius);
+        _params.minDot = 0.2f;
+    }
+
+    [[nodiscard]] LightBounds bounds() const override {
+        // dot*color*energy < 1 when intensity*color/(distance + 0.1) < 1
+        double maxColor = std::max({color().r(), color().g(), color().b()});
+        return {getComponent<TransformMatrix>()->fullPosition(), std::max(intensity()*maxColor - 0.1, 0.0)};
+    }
+
     [[nodiscard]] std::shared_ptr<Component> copy() const override {
         return std::make_shared<PointLight>(*this);
     }
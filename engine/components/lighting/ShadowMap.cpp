@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <components/lighting/ShadowMap.h>
+#include <components/geometry/MeshInstances.h>
+#include <Consts.h>
+#include <utils/Profiler.h>
+
+// Orthonormal basis of the light view with the given look direction (the same as the camera has: left, up, lookAt)
+static void lightBasis(const Vec3D& direction, Vec3D& left, Vec3D& up, Vec3D& lookAt) {
+    lookAt = direction.normalized();
+    Vec3D worldUp = std::abs(lookAt.y()) < 0.99 ? Vec3D(0, 1, 0) : Vec3D(1, 0, 0);
+    left = worldUp.cross(lookAt).normalized();
+    up = lookAt.cross(left);
+}
+
+ShadowMap::ShadowMap(uint16_t size) : _size(size),
+    _staticDepth(static_cast<size_t>(size) * size, std::numeric_limits<float>::infinity()),
+    _depth(static_cast<size_t>(size) * size, std::numeric_limits<float>::infinity()) {}
+
+void ShadowMap::setView(const Vec3D &position, const Vec3D &direction) {
+    Vec3D left, up, lookAt;
+    lightBasis(direction, left, up, lookAt);
+
+    Matrix4x4 model({{
+        {left.x(), up.x(), lookAt.x(), position.x()},
+        {left.y(), up.y(), lookAt.y(), position.y()},
+        {left.z(), up.z(), lookAt.z(), position.z()},
+        {0, 0, 0, 1}
+    }});
+    Matrix4x4 view = Matrix4x4::View(model);
+
+    if ((view - _view).abs() < Consts::EPS) {
+        return;
+    }
+
+    _camera->transformMatrix()->undoTransformations();
+    _camera->transformMatrix()->transform(model);
+
+    _view = view;
+    _worldToMap = _camera->screenSpaceProjection() * _view;
+    _staticValid = false;
+}
+
+void ShadowMap::setPerspective(const Vec3D &position, const Vec3D &direction, double fov, double zNear, double zFar) {
+    std::array<double, 4> projection{fov, zNear, zFar, 0};
+    if (_orthographic || projection != _projection) {
+        _camera->init(_size, _size, fov, zNear, zFar);
+        _orthographic = false;
+        _projection = projection;
+        _texelSize = 2.0 * std::tan(Consts::PI * fov / 360.0) / _size;
+        _view = Matrix4x4::Zero();
+    }
+    setView(position, direction);
+}
+
+void ShadowMap::setOrthographic(const Vec3D &position, const Vec3D &direction, double viewSize, double depth) {
+    std::array<double, 4> projection{viewSize, 0, depth, 1};
+    if (!_orthographic || projection != _projection) {
+        _camera->initOrthographic(_size, _size, viewSize, viewSize, 0, depth);
+        _orthographic = true;
+        _projection = projection;
+        _texelSize = viewSize / _size;
+        _view = Matrix4x4::Zero();
+    }
+    setView(position, direction);
+}
+
+void ShadowMap::updateCasters(const Object &object) {
+    for (const auto& [objTag, obj] : object) {
+        if (obj->numberOfAttached() > 0) {
+            updateCasters(*obj);
+        }
+
+        auto triangleMesh = obj->getComponent<TriangleMesh>();
+        if (!triangleMesh || !triangleMesh->isVisible()) {
+            continue;
+        }
+
+        Matrix4x4 model = triangleMesh->getComponent<TransformMatrix>()->fullModel();
+        auto instances = obj->getComponent<MeshInstances>();
+        if (!instances) {
+            updateCaster(*triangleMesh, 0, model);
+            continue;
+        }
+        for (size_t i = 0; i < instances->size(); i++) {
+            updateCaster(*triangleMesh, i, model * instances->transforms()[i]);
+        }
+    }
+}
+
+void ShadowMap::updateCaster(const TriangleMesh &mesh, size_t instance, const Matrix4x4 &model) {
+    auto [it, inserted] = _casters.try_emplace({&mesh, instance});
+    Caster& caster = it->second;
+    caster.seen = true;
+
+    bool moved = (model - caster.model).abs() > Consts::EPS ||
+                 caster.triangles != mesh.triangles().data() ||
+                 caster.size != mesh.triangles().size();
+
+    if (inserted) {
+        // New casters are static until they move: most of the scene never moves
+        _staticValid = false;
+    } else if (moved) {
+        caster.stillFrames = 0;
+        if (caster.isStatic) {
+            caster.isStatic = false;
+            _staticValid = false;
+        }
+    } else if (!caster.isStatic && ++caster.stillFrames >= STATIC_FRAMES) {
+        caster.isStatic = true;
+        _staticValid = false;
+    }
+
+    caster.model = model;
+    caster.triangles = mesh.triangles().data();
+    caster.size = mesh.triangles().size();
+
+    _frameCasters.push_back({&mesh, model, caster.isStatic});
+}
+
+void ShadowMap::render(const Object &world) {
+    PROFILE_SCOPE("shadow map");
+    for (auto& [key, caster] : _casters) {
+        caster.seen = false;
+    }
+
+    _frameCasters.clear();
+    updateCasters(world);
+
+    // Casters which were removed from the world
+    std::erase_if(_casters, [this](const auto& item) {
+        if (!item.second.seen && item.second.isStatic) {
+            _staticValid = false;
+        }
+        return !item.second.seen;
+    });
+
+    if (!_staticValid) {
+        std::fill(_staticDepth.begin(), _staticDepth.end(), std::numeric_limits<float>::infinity());
+        for (const auto& [mesh, model, isStatic] : _frameCasters) {
+            if (isStatic) {
+                rasterize(*mesh, model, _staticDepth);
+            }
+        }
+        _staticValid = true;
+        _depthValid = false;
+    }
+
+    _hasDynamic = std::any_of(_frameCasters.begin(), _frameCasters.end(), [](const auto& c) { return !c.isStatic; });
+    if (!_hasDynamic) {
+        return;
+    }
+
+    // The whole map is copied only after the static layer changed, otherwise the dynamic casters of the last frame are erased
+    if (!_depthValid) {
+        _depth = _staticDepth;
+        _depthValid = true;
+    } else {
+        for (int y = _dynamicRect.y0; y <= _dynamicRect.y1; y++) {
+            size_t offset = static_cast<size_t>(y) * _size + _dynamicRect.x0;
+            std::copy_n(_staticDepth.begin() + offset, _dynamicRect.x1 - _dynamicRect.x0 + 1, _depth.begin() + offset);
+        }
+    }
+
+    _dynamicRect = {_size, _size, -1, -1};
+    for (const auto& [mesh, model, isStatic] : _frameCasters) {
+        if (!isStatic) {
+            TexelRect rect = rasterize(*mesh, model, _depth);
+            _dynamicRect = {std::min(_dynamicRect.x0, rect.x0), std::min(_dynamicRect.y0, rect.y0),
+                            std::max(_dynamicRect.x1, rect.x1), std::max(_dynamicRect.y1, rect.y1)};
+        }
+    }
+}
+
+ShadowMap::TexelRect ShadowMap::rasterize(const TriangleMesh &mesh, const Matrix4x4 &model, std::vector<float> &depth) {
+    TexelRect bounds{_size, _size, -1, -1};
+    double zNear = _camera->zNear();
+    double zFar = _camera->zFar();
+
+    _triangles.clear();
+    _camera->project(mesh, Camera::Instance{model}, _triangles);
+
+    for (const auto& triangle : _triangles) {
+        double x0 = triangle[0].x, y0 = triangle[0].y;
+        double x1 = triangle[1].x, y1 = triangle[1].y;
+        double x2 = triangle[2].x, y2 = triangle[2].y;
+
+        double area = (x1 - x0)*(y2 - y0) - (x2 - x0)*(y1 - y0);
+        if (std::abs(area) < Consts::EPS) {
+            continue;
+        }
+
+        int xMin = std::max<int>(std::ceil(std::min({x0, x1, x2})), 0);
+        int yMin = std::max<int>(std::ceil(std::min({y0, y1, y2})), 0);
+        int xMax = std::min<int>(std::floor(std::max({x0, x1, x2})), _size - 1);
+        int yMax = std::min<int>(std::floor(std::max({y0, y1, y2})), _size - 1);
+        if (xMin > xMax || yMin > yMax) {
+            continue;
+        }
+        bounds = {std::min(bounds.x0, xMin), std::min(bounds.y0, yMin), std::max(bounds.x1, xMax), std::max(bounds.y1, yMax)};
+
+        for (int y = yMin; y <= yMax; y++) {
+            for (int x = xMin; x <= xMax; x++) {
+                // Barycentric coordinates of the pixel (positive inside for both orientations)
+                double w1 = ((x - x0)*(y2 - y0) - (x2 - x0)*(y - y0)) / area;
+                double w2 = ((x1 - x0)*(y - y0) - (x - x0)*(y1 - y0)) / area;
+                double w0 = 1 - w1 - w2;
+                if (w0 < 0 || w1 < 0 || w2 < 0) {
+                    continue;
+                }
+
+                // Projected z is linear on the screen, we store the depth in the light space
+                double z = w0*triangle[0].z + w1*triangle[1].z + w2*triangle[2].z;
+                double d = _orthographic ? zNear + z*(zFar - zNear) : zNear*zFar / (zFar - z*(zFar - zNear));
+
+                float& stored = depth[static_cast<size_t>(y) * _size + x];
+                stored = std::min(stored, static_cast<float>(d));
+            }
+        }
+    }
+    return bounds;
+}
+
+float ShadowMap::visibility(const Vec3D &position, const Vec3D &normal) const {
+    Vec3D viewPosition(_view * position.makePoint4D());
+    double texel = _orthographic ? _texelSize : _texelSize * std::max(viewPosition.z(), _camera->zNear());
+
+    // Normal offset and constant bias (both in texels) against the shadow acne
+    Vec3D offsetPosition(_view * (position + normal * (1.5 * texel)).makePoint4D());
+    if (offsetPosition.z() <= _camera->zNear()) {
+        return 1;
+    }
+    double depth = offsetPosition.z() - texel;
+
+    Vec4D projected = _camera->screenSpaceProjection() * offsetPosition.makePoint4D();
+    int cx = static_cast<int>(std::lround(projected.x() / projected.w()));
+    int cy = static_cast<int>(std::lround(projected.y() / projected.w()));
+
+    const auto& depthBuffer = _hasDynamic ? _depth : _staticDepth;
+
+    int lit = 0;
+    for (int y = cy - 1; y <= cy + 1; y++) {
+        for (int x = cx - 1; x <= cx + 1; x++) {
+            if (x < 0 || y < 0 || x >= _size || y >= _size ||
+                depth <= depthBuffer[static_cast<size_t>(y) * _size + x]) {
+                lit++;
+            }
+        }
+    }
+
+    return lit / 9.0f;
+}
+
+CascadedShadowMap::CascadedShadowMap(uint16_t size, double distance) :
+    _cascades{ShadowMap(size), ShadowMap(size), ShadowMap(size)}, _distance(distance) {}
+
+void CascadedShadowMap::render(const Object &world, const Camera &camera, const Vec3D &direction) {
+    auto cameraTransform = camera.transformMatrix();
+    _cameraPosition = cameraTransform->fullPosition();
+    _cameraLookAt = cameraTransform->fullModel().z().normalized();
+
+    // Practical split scheme: a mix of logarithmic and uniform splits
+    double zNear = camera.zNear();
+    double zFar = std::max(std::min(_distance, camera.zFar()), 2*zNear);
+    for (size_t i = 0; i <= CASCADES; i++) {
+        double k = static_cast<double>(i) / CASCADES;
+        _splits[i] = 0.75 * zNear * std::pow(zFar / zNear, k) + 0.25 * (zNear + (zFar - zNear) * k);
+    }
+
+    double tanV = std::tan(Consts::PI * camera.fov() / 360.0);
+    double tanH = tanV * camera.aspect();
+
+    Vec3D left, up, lookAt;
+    lightBasis(direction, left, up, lookAt);
+
+    for (size_t i = 0; i < CASCADES; i++) {
+        // Bounding sphere of the slice of the frustum: its radius does not depend on the camera rotation
+        double from = _splits[i], to = _splits[i + 1];
+        double middle = (from + to) / 2;
+        double radius = std::sqrt((to - middle)*(to - middle) + (to*tanH)*(to*tanH) + (to*tanV)*(to*tanV));
+        Vec3D center = _cameraPosition + _cameraLookAt * middle;
+
+        // Snapping the map to the grid of step = radius/4, so it moves only once in a while
+        double step = radius / 4;
+        auto snap = [step](double value) { return std::round(value / step) * step; };
+        Vec3D snapped = left * snap(center.dot(left)) + up * snap(center.dot(up)) + lookAt * snap(center.dot(lookAt));
+
+        double halfSize = radius + step;
+        // Casters between the light and the slice are also included (up to the shadow distance)
+        Vec3D position = snapped - lookAt * (halfSize + _distance);
+
+        _cascades[i].setOrthographic(position, lookAt, 2*halfSize, 2*halfSize + _distance);
+        _cascades[i].render(world);
+    }
+}
+
+float CascadedShadowMap::visibility(const Vec3D &position, const Vec3D &normal) const {
+    double depth = (position - _cameraPosition).dot(_cameraLookAt);
+
+    for (size_t i = 0; i < CASCADES; i++) {
+        if (depth < _splits[i + 1]) {
+            return _cascades[i].visibility(position, normal);
+        }
+    }
+
+    // Beyond the shadow distance everything is lit
+    return 1;
+}
@@ -0,0 +1,112 @@
+#ifndef LIGHTING_SHADOWMAP_H
+#define LIGHTING_SHADOWMAP_H
+
+#include <array>
+#include <map>
+#include <vector>
+
+#include <objects/Camera.h>
+#include <ScalarConsts.h>
+
+/*
+ * Depth of the closest casters as seen from a light source. The depth pass goes through the same
+ * Camera::project() (transform, clipping and projection) as the main view, only the raster is depth-only.
+ *
+ * Rendering the whole scene for every light each frame is too expensive on CPU, so casters are split in two layers:
+ * static casters are rasterized only when the view of the light or the set of static casters changes,
+ * dynamic casters (the ones which moved during the last STATIC_FRAMES frames) are added on top every frame.
+ * Only the texels covered by the dynamic casters of the previous frame are restored from the static layer.
+ */
+class ShadowMap final {
+public:
+    // A caster should not move this number of frames to be moved in the static layer
+    static constexpr uint16_t STATIC_FRAMES = 30;
+private:
+    struct Caster final {
+        Matrix4x4 model;
+        const Triangle* triangles = nullptr;
+        size_t size = 0;
+        uint16_t stillFrames = 0;
+        bool isStatic = true;
+        bool seen = false;
+    };
+
+    // Texels of the map, inclusive bounds
+    struct TexelRect final {
+        int x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+    };
+
+    uint16_t _size;
+    std::shared_ptr<Camera> _camera = std::make_shared<Camera>();
+
+    bool _orthographic = false;
+    std::array<double, 4> _projection{}; // parameters of the last Camera::init*()
+    double _texelSize = 0; // in world units: for the perspective view it is the size at the depth 1
+
+    Matrix4x4 _view = Matrix4x4::Identity();
+    Matrix4x4 _worldToMap = Matrix4x4::Identity();
+
+    std::vector<float> _staticDepth;
+    std::vector<float> _depth; // the static layer with the dynamic casters on top
+    bool _staticValid = false;
+    bool _depthValid = false; // _depth is equal to _staticDepth outside of _dynamicRect
+    bool _hasDynamic = false;
+    TexelRect _dynamicRect; // texels written by the dynamic casters in the last frame
+
+    struct FrameCaster final {
+        const TriangleMesh* mesh;
+        Matrix4x4 model;
+        bool isStatic;
+    };
+
+    // Every instance of MeshInstances is a caster of its own: (mesh, index of the instance)
+    std::map<std::pair<const TriangleMesh*, size_t>, Caster> _casters;
+    std::vector<FrameCaster> _frameCasters; // for the current frame
+    DrawList _triangles; // projected triangles of one caster (reused, so it does not allocate in the steady state)
+
+    void updateCasters(const Object& object);
+    void updateCaster(const TriangleMesh& mesh, size_t instance, const Matrix4x4& model);
+    // Returns the bounds of the texels which were written
+    TexelRect rasterize(const TriangleMesh& mesh, const Matrix4x4& model, std::vector<float>& depth);
+    void setView(const Vec3D& position, const Vec3D& direction);
+public:
+    explicit ShadowMap(uint16_t size = 1024);
+
+    // View of a spot light: fov is in degrees
+    void setPerspective(const Vec3D& position, const Vec3D& direction, double fov, double zNear, double zFar);
+    // View of a directional light: the box viewSize x viewSize x depth in front of the position
+    void setOrthographic(const Vec3D& position, const Vec3D& direction, double viewSize, double depth);
+
+    void render(const Object& world);
+
+    // Part of the light that reaches the point: 0..1 (3x3 PCF). Points outside of the map are lit.
+    [[nodiscard]] float visibility(const Vec3D& position, const Vec3D& normal) const;
+
+    [[nodiscard]] uint16_t size() const { return _size; }
+};
+
+/*
+ * Shadow maps for a directional light: the view frustum of the camera (up to the shadow distance)
+ * is split in CASCADES slices, each one gets its own orthographic shadow map.
+ * Maps are placed on a coarse grid, so moving camera does not invalidate the cached static casters every frame.
+ */
+class CascadedShadowMap final {
+public:
+    static constexpr size_t CASCADES = 3;
+private:
+    std::array<ShadowMap, CASCADES> _cascades;
+    std::array<double, CASCADES + 1> _splits{};
+    double _distance;
+
+    Vec3D _cameraPosition;
+    Vec3D _cameraLookAt;
+public:
+    explicit CascadedShadowMap(uint16_t size = Consts::DIRECTIONAL_SHADOW_MAP_SIZE,
+                               double distance = Consts::SHADOW_DISTANCE);
+
+    void render(const Object& world, const Camera& camera, const Vec3D& direction);
+
+    [[nodiscard]] float visibility(const Vec3D& position, const Vec3D& normal) const;
+};
+
+#endif //LIGHTING_SHADOWMAP_H
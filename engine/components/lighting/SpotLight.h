@@ -2,6 +2,7 @@
 #define LIGHTING_SPOTLIGHT_H
 
 #include "LightSource.h"
+#include "ShadowMap.h"
 
 class SpotLight final : public LightSource {
 private:
@@ -9,6 +10,7 @@ private:
     Vec3D _dir;
     double _innerConeCos;
     double _outerConeCos;
+    std::shared_ptr<ShadowMap> _shadowMap;
 public:
     SpotLight(const Vec3D& position, const Vec3D& direction, double innerConeCos = cos(Consts::PI / 4),
               double outerConeCos = cos(Consts::PI / 3), const Color& color = Color::WHITE, double intensity = 1.0):
@@ -34,6 +36,10 @@ public:
 
         double energy = intensity()/(distance + 0.1);
 
+        if (_castShadows && _shadowMap) {
+            energy *= _shadowMap->visibility(pixelPosition, pixelNorm);
+        }
+
         double cosAngle = -dir.dot(direction());
         if (cosAngle < _outerConeCos) {
             energy = 0;
@@ -47,8 +53,83 @@ public:
                      std::clamp<int>(dot*color().b()*energy, 0, 255));
     }
 
+    void illuminate(LightingBatch& batch) const override {
+        if (!_castShadows || !_shadowMap) {
+            illuminateSpot(_params, batch);
+            return;
+        }
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch.visibility[i] = _shadowMap->visibility(Vec3D(batch.x[i], batch.y[i], batch.z[i]),
+                                                         Vec3D(batch.nx[i], batch.ny[i], batch.nz[i]));
+        }
+        illuminateSpot(_params, batch, batch.visibility.data());
+    }
+
+    void renderShadows(const Object& world, const Camera&) override {
+        if (!_castShadows) {
+            _shadowMap = nullptr;
+            return;
+        }
+        if (!_shadowMap) {
+            _shadowMap = std::make_shared<ShadowMap>(Consts::SPOT_SHADOW_MAP_SIZE);
+        }
+
+        // The view of the light covers the outer cone (up to 160 degrees) and the radius of the light
+        auto lightBounds = bounds();
+        double fov = std::min(2 * std::acos(std::clamp(lightBounds.coneCos, -1.0, 1.0)) * 180.0 / Consts::PI, 160.0);
+        double zFar = std::min(lightBounds.radius, Consts::SHADOW_DISTANCE);
+
+        _shadowMap->setPerspective(lightBounds.position, lightBounds.direction, fov, 0.1, std::max(zFar, 1.0));
+        _shadowMap->render(world);
+    }
+
+    void prepare() override {
+        LightSource::prepare();
+
+        auto bounds = SpotLight::bounds();
+        Vec3D dir = direction();
+        for (int i = 0; i < 3; i++) {
+            _params.position[i] = static_cast<float>(bounds.position[i]);
+            _params.direction[i] = static_cast<float>(dir[i]);
+        }
+        _params.radius = static_cast<float>(bounds.radius);
+        _params.minDot = 0.1f;
+        _params.innerConeCos = static_cast<float>(_innerConeCos);
+        _params.outerConeCos = static_cast<float>(_outerConeCos);
+    }
+
+    [[nodiscard]] LightBounds bounds() const override {
+        LightBounds bounds;
+        bounds.position = getComponent<TransformMatrix>()->fullPosition();
+
+        // direction() is not normalized, so cosAngle in illuminate() goes up to its length
+        Vec3D dir = direction();
+        double maxCos = dir.abs();
+        if (maxCos < Consts::EPS) {
+            return bounds;
+        }
+        bounds.direction = dir / maxCos;
+        bounds.coneCos = _outerConeCos / maxCos;
+
+        if (_innerConeCos <= _outerConeCos) {
+            // The cone factor is not bounded: we keep the infinite radius
+            return bounds;
+        }
+
+        // Inside the inner cone the energy is scaled up to (maxCos - _outerConeCos) / (_innerConeCos - _outerConeCos)
+        double coneFactor = std::max(1.0, (maxCos - _outerConeCos) / (_innerConeCos - _outerConeCos));
+        double maxColor = std::max({color().r(), color().g(), color().b()});
+        bounds.radius = std::max(intensity()*maxColor*coneFactor - 0.1, 0.0);
+
+        return bounds;
+    }
+
     [[nodiscard]] std::shared_ptr<Component> copy() const override {
-        return std::make_shared<SpotLight>(*this);
+        auto light = std::make_shared<SpotLight>(*this);
+        // Copies have their own shadow maps
+        light->_shadowMap = nullptr;
+        return light;
     }
 
     void start() override {
@@ -3,6 +3,7 @@
 
 #include <components/physics/RigidObject.h>
 #include <utils/Log.h>
+#include <utils/Profiler.h>
 #include <Consts.h>
 
 
@@ -185,6 +186,7 @@ std::pair<bool, Simplex> RigidObject::checkGJKCollision(const std::shared_ptr<Ri
         sup = support(obj, direction);
 
         if (sup.support.dot(direction) <= 0) {
+            PROFILE_COUNT("GJK iterations", iters);
             return std::make_pair(false, points); // no collision
         }
 
@@ -200,9 +202,11 @@ std::pair<bool, Simplex> RigidObject::checkGJKCollision(const std::shared_ptr<Ri
                 obj->_inCollision = true;
             }
             _inCollision = true;
+            PROFILE_COUNT("GJK iterations", iters);
             return std::make_pair(true, points);
         }
     }
+    PROFILE_COUNT("GJK iterations", iters);
     return std::make_pair(false, points);
 }
 
@@ -16,11 +16,13 @@ Material::Material(const MaterialTag &tag, std::shared_ptr<Texture> texture, con
 
 void Material::setAmbient(const Color &color) {
     _ambient = color;
+    _version++;
     checkTransparent();
 }
 
 void Material::setTransparency(double d) {
     _d = d;
+    _version++;
     checkTransparent();
 }
 
@@ -36,6 +36,8 @@ private:
     double _d = 1.0;
 
     bool _isTransparent = false;
+    // Incremented by every setter, so the renderer knows that the material looks different
+    uint32_t _version = 0;
 
     void checkTransparent();
 public:
@@ -61,6 +63,7 @@ public:
     [[nodiscard]] MaterialTag tag() const { return _tag; }
 
     [[nodiscard]] bool isTransparent() const {return _isTransparent; }
+    [[nodiscard]] uint32_t version() const { return _version; }
 };
 
 
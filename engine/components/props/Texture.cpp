@@ -1,43 +1,43 @@
+#include <algorithm>
 #include <cmath>
 
 #include "Texture.h"
 #include "utils/math.h"
-
-#include <iostream>
+#include "utils/Memory.h"
 
 Texture::Texture(const FilePath &filename) : _filename(filename) {
     _texture.emplace_back(filename);
 
-    //Check does the texture have the transparent pixels
-    checkTransparency();
-
-    //Down sample the texture (for mini-mapping)
+    //Down sample the texture (for mini-mapping) and check does the texture have the transparent pixels
     downSample();
 }
 
 Texture::Texture(Image &image) : _filename(image.fileName()) {
     _texture.emplace_back(std::move(image));
 
-    //Check does the texture have the transparent pixels
-    checkTransparency();
-
-    //Down sample the texture (for mini-mapping)
+    //Down sample the texture (for mini-mapping) and check does the texture have the transparent pixels
     downSample();
 }
 
 void Texture::checkTransparency() {
-    for(int x = 0; x < width(); x++) {
-        for(int y = 0; y < height(); y++) {
-            auto pix = get_pixel(x, y);
-            if(pix.a() != 255) {
-                _isTransparent = true;
-                return;
-            }
-        }
-    }
+    _isTransparent = _texture.front().hasTransparentPixels();
 }
 
 void Texture::downSample() {
+    MEMORY_TAG(Textures);
+
+    if (_texture.front().width() * _texture.front().height() <= 1) {
+        // There is nothing to down sample, but we still need to know about the transparency
+        checkTransparency();
+        return;
+    }
+
+    uint16_t levels = 1 + log2_u64(std::max(_texture.front().width(), _texture.front().height()));
+    _texture.reserve(levels);
+
+    // The first level reads every pixel of the original image, so it also gives us the transparency flag
+    _texture.emplace_back(_texture.front().downSampled(_isTransparent));
+
     while (_texture.back().width() * _texture.back().height() != 1) {
         _texture.emplace_back(_texture.back().downSampled());
     }
@@ -68,3 +68,56 @@ const Image& Texture::get_sample(double area) const {
 Color Texture::get_pixel_from_UV(const Vec2D &uv, double area) const {
     return get_sample(area).get_pixel_from_UV(uv);
 }
+
+uint16_t Texture::levelIndex(double texelsPerPixel) const {
+    // Written this way to also handle NaN
+    if (!(texelsPerPixel >= 2)) {
+        return 0;
+    }
+    return std::min<size_t>(std::ilogb(texelsPerPixel), _texture.size() - 1);
+}
+
+const Image& Texture::get_level(double texelsPerPixel) const {
+    return _texture[levelIndex(texelsPerPixel)];
+}
+
+Texture::Footprint Texture::footprint(const Vec2D &duvdx, const Vec2D &duvdy, uint16_t maxAnisotropy) const {
+    // Lengths of the pixel sides in texels
+    double lx = Vec2D(duvdx.x() * width(), duvdx.y() * height()).abs();
+    double ly = Vec2D(duvdy.x() * width(), duvdy.y() * height()).abs();
+
+    double pMax = std::max(lx, ly);
+    double pMin = std::min(lx, ly);
+
+    if (maxAnisotropy <= 1 || pMax < 2) {
+        uint16_t mip = levelIndex(pMax);
+        return {&_texture[mip], Vec2D(0, 0), 1, mip};
+    }
+
+    // Long and thin footprint: we take several samples along the major axis from more detailed level
+    uint16_t samples = maxAnisotropy;
+    if (pMin > Consts::EPS) {
+        samples = static_cast<uint16_t>(std::clamp<double>(std::ceil(pMax / pMin), 1, maxAnisotropy));
+    }
+
+    uint16_t mip = levelIndex(pMax / samples);
+    return {&_texture[mip], lx > ly ? duvdx : duvdy, samples, mip};
+}
+
+Color Texture::get_pixel_from_UV(const Vec2D &uv, const Footprint &footprint) const {
+    if (footprint.samples <= 1) {
+        return footprint.level->get_pixel_from_UV(uv);
+    }
+
+    uint32_t sum[4] = {};
+    for (uint16_t i = 0; i < footprint.samples; i++) {
+        double offset = (i + 0.5) / footprint.samples - 0.5;
+        Color c = footprint.level->get_pixel_from_UV(uv + footprint.axis * offset);
+        for (int j = 0; j < 4; j++) {
+            sum[j] += c[j];
+        }
+    }
+
+    return Color(sum[0] / footprint.samples, sum[1] / footprint.samples,
+                 sum[2] / footprint.samples, sum[3] / footprint.samples);
+}
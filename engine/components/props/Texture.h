@@ -7,6 +7,17 @@
 #include "utils/FilePath.h"
 
 class Texture {
+public:
+    /*
+     * Footprint of one pixel in the texture: the mip level to sample from and,
+     * for anisotropic filtering, the axis (in UV space) along which several samples are averaged.
+     */
+    struct Footprint final {
+        const Image* level = nullptr;
+        Vec2D axis{0, 0};
+        uint16_t samples = 1;
+        uint16_t mip = 0; // index of the level
+    };
 private:
     // For resampling purposes we store resampled versions of the image
     // up until 1x1 image (avg color of the whole texture)
@@ -28,6 +39,16 @@ public:
     [[nodiscard]] const Image& get_sample(double area) const;
     [[nodiscard]] Color get_pixel_from_UV(const Vec2D& uv, double area) const;
 
+    /*
+     * duvdx and duvdy are the changes of UV coordinates when we move one pixel in X and in Y on the screen.
+     * maxAnisotropy is the max number of samples along the major axis (1 disables anisotropic filtering).
+     */
+    [[nodiscard]] Footprint footprint(const Vec2D& duvdx, const Vec2D& duvdy, uint16_t maxAnisotropy = 1) const;
+    [[nodiscard]] Color get_pixel_from_UV(const Vec2D& uv, const Footprint& footprint) const;
+    // The mip level for the given size of the pixel in texels of the original image
+    [[nodiscard]] const Image& get_level(double texelsPerPixel) const;
+    [[nodiscard]] uint16_t levelIndex(double texelsPerPixel) const;
+
     [[nodiscard]] uint16_t width() const { return _texture.front().width(); }
     [[nodiscard]] uint16_t height() const { return _texture.front().height(); }
 
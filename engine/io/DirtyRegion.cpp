@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <io/DirtyRegion.h>
+
+void DirtyRegion::begin(const Camera &camera, uint16_t width, uint16_t height, uint32_t settingsVersion) {
+    _view = {camera.transformMatrix()->fullInvModel(), camera.screenSpaceProjection(), camera.zNear(),
+             width, height, settingsVersion};
+    _meshes.clear();
+    _meshRects.clear();
+    _lights.clear();
+}
+
+void DirtyRegion::addLight(const LightSource &light) {
+    _lights.push_back({&light, light.params(), light.castShadows()});
+}
+
+void DirtyRegion::addMesh(const TriangleMesh &mesh, const TriangleMesh &projected, const Matrix4x4 &model,
+                          const Bounds &bounds) {
+    const Material* material = mesh.getMaterial().get();
+    addState(&mesh, &projected.triangles(), projected.triangles().size(), material,
+             material ? material->version() : 0, model, bounds);
+}
+
+void DirtyRegion::addLines(const LineMesh &lineMesh, const Matrix4x4 &model) {
+    // Lines have no material: the color takes its place
+    addState(&lineMesh, lineMesh.lines().data(), lineMesh.lines().size(), nullptr, lineMesh.getColor().rgba(),
+             model, lineMesh.bounds()*model);
+}
+
+void DirtyRegion::addState(const Component *mesh, const void *triangles, size_t size, const void *material,
+                           uint32_t materialVersion, const Matrix4x4 &model, const Bounds &bounds) {
+    // Instances of one mesh are added one after another
+    uint32_t ordinal = !_meshes.empty() && _meshes.back().mesh == mesh ? _meshes.back().ordinal + 1 : 0;
+    ScreenRect rect = screenRect(bounds);
+    _meshes.push_back({mesh, ordinal, triangles, size, material, materialVersion, model, rect});
+    _meshRects.push_back(rect);
+}
+
+ScreenRect DirtyRegion::finish() {
+    std::sort(_meshes.begin(), _meshes.end());
+
+    bool valid = _valid && _view == _previousView && _lights == _previousLights;
+    bool shadows = std::any_of(_lights.begin(), _lights.end(), [](const auto& light) { return light.castShadows; });
+
+    ScreenRect dirty;
+    if (valid) {
+        // Both lists are sorted by the key: the meshes are matched in one pass
+        size_t i = 0, j = 0;
+        while (i < _meshes.size() || j < _previousMeshes.size()) {
+            if (j == _previousMeshes.size() || (i < _meshes.size() && _meshes[i] < _previousMeshes[j])) {
+                dirty.merge(_meshes[i++].rect);
+            } else if (i == _meshes.size() || _previousMeshes[j] < _meshes[i]) {
+                dirty.merge(_previousMeshes[j++].rect);
+            } else {
+                if (!_meshes[i].sameLook(_previousMeshes[j])) {
+                    dirty.merge(_meshes[i].rect);
+                    dirty.merge(_previousMeshes[j].rect);
+                }
+                i++;
+                j++;
+            }
+        }
+    }
+    if (!valid || (shadows && !dirty.empty())) {
+        dirty = fullRect();
+    }
+
+    std::swap(_meshes, _previousMeshes);
+    std::swap(_lights, _previousLights);
+    _previousView = _view;
+    _valid = true;
+    return dirty;
+}
+
+ScreenRect DirtyRegion::screenRect(const Bounds &bounds) const {
+    Bounds cameraBounds = bounds * _view.worldToCamera;
+    if (cameraBounds.center.z() - cameraBounds.extents.z() <= _view.zNear) {
+        // The bounds contain the camera plane: the projection is not bounded
+        return fullRect();
+    }
+
+    double xMin = std::numeric_limits<double>::max(), xMax = std::numeric_limits<double>::lowest();
+    double yMin = std::numeric_limits<double>::max(), yMax = std::numeric_limits<double>::lowest();
+    for (int i = 0; i < 8; i++) {
+        Vec4D corner = _view.SP * Vec4D(cameraBounds.center.x() + ((i & 1) ? cameraBounds.extents.x() : -cameraBounds.extents.x()),
+                                        cameraBounds.center.y() + ((i & 2) ? cameraBounds.extents.y() : -cameraBounds.extents.y()),
+                                        cameraBounds.center.z() + ((i & 4) ? cameraBounds.extents.z() : -cameraBounds.extents.z()), 1);
+        double x = corner.x() / corner.w();
+        double y = corner.y() / corner.w();
+        xMin = std::min(xMin, x); xMax = std::max(xMax, x);
+        yMin = std::min(yMin, y); yMax = std::max(yMax, y);
+    }
+    if (xMax < 0 || yMax < 0 || xMin >= _view.width || yMin >= _view.height) {
+        return {};
+    }
+
+    // One more pixel around: lines are drawn with the rounded coordinates
+    return {static_cast<int>(std::max(std::floor(xMin) - 1, 0.0)),
+            static_cast<int>(std::max(std::floor(yMin) - 1, 0.0)),
+            static_cast<int>(std::min(std::ceil(xMax) + 1, _view.width - 1.0)),
+            static_cast<int>(std::min(std::ceil(yMax) + 1, _view.height - 1.0))};
+}
@@ -0,0 +1,95 @@
+#ifndef IO_DIRTYREGION_H
+#define IO_DIRTYREGION_H
+
+#include <functional>
+#include <vector>
+
+#include <io/Screen.h>
+#include <objects/Camera.h>
+#include <components/geometry/LineMesh.h>
+
+/*
+ * Finds the part of the screen which changed since the previous frame (incremental rendering).
+ * Every frame the view, the lights and the visible meshes are compared with the previous frame:
+ * a mesh which moved, appeared, disappeared or changed its material, its level of detail or its triangles
+ * adds its old and new rectangles on the screen. Anything that changes the whole picture (the camera,
+ * the resolution, the settings of the screen, the lights) gives the whole screen.
+ * Shadows can fall anywhere, so with a shadow casting light any change gives the whole screen too.
+ * Changes of the textures are not seen: call invalidate() after them.
+ */
+class DirtyRegion final {
+private:
+    struct MeshState final {
+        const Component* mesh;
+        uint32_t ordinal; // instances and copies of one mesh component are told apart by the order
+        const void* triangles;
+        size_t size;
+        const void* material;
+        uint32_t materialVersion;
+        Matrix4x4 model;
+        ScreenRect rect;
+
+        [[nodiscard]] bool sameKey(const MeshState& state) const {
+            return mesh == state.mesh && ordinal == state.ordinal;
+        }
+        [[nodiscard]] bool operator<(const MeshState& state) const {
+            return mesh != state.mesh ? std::less<>()(mesh, state.mesh) : ordinal < state.ordinal;
+        }
+        [[nodiscard]] bool sameLook(const MeshState& state) const {
+            return triangles == state.triangles && size == state.size && material == state.material &&
+                   materialVersion == state.materialVersion && model == state.model;
+        }
+    };
+    struct LightState final {
+        const LightSource* light;
+        LightParams params;
+        bool castShadows;
+
+        bool operator==(const LightState& state) const = default;
+    };
+    struct View final {
+        Matrix4x4 worldToCamera;
+        Matrix4x4 SP;
+        double zNear = 0;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        uint32_t settingsVersion = 0;
+
+        bool operator==(const View& view) const = default;
+    };
+
+    View _view;
+    View _previousView;
+    bool _valid = false;
+
+    // The meshes of the frame in the order of addMesh() (sorted in finish()) and of the previous frame (sorted)
+    std::vector<MeshState> _meshes;
+    std::vector<MeshState> _previousMeshes;
+    std::vector<ScreenRect> _meshRects;
+    std::vector<LightState> _lights;
+    std::vector<LightState> _previousLights;
+
+    void addState(const Component* mesh, const void* triangles, size_t size, const void* material,
+                  uint32_t materialVersion, const Matrix4x4& model, const Bounds& bounds);
+    [[nodiscard]] ScreenRect fullRect() const { return {0, 0, _view.width - 1, _view.height - 1}; }
+public:
+    // Starts the frame: the screen size is the render resolution
+    void begin(const Camera& camera, uint16_t width, uint16_t height, uint32_t settingsVersion);
+
+    void addLight(const LightSource& light);
+    // bounds are the world space bounds of the mesh, projected is the mesh or its level of detail
+    void addMesh(const TriangleMesh& mesh, const TriangleMesh& projected, const Matrix4x4& model, const Bounds& bounds);
+    void addLines(const LineMesh& lineMesh, const Matrix4x4& model);
+
+    // The rectangle which should be drawn again (empty if nothing changed). The frame becomes the previous one.
+    [[nodiscard]] ScreenRect finish();
+    // The next frame is drawn completely
+    void invalidate() { _valid = false; }
+
+    // The rectangle of the i-th mesh of the frame (in the order of addMesh())
+    [[nodiscard]] const ScreenRect& meshRect(size_t i) const { return _meshRects[i]; }
+    // Pixels which world space bounds can cover (the whole screen if they cross the camera plane)
+    [[nodiscard]] ScreenRect screenRect(const Bounds& bounds) const;
+};
+
+#endif //IO_DIRTYREGION_H
@@ -1,8 +1,17 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "linalg/Vec3D.h"
 #include "Image.h"
 #include <Consts.h>
+#include <utils/parallel.h>
+#include <utils/Profiler.h>
+#include <utils/Memory.h>
 
 Image::Image(uint16_t width, uint16_t height) : _width(width), _height(height), _valid(true) {
     if(width != 0 && height != 0) {
@@ -297,30 +306,112 @@ Color Image::get_pixel_from_UV(const Vec2D& uv, CLAMP_MODE mode, bool bottomUp)
     }
 }
 
+/*
+ * Box filter for one output row: every output texel is the rounded average of the 2x2 block of source texels.
+ * 'row0' and 'row1' are the two source rows (they are the same row when the source has the height of 1).
+ * Returns the AND of all alpha values that were read, so the caller can tell if there are transparent texels.
+ */
+static uint8_t downSampleRow(const png_byte* row0, const png_byte* row1, png_byte* dst,
+                             uint16_t srcWidth, uint16_t dstWidth) {
+    uint16_t x = 0;
+    uint8_t alpha = 255;
+
+#if defined(__SSE2__)
+    if (srcWidth > 1) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        __m128i alphaMask = _mm_set1_epi8(-1);
+
+        // 4 source texels (16 bytes) from each row give 2 output texels per iteration
+        for (; x + 2 <= dstWidth; x += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+            alphaMask = _mm_and_si128(alphaMask, _mm_and_si128(a, b));
+
+            // Vertical sum in 16 bits: lo = texels 0 and 1, hi = texels 2 and 3
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+            // Horizontal sum of the neighbour texels
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+            __m128i sum = _mm_unpacklo_epi64(lo, hi);
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(sum, zero));
+        }
+
+        alignas(16) uint8_t alphaBytes[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(alphaBytes), alphaMask);
+        alpha = alphaBytes[3] & alphaBytes[7] & alphaBytes[11] & alphaBytes[15];
+    }
+#endif
+
+    for (; x < dstWidth; x++) {
+        size_t x0 = static_cast<size_t>(2 * x) * 4;
+        size_t x1 = static_cast<size_t>(std::min<uint16_t>(2 * x + 1, srcWidth - 1)) * 4;
+        for (size_t c = 0; c < 4; c++) {
+            dst[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2;
+        }
+        alpha &= row0[x0 + 3] & row0[x1 + 3] & row1[x0 + 3] & row1[x1 + 3];
+    }
+
+    return alpha;
+}
+
 Image Image::downSampled() const {
+    bool isTransparent;
+    return downSampled(isTransparent);
+}
+
+Image Image::downSampled(bool& isTransparent) const {
     auto newWidth = std::max<uint16_t>(_width/2, 1);
     auto newHeight = std::max<uint16_t>(_height/2, 1);
     Image newImage = Image(newWidth, newHeight);
 
-    for (size_t y = 0; y < newHeight; y++) {
-        for(size_t x = 0; x < newWidth; x++) {
-            uint16_t r, g, b, a;
-            Color tmpColor = get_pixel(x * 2, y * 2);
-            r = tmpColor.r(); g = tmpColor.g(); b = tmpColor.b(); a = tmpColor.a();
-
-            tmpColor = get_pixel(x * 2 + 1, y * 2);
-            r += tmpColor.r(); g += tmpColor.g(); b += tmpColor.b(); a += tmpColor.a();
-
-            tmpColor = get_pixel(x * 2, y * 2 + 1);
-            r += tmpColor.r(); g += tmpColor.g(); b += tmpColor.b(); a += tmpColor.a();
-
-            tmpColor = get_pixel(x * 2 + 1, y * 2 + 1);
-            r += tmpColor.r(); g += tmpColor.g(); b += tmpColor.b(); a += tmpColor.a();
+    std::atomic<bool> transparent = false;
+    png_bytep dstData = newImage._data;
+
+    // Rows of the level are independent, so big levels are split between several threads
+    parallelFor(0, newHeight, [this, dstData, newWidth, &transparent](size_t yFrom, size_t yTo) {
+        PROFILE_SCOPE("mip rows");
+        MEMORY_TAG(Textures);
+        uint8_t alpha = 255;
+        for (size_t y = yFrom; y < yTo; y++) {
+            const png_byte* row0 = _data + std::min<size_t>(2 * y, _height - 1) * _width * 4;
+            const png_byte* row1 = _data + std::min<size_t>(2 * y + 1, _height - 1) * _width * 4;
+            alpha &= downSampleRow(row0, row1, dstData + y * newWidth * 4, _width, newWidth);
+        }
+        if (alpha != 255) {
+            transparent = true;
+        }
+    }, std::max<size_t>(1, 64*1024 / (newWidth + 1)));
 
-            tmpColor = Color(r / 4, g / 4, b / 4, a / 4);
-            newImage.set_pixel(x, y, tmpColor);
+    // With odd sizes the last column and the last row are not covered by the filter
+    // (the same as before), but they still count for the transparency flag.
+    if (!transparent && _width > 1 && _width % 2 == 1) {
+        for (size_t y = 0; y < _height && !transparent; y++) {
+            transparent = _data[(y * _width + _width - 1) * 4 + 3] != 255;
+        }
+    }
+    if (!transparent && _height > 1 && _height % 2 == 1) {
+        for (size_t x = 0; x < _width && !transparent; x++) {
+            transparent = _data[((_height - 1) * _width + x) * 4 + 3] != 255;
         }
     }
 
+    isTransparent = transparent;
     return newImage;
 }
+
+bool Image::hasTransparentPixels() const {
+    if (!_data) {
+        return false;
+    }
+    size_t size = static_cast<size_t>(_width) * _height * 4;
+    uint8_t alpha = 255;
+    for (size_t i = 3; i < size; i += 4) {
+        alpha &= _data[i];
+    }
+    return alpha != 255;
+}
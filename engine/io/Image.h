@@ -43,7 +43,14 @@ public:
     [[nodiscard]] Color get_pixel_unsafe(uint16_t x, uint16_t y) const;
     [[nodiscard]] Color get_pixel(uint16_t x, uint16_t y) const;
     [[nodiscard]] Color get_pixel_from_UV(const Vec2D& uv, CLAMP_MODE mode = REPEAT, bool bottomUp = true) const;
+    /*
+     * Returns the image two times smaller in each dimension (2x2 box filter).
+     * The second version also reports if any pixel of this image has alpha != 255:
+     * the filter reads every pixel anyway, so this check is almost free there.
+     */
     [[nodiscard]] Image downSampled() const;
+    [[nodiscard]] Image downSampled(bool& isTransparent) const;
+    [[nodiscard]] bool hasTransparentPixels() const;
 
     CODE save2png(const FilePath& file_name, uint16_t bit_depth = 8);
 
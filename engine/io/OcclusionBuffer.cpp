@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <io/OcclusionBuffer.h>
+
+namespace {
+    // An object is occluded only if the occluder is closer than this relative margin (faces of a box can be exactly on its bounds)
+    constexpr float DEPTH_BIAS = 1e-4f;
+}
+
+OcclusionBuffer::OcclusionBuffer(uint16_t width, uint16_t height) :
+    _width(static_cast<uint16_t>((width + 3) & ~3)), _height(height),
+    _invW(static_cast<size_t>(_width) * _height, 0.0f) {}
+
+void OcclusionBuffer::clear(const Camera &camera, uint16_t screenWidth, uint16_t screenHeight) {
+    std::fill(_invW.begin(), _invW.end(), 0.0f);
+
+    _worldToCamera = camera.transformMatrix()->fullInvModel();
+    _SP = camera.screenSpaceProjection();
+    _zNear = camera.zNear();
+    _scaleX = static_cast<double>(_width) / screenWidth;
+    _scaleY = static_cast<double>(_height) / screenHeight;
+}
+
+void OcclusionBuffer::rasterize(const std::vector<Triangle> &triangles, const Matrix4x4 &model) {
+    Matrix4x4 objectToCamera = _worldToCamera * model;
+
+    for (const auto& t : triangles) {
+        std::array<Vec4D, 3> points{objectToCamera * t[0], objectToCamera * t[1], objectToCamera * t[2]};
+
+        // Back faces are hidden by the front faces of the same occluder
+        Vec3D normal = Vec3D(points[1] - points[0]).cross(Vec3D(points[2] - points[0]));
+        if (normal.dot(Vec3D(points[0])) > 0) {
+            continue;
+        }
+        // Triangles crossing the near plane are not clipped: we just do not use them
+        if (points[0].z() <= _zNear || points[1].z() <= _zNear || points[2].z() <= _zNear) {
+            continue;
+        }
+
+        rasterizeTriangle(points);
+    }
+}
+
+void OcclusionBuffer::rasterizeTriangle(const std::array<Vec4D, 3> &points) {
+    double x[3], y[3], invW[3];
+    for (int i = 0; i < 3; i++) {
+        Vec4D projected = _SP * points[i];
+        invW[i] = 1.0 / projected.w();
+        x[i] = projected.x() * invW[i] * _scaleX;
+        y[i] = projected.y() * invW[i] * _scaleY;
+    }
+
+    double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (std::abs(area) < Consts::EPS) {
+        return;
+    }
+    if (area < 0) {
+        // The edge functions are positive inside of the triangle
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(invW[1], invW[2]);
+        area = -area;
+    }
+
+    double xMin = std::min({x[0], x[1], x[2]}), xMax = std::max({x[0], x[1], x[2]});
+    double yMin = std::min({y[0], y[1], y[2]}), yMax = std::max({y[0], y[1], y[2]});
+    if (xMax < 0 || yMax < 0 || xMin >= _width || yMin >= _height) {
+        return;
+    }
+    // Only the pixels which are completely inside can be written. x0 is aligned to the group of 4 pixels.
+    int x0 = static_cast<int>(std::clamp<double>(std::ceil(xMin), 0, _width)) & ~3;
+    int x1 = static_cast<int>(std::clamp<double>(std::floor(xMax), 0, _width));
+    int y0 = static_cast<int>(std::clamp<double>(std::ceil(yMin), 0, _height));
+    int y1 = static_cast<int>(std::clamp<double>(std::floor(yMax), 0, _height));
+
+    /*
+     * E(px, py) = A*px + B*py + C for every edge. The pixel [px, px + 1] x [py, py + 1] is inside the edge
+     * if E is not negative in its worst corner, which adds min(A, 0) + min(B, 0) to E in (px, py).
+     * The same for the depth plane: its minimum over the pixel is the farthest depth.
+     */
+    double A[3], B[3], C[3];
+    float a[3];
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        A[i] = y[i] - y[j];
+        B[i] = x[j] - x[i];
+        C[i] = -A[i] * x[i] - B[i] * y[i] + std::min(A[i], 0.0) + std::min(B[i], 0.0);
+        a[i] = static_cast<float>(A[i]);
+    }
+    // 1/w = dA*px + dB*py + dC (the plane through the three vertices)
+    double dA = ((invW[1] - invW[0]) * (y[2] - y[0]) - (invW[2] - invW[0]) * (y[1] - y[0])) / area;
+    double dB = ((invW[2] - invW[0]) * (x[1] - x[0]) - (invW[1] - invW[0]) * (x[2] - x[0])) / area;
+    double dC = invW[0] - dA * x[0] - dB * y[0] + std::min(dA, 0.0) + std::min(dB, 0.0);
+    auto fA = static_cast<float>(dA);
+
+    for (int py = y0; py < y1; py++) {
+        float* row = _invW.data() + static_cast<size_t>(py) * _width;
+        // Row starts are in double: close triangles have huge coordinates, C cancels out only in the buffer
+        auto e0 = static_cast<float>(B[0] * py + C[0]);
+        auto e1 = static_cast<float>(B[1] * py + C[1]);
+        auto e2 = static_cast<float>(B[2] * py + C[2]);
+        auto depth = static_cast<float>(dB * py + dC);
+
+#if defined(__SSE2__)
+        const __m128 offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        const __m128 zero = _mm_setzero_ps();
+        for (int px = x0; px < x1; px += 4) {
+            __m128 fx = _mm_add_ps(_mm_set1_ps(static_cast<float>(px)), offsets);
+            __m128 inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), fx), _mm_set1_ps(e0)), zero),
+                               _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), fx), _mm_set1_ps(e1)), zero)),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), fx), _mm_set1_ps(e2)), zero));
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+            __m128 old = _mm_loadu_ps(row + px);
+            __m128 value = _mm_max_ps(old, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(fA), fx), _mm_set1_ps(depth)));
+            _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, value), _mm_andnot_ps(inside, old)));
+        }
+#else
+        for (int px = x0; px < x1; px++) {
+            auto fx = static_cast<float>(px);
+            if (a[0] * fx + e0 >= 0 && a[1] * fx + e1 >= 0 && a[2] * fx + e2 >= 0) {
+                row[px] = std::max(row[px], fA * fx + depth);
+            }
+        }
+#endif
+    }
+}
+
+bool OcclusionBuffer::isOccluded(const Bounds &bounds) const {
+    Bounds cameraBounds = bounds * _worldToCamera;
+    double zMin = cameraBounds.center.z() - cameraBounds.extents.z();
+    if (zMin <= _zNear) {
+        // The bounds contain the camera plane: the projection is not bounded
+        return false;
+    }
+
+    double xMin = std::numeric_limits<double>::max(), xMax = std::numeric_limits<double>::lowest();
+    double yMin = std::numeric_limits<double>::max(), yMax = std::numeric_limits<double>::lowest();
+    for (int i = 0; i < 8; i++) {
+        Vec4D corner = _SP * Vec4D(cameraBounds.center.x() + ((i & 1) ? cameraBounds.extents.x() : -cameraBounds.extents.x()),
+                                   cameraBounds.center.y() + ((i & 2) ? cameraBounds.extents.y() : -cameraBounds.extents.y()),
+                                   cameraBounds.center.z() + ((i & 4) ? cameraBounds.extents.z() : -cameraBounds.extents.z()), 1);
+        double x = corner.x() / corner.w() * _scaleX;
+        double y = corner.y() / corner.w() * _scaleY;
+        xMin = std::min(xMin, x); xMax = std::max(xMax, x);
+        yMin = std::min(yMin, y); yMax = std::max(yMax, y);
+    }
+    if (xMax < 0 || yMax < 0 || xMin >= _width || yMin >= _height) {
+        // Outside of the screen: that is the job of the frustum culling
+        return false;
+    }
+
+    int x0 = static_cast<int>(std::clamp<double>(std::floor(xMin), 0, _width - 1));
+    int x1 = static_cast<int>(std::clamp<double>(std::floor(xMax), 0, _width - 1));
+    int y0 = static_cast<int>(std::clamp<double>(std::floor(yMin), 0, _height - 1));
+    int y1 = static_cast<int>(std::clamp<double>(std::floor(yMax), 0, _height - 1));
+
+    // The closest point of the bounds should be behind the occluders everywhere
+    auto invW = static_cast<float>(1.0 / zMin) * (1.0f + DEPTH_BIAS);
+    for (int py = y0; py <= y1; py++) {
+        const float* row = _invW.data() + static_cast<size_t>(py) * _width;
+        for (int px = x0; px <= x1; px++) {
+            if (row[px] <= invW) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
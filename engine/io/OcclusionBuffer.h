@@ -0,0 +1,50 @@
+#ifndef IO_OCCLUSIONBUFFER_H
+#define IO_OCCLUSIONBUFFER_H
+
+#include <vector>
+
+#include <objects/Camera.h>
+#include <ScalarConsts.h>
+
+/*
+ * Low resolution depth of the biggest occluders of the frame: objects whose screen rectangle is behind
+ * the occluders in every pixel of the buffer are not projected at all.
+ *
+ * The buffer keeps 1/w (it is linear in the screen space, 0 is an empty pixel). Rasterization is conservative:
+ * a pixel is written only when a triangle covers it completely, and it gets the farthest depth of the triangle
+ * over the pixel. So an object is never culled by something that is not in front of it on the screen.
+ * Works with a perspective camera only.
+ */
+class OcclusionBuffer final {
+private:
+    uint16_t _width;
+    uint16_t _height;
+    std::vector<float> _invW;
+
+    Matrix4x4 _worldToCamera = Matrix4x4::Identity();
+    Matrix4x4 _SP = Matrix4x4::Identity();
+    double _zNear = 0;
+    // From the screen pixels to the pixels of the buffer
+    double _scaleX = 1;
+    double _scaleY = 1;
+
+    void rasterizeTriangle(const std::array<Vec4D, 3>& points);
+public:
+    // The width is rounded up to the multiple of 4 (rows are processed by 4 pixels)
+    explicit OcclusionBuffer(uint16_t width = Consts::OCCLUSION_BUFFER_WIDTH,
+                             uint16_t height = Consts::OCCLUSION_BUFFER_HEIGHT);
+
+    // Empties the buffer and takes the view of the camera for the frame
+    void clear(const Camera& camera, uint16_t screenWidth, uint16_t screenHeight);
+
+    // Adds the front faces of the triangles (in the object space) to the buffer
+    void rasterize(const std::vector<Triangle>& triangles, const Matrix4x4& model);
+
+    // True if the world space bounds are hidden behind the occluders in every pixel they cover
+    [[nodiscard]] bool isOccluded(const Bounds& bounds) const;
+
+    [[nodiscard]] uint16_t width() const { return _width; }
+    [[nodiscard]] uint16_t height() const { return _height; }
+};
+
+#endif //IO_OCCLUSIONBUFFER_H
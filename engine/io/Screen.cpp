@@ -1,16 +1,64 @@
 #include <algorithm>
 #include <utility>
 #include <cmath>
+#include <limits>
+#include <span>
 
 #include "SDL.h"
 
 #include <io/Screen.h>
+#include <linalg/Vec3DFloat.h>
 #include <utils/Time.h>
 #include <utils/Log.h>
+#include <utils/Profiler.h>
 #include <utils/stack_vector.h>
 #include <utils/ResourceManager.h>
 #include <components/lighting/DirectionalLight.h>
 
+namespace {
+    // Weights of the transparent pixels (order independent transparency): scale * (1 - z)^3 clamped to [min, max]
+    constexpr float OIT_WEIGHT_SCALE = 3e3f;
+    constexpr float OIT_MIN_WEIGHT = 1e-2f;
+    constexpr float OIT_MAX_WEIGHT = 3e3f;
+    // Vertices of this number of triangles with the same lights at most are lit in one batch (it stays in L1)
+    constexpr size_t LIGHTING_RUN_TRIANGLES = 64;
+
+    /*
+     * Turns the runtime flags into template arguments: func.template operator()<flags...>() is called, so
+     * a kernel is instantiated for every combination of the flags and the choice is made once per triangle.
+     */
+    template<auto... Values, typename Func>
+    inline void dispatchFlags(Func&& func) {
+        func.template operator()<Values...>();
+    }
+    template<auto... Values, typename Func, typename... Flags>
+    inline void dispatchFlags(Func&& func, BlendMode blend, Flags... flags);
+
+    template<auto... Values, typename Func, typename... Flags>
+    inline void dispatchFlags(Func&& func, bool flag, Flags... flags) {
+        if (flag) {
+            dispatchFlags<Values..., true>(func, flags...);
+        } else {
+            dispatchFlags<Values..., false>(func, flags...);
+        }
+    }
+
+    template<auto... Values, typename Func, typename... Flags>
+    inline void dispatchFlags(Func&& func, BlendMode blend, Flags... flags) {
+        switch (blend) {
+            case BlendMode::Opaque:
+                dispatchFlags<Values..., BlendMode::Opaque>(func, flags...);
+                break;
+            case BlendMode::Blend:
+                dispatchFlags<Values..., BlendMode::Blend>(func, flags...);
+                break;
+            case BlendMode::OrderIndependent:
+                dispatchFlags<Values..., BlendMode::OrderIndependent>(func, flags...);
+                break;
+        }
+    }
+}
+
 extern "C" {
 #include "io/microui/microui.h"
 }
@@ -24,25 +72,29 @@ void Screen::open(uint16_t screenWidth, uint16_t screenHeight, const Color& back
     _background = background;
     _width = screenWidth;
     _height = screenHeight;
+    setViewport(screenWidth, screenHeight);
 
     _isOpen = true;
 
-    SDL_Init(SDL_INIT_VIDEO);
-    SDL_CreateWindowAndRenderer(_width*Consts::SCREEN_SCALE, _height*Consts::SCREEN_SCALE, 0, &_window, &_renderer);
-    SDL_RenderSetLogicalSize(_renderer, _width, _height);
+    if(!_headless) {
+        SDL_Init(SDL_INIT_VIDEO);
+        SDL_CreateWindowAndRenderer(_width*Consts::SCREEN_SCALE, _height*Consts::SCREEN_SCALE, 0, &_window, &_renderer);
+        SDL_RenderSetLogicalSize(_renderer, _width, _height);
 
-    SDL_SetRenderDrawColor(_renderer, background.r(), background.g(), background.b(), background.a());
-    SDL_RenderClear(_renderer);
-    SDL_SetRelativeMouseMode(SDL_TRUE);
-    SDL_ShowCursor(SDL_DISABLE);
+        SDL_SetRenderDrawColor(_renderer, background.r(), background.g(), background.b(), background.a());
+        SDL_RenderClear(_renderer);
+        SDL_SetRelativeMouseMode(SDL_TRUE);
+        SDL_ShowCursor(SDL_DISABLE);
 
-    _screenTexture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, _width, _height);
+        _screenTexture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, _width, _height);
+    }
     _pixelBuffer.resize(_width * _height);
     _depthBuffer.resize(_width * _height);
+    allocateTransparencyBuffers();
 
     // Initialize SDL_ttf
     if ( TTF_Init() < 0 ) {
-        Log::log("Screen::open(): error initializing SDL_ttf: " + std::string(TTF_GetError()));
+        LOG_ERROR("Screen::open(): error initializing SDL_ttf: " + std::string(TTF_GetError()));
     }
 
     Log::log("Screen::open(): initialized and opened the screen");
@@ -60,7 +112,7 @@ void Screen::display() {
         fwrite(_data, sizeof(png_byte), _height * _width * 4, _ffmpeg);
     }
 
-    if(_isOpen) {
+    if(_isOpen && !_headless) {
         SDL_UpdateTexture(_screenTexture, NULL, _pixelBuffer.data(), _width * 4);
         SDL_RenderCopy(_renderer, _screenTexture, NULL, NULL);
         SDL_RenderPresent(_renderer);
@@ -100,11 +152,106 @@ void Screen::stopRender() {
     }
 }
 
+void Screen::setViewport(uint16_t width, uint16_t height) {
+    _viewportWidth = std::min(width, _width);
+    _viewportHeight = std::min(height, _height);
+    _renderWidth = _viewportWidth;
+    _renderHeight = _viewportHeight;
+}
+
+void Screen::setRenderResolution(uint16_t width, uint16_t height) {
+    _renderWidth = std::clamp<uint16_t>(width, 1, _viewportWidth);
+    _renderHeight = std::clamp<uint16_t>(height, 1, _viewportHeight);
+}
+
+void Screen::upscale() {
+    if (_renderWidth == _viewportWidth && _renderHeight == _viewportHeight) {
+        return;
+    }
+    PROFILE_SCOPE("upscale");
+
+    // The source is overwritten by the result, so it is copied first
+    _upscaleBuffer.resize(static_cast<size_t>(_renderWidth) * _renderHeight);
+    for (uint16_t y = 0; y < _renderHeight; y++) {
+        std::copy_n(_pixelBuffer.begin() + y * _width, _renderWidth, _upscaleBuffer.begin() + y * _renderWidth);
+    }
+
+    /*
+     * Centers of the pixels are matched (the same as GPUs sample textures). Weights are 8 bit fixed point:
+     * the two channels of every 0x00FF00FF half of the pixel are interpolated with one multiplication.
+     */
+    auto source = [](uint16_t i, uint16_t from, uint16_t to) {
+        double s = std::max((i + 0.5) * from / to - 0.5, 0.0);
+        auto s0 = std::min(static_cast<uint32_t>(s), static_cast<uint32_t>(from - 1));
+        auto weight = static_cast<uint32_t>((s - s0) * 256);
+        return std::make_pair(s0, std::min(weight, 256u));
+    };
+    auto lerp = [](uint32_t a, uint32_t b, uint32_t weight) {
+        uint32_t rb = (((a & 0x00FF00FFu) * (256 - weight) + (b & 0x00FF00FFu) * weight) >> 8) & 0x00FF00FFu;
+        uint32_t ga = ((((a >> 8) & 0x00FF00FFu) * (256 - weight) + ((b >> 8) & 0x00FF00FFu) * weight) >> 8) & 0x00FF00FFu;
+        return rb | (ga << 8);
+    };
+
+    _upscaleColumns.resize(_viewportWidth);
+    for (uint16_t x = 0; x < _viewportWidth; x++) {
+        _upscaleColumns[x] = source(x, _renderWidth, _viewportWidth);
+    }
+
+    // One pass over a few hundred thousand pixels is bound by the memory: threads started every frame cost more
+    for (uint16_t y = 0; y < _viewportHeight; y++) {
+        auto [y0, wy] = source(y, _renderHeight, _viewportHeight);
+        const uint32_t* row0 = _upscaleBuffer.data() + y0 * _renderWidth;
+        const uint32_t* row1 = row0 + (y0 + 1 < _renderHeight ? _renderWidth : 0);
+        uint32_t* out = _pixelBuffer.data() + static_cast<size_t>(y) * _width;
+        for (uint16_t x = 0; x < _viewportWidth; x++) {
+            auto [x0, wx] = _upscaleColumns[x];
+            uint32_t x1 = std::min<uint32_t>(x0 + 1, _renderWidth - 1);
+            out[x] = lerp(lerp(row0[x0], row0[x1], wx), lerp(row1[x0], row1[x1], wx), wy);
+        }
+    }
+}
+
 void Screen::clear() {
     std::fill(_depthBuffer.begin(), _depthBuffer.end(), 1.0f);
     std::fill(_pixelBuffer.begin(), _pixelBuffer.end(), _background.rgba());
 }
 
+void Screen::clear(const ScreenRect &rect) {
+    ScreenRect area = rect;
+    area.x0 = std::max(area.x0, 0);
+    area.y0 = std::max(area.y0, 0);
+    area.x1 = std::min<int>(area.x1, _width - 1);
+    area.y1 = std::min<int>(area.y1, _height - 1);
+    if (area.empty()) {
+        return;
+    }
+    for (int y = area.y0; y <= area.y1; y++) {
+        size_t offset = static_cast<size_t>(y) * _width + area.x0;
+        std::fill_n(_depthBuffer.begin() + offset, area.x1 - area.x0 + 1, 1.0f);
+        std::fill_n(_pixelBuffer.begin() + offset, area.x1 - area.x0 + 1, _background.rgba());
+    }
+}
+
+void Screen::saveScene() {
+    _sceneWidth = _renderWidth;
+    _sceneHeight = _renderHeight;
+    _sceneBuffer.resize(static_cast<size_t>(_sceneWidth) * _sceneHeight);
+    for (uint16_t y = 0; y < _sceneHeight; y++) {
+        std::copy_n(_pixelBuffer.begin() + y * _width, _sceneWidth, _sceneBuffer.begin() + y * _sceneWidth);
+    }
+}
+
+void Screen::restoreScene() {
+    std::fill(_pixelBuffer.begin(), _pixelBuffer.end(), _background.rgba());
+    // The scene of another resolution is useless: the whole scene is drawn again anyway
+    if (_sceneWidth != _renderWidth || _sceneHeight != _renderHeight) {
+        return;
+    }
+    for (uint16_t y = 0; y < _sceneHeight; y++) {
+        std::copy_n(_sceneBuffer.begin() + y * _sceneWidth, _sceneWidth, _pixelBuffer.begin() + y * _width);
+    }
+}
+
 void Screen::drawPixel(int x, const int y, const Color &color) {
     if(x >= _width || y >= _height || x < 0 || y < 0)
         return;
@@ -115,6 +262,9 @@ void Screen::drawPixel(int x, const int y, const Color &color) {
 void Screen::drawPixel(int x, int y, double z, const Color &color) {
     if(x >= _width || y >= _height || x < 0 || y < 0)
         return;
+    // The scene (the pixels with the depth) is cut by the scissor
+    if(x < _scissor.x0 || x > _scissor.x1 || y < _scissor.y0 || y > _scissor.y1)
+        return;
 
     if(checkPixelDepth(x, y, z)) {
         drawPixelUnsafe(x, y, color);
@@ -134,6 +284,10 @@ inline void Screen::drawPixelUnsafe(uint16_t x, uint16_t y, const Color &color)
 
 inline void Screen::drawPixelUnsafe(uint16_t x, uint16_t y, double z, const Color &color) {
     if (checkPixelDepth(x, y, z)) {
+        if (_orderIndependentTransparency && color.a() != 255 && _enableTransparency) {
+            accumulateTransparent(x, y, z, color);
+            return;
+        }
         drawPixelUnsafe(x, y, color);
 
         if(color.a() == 255 || !_enableTransparency) {
@@ -142,10 +296,103 @@ inline void Screen::drawPixelUnsafe(uint16_t x, uint16_t y, double z, const Colo
     }
 }
 
+void Screen::setOrderIndependentTransparency(bool enable) {
+    changeSetting(_orderIndependentTransparency, enable);
+    allocateTransparencyBuffers();
+}
+
+void Screen::allocateTransparencyBuffers() {
+    if (!_orderIndependentTransparency) {
+        return;
+    }
+    _transparentAccum.resize(static_cast<size_t>(_width) * _height);
+    _transparentRevealage.resize(static_cast<size_t>(_width) * _height, 1.0f);
+}
+
+inline void Screen::accumulateTransparent(uint16_t x, uint16_t y, double z, const Color &color) {
+    size_t offset = y * _width + x;
+
+    // McGuire-Bavoil weighted blended OIT, w = alpha * clamp(3e3 * (1 - z)^3): close surfaces dominate the average
+    float alpha = color.a() / 255.0f;
+    auto distance = static_cast<float>(std::clamp(1.0 - z, 0.0, 1.0));
+    float weight = alpha * std::clamp(OIT_WEIGHT_SCALE * distance * distance * distance, OIT_MIN_WEIGHT, OIT_MAX_WEIGHT);
+
+    auto& accum = _transparentAccum[offset];
+    accum[0] += color.r() * weight;
+    accum[1] += color.g() * weight;
+    accum[2] += color.b() * weight;
+    accum[3] += weight;
+    _transparentRevealage[offset] *= 1.0f - alpha;
+    _transparentRect.merge({x, y, x, y});
+}
+
+void Screen::resolveTransparency() {
+    if (_transparentRect.empty()) {
+        return;
+    }
+    PROFILE_SCOPE("resolve transparency");
+
+    for (int y = _transparentRect.y0; y <= _transparentRect.y1; y++) {
+        for (int x = _transparentRect.x0; x <= _transparentRect.x1; x++) {
+            size_t offset = y * _width + x;
+            float revealage = _transparentRevealage[offset];
+            if (revealage >= 1.0f) {
+                continue;
+            }
+            auto& accum = _transparentAccum[offset];
+
+            // The weighted average of the transparent colors covers 1 - revealage of the scene
+            float coverage = 1.0f - revealage;
+            float norm = coverage / std::max(accum[3], std::numeric_limits<float>::min());
+            Color scene(_pixelBuffer[offset]);
+            _pixelBuffer[offset] = Color(
+                    static_cast<uint8_t>(std::min(accum[0] * norm + scene.r() * revealage, 255.0f)),
+                    static_cast<uint8_t>(std::min(accum[1] * norm + scene.g() * revealage, 255.0f)),
+                    static_cast<uint8_t>(std::min(accum[2] * norm + scene.b() * revealage, 255.0f)),
+                    static_cast<uint8_t>(std::min(255.0f * coverage + scene.a() * revealage, 255.0f))).rgba();
+
+            accum = {};
+            _transparentRevealage[offset] = 1.0f;
+        }
+    }
+    _transparentRect = {};
+}
+
 inline bool Screen::checkPixelDepth(uint16_t x, uint16_t y, double z) const {
     return z < _depthBuffer[y * _width + x] || !_depthTest;
 }
 
+template<bool DepthTest>
+inline bool Screen::testDepth(uint16_t x, uint16_t y, double z) const {
+    return !DepthTest || z < _depthBuffer[y * _width + x];
+}
+
+template<BlendMode Blend>
+inline void Screen::writePixel(uint16_t x, uint16_t y, double z, const Color &color) {
+    size_t offset = y * _width + x;
+
+    // Opaque pixels of transparent triangles (and the borders) are written as usual
+    if (Blend == BlendMode::Opaque || color.a() == 255) {
+        _pixelBuffer[offset] = color.rgba();
+        _depthBuffer[offset] = z;
+    } else if constexpr (Blend == BlendMode::Blend) {
+        _pixelBuffer[offset] = color.blend(Color(_pixelBuffer[offset])).rgba();
+    } else {
+        accumulateTransparent(x, y, z, color);
+    }
+}
+
+ScreenRect Screen::rasterArea() const {
+    return _wholeWindow ? ScreenRect{0, 0, _width - 1, _height - 1} : ScreenRect{0, 0, _renderWidth - 1, _renderHeight - 1};
+}
+
+BlendMode Screen::blendMode(bool transparent) const {
+    if (!transparent || !_enableTransparency) {
+        return BlendMode::Opaque;
+    }
+    return _orderIndependentTransparency ? BlendMode::OrderIndependent : BlendMode::Blend;
+}
+
 void Screen::plotLineLow(int x_from, int y_from, int x_to, int y_to, const Color &color, uint16_t thickness) {
     int dx = x_to - x_from;
     int dy = y_to - y_from;
@@ -300,6 +547,70 @@ void Screen::drawLine(const Vec2D &from, const Vec2D &to, const Color &color, ui
     drawLine((int)from.x(), (int)from.y(), (int)to.x(), (int)to.y(), color, thickness);
 }
 
+// The same as Triangle::abgBarycCoord(const Vec2D&) for the screen space positions of the projected triangle
+Vec3D abgBarycCoord(const ProjectedTriangle& triangle, const Vec2D& point) {
+    Vec2D ab(triangle[1].x - triangle[0].x, triangle[1].y - triangle[0].y);
+    Vec2D ac(triangle[2].x - triangle[0].x, triangle[2].y - triangle[0].y);
+    Vec2D ap(point.x() - triangle[0].x, point.y() - triangle[0].y);
+
+    bool swapped = std::abs(ac.y()) < std::abs(ab.y());
+    if (swapped) {
+        std::swap(ab, ac);
+    }
+
+    double betta = (ap.y() * ac.x() - ap.x() * ac.y()) /
+                   (ab.y() * ac.x() - ab.x() * ac.y());
+    double gamma = (ap.y() - betta * ab.y()) / ac.y();
+    double alpha = 1.0 - betta - gamma;
+
+    if (swapped) {
+        std::swap(betta, gamma);
+    }
+
+    return Vec3D{alpha, betta, gamma};
+}
+
+// Homogeneous texture coordinates of the vertex: (u/w, v/w, 1/w)
+inline Vec3D homogeneousUV(const ProjectedVertex& vertex) {
+    return Vec3D(vertex.u, vertex.v, vertex.invW);
+}
+
+// Triangles which do not come from the camera (GUI) have no world space data: only the screen space is needed
+ProjectedTriangle screenTriangle(const Triangle& triangle) {
+    ProjectedTriangle projected;
+    for (int i = 0; i < 3; i++) {
+        const auto& tc = triangle.textureCoordinates()[i];
+        projected.vertices[i].x = static_cast<float>(triangle[i].x());
+        projected.vertices[i].y = static_cast<float>(triangle[i].y());
+        projected.vertices[i].z = triangle[i].z();
+        projected.vertices[i].u = static_cast<float>(tc.x());
+        projected.vertices[i].v = static_cast<float>(tc.y());
+        projected.vertices[i].invW = static_cast<float>(tc.z());
+    }
+    return projected;
+}
+
+/*
+ * Pixels of the bounding box of the triangle clamped to the area (see Screen::rasterArea()).
+ * The vertices can be far outside of it (Camera clips by the side planes only beyond the guard band).
+ * Returns false when there are no pixels.
+ */
+inline bool screenBounds(const ProjectedTriangle& triangle, const ScreenRect& area,
+                         uint16_t& x_min, uint16_t& y_min, uint16_t& x_max, uint16_t& y_max) {
+    double left = std::max<double>(std::ceil(std::min({triangle[0].x, triangle[1].x, triangle[2].x})), area.x0);
+    double top = std::max<double>(std::ceil(std::min({triangle[0].y, triangle[1].y, triangle[2].y})), area.y0);
+    double right = std::min<double>(std::floor(std::max({triangle[0].x, triangle[1].x, triangle[2].x})), area.x1);
+    double bottom = std::min<double>(std::floor(std::max({triangle[0].y, triangle[1].y, triangle[2].y})), area.y1);
+    if (left > right || top > bottom) {
+        return false;
+    }
+    x_min = static_cast<uint16_t>(left);
+    y_min = static_cast<uint16_t>(top);
+    x_max = static_cast<uint16_t>(right);
+    y_max = static_cast<uint16_t>(bottom);
+    return true;
+}
+
 inline bool isInsideTriangleAbg(const Vec3D& abg, double eps = 0) {
     return abg.x() >= -eps && abg.y() >= -eps && abg.z() >= -eps;
 }
@@ -350,302 +661,520 @@ bool lineLimits(const Vec3D& abg, const Vec3D& abg_dx, uint16_t x_min, uint16_t
     return true;
 }
 
-inline double areaDuDv(const Vec3D& uv_hom,
-                       const Vec2D& uv_dehom,
-                       const Vec3D& uv_hom_dx,
-                       const Vec3D& uv_hom_dy,
-                       double x, double y,
-                       double x_min, double y_min,
-                       uint16_t imageWidth, uint16_t imageHeight) {
-    // Derivative in X
-    Vec3D uv_hom_xp = uv_hom + uv_hom_dx;
-    Vec2D uv_dehom_xp = Vec2D(uv_hom_xp.x() / uv_hom_xp.z(), uv_hom_xp.y() / uv_hom_xp.z()) - uv_dehom;
-
-    // Derivative in Y
-    Vec3D uv_hom_yp = uv_hom + uv_hom_dy;
-    Vec2D uv_dehom_yp = Vec2D(uv_hom_yp.x() / uv_hom_yp.z(), uv_hom_yp.y() / uv_hom_yp.z()) - uv_dehom;
-
-    // Derivative in XY combined [Jacobian]
-    Vec2D du(imageWidth * uv_dehom_xp.x(), imageWidth * uv_dehom_yp.x());
-    Vec2D dv(imageHeight * uv_dehom_xp.y(), imageHeight * uv_dehom_yp.y());
-
-    return du.abs() + dv.abs();
-}
-
-struct Vec3DUint {
-    uint r = 0;
-    uint g = 0;
-    uint b = 0;
-
-    inline Vec3DUint& operator+=(const Vec3DUint& other) {
-        r += other.r;
-        g += other.g;
-        b += other.b;
-        return *this;
-    };
-
-    [[nodiscard]] inline Vec3DUint operator+(const Vec3DUint& other) const {
-        Vec3DUint res = *this;
-        res += other;
-        return res;
+// Level of detail of the lighting (see LightSource::illuminate()): 0 near the camera, 1 beyond the far distance
+double lightingSimplification(double distance, double nearDistance, double farDistance) {
+    if (distance > farDistance) {
+        return 1.0;
+    }
+    if (distance > nearDistance) {
+        return (distance - nearDistance)/(farDistance - nearDistance);
     }
+    return 0.0;
+}
 
-    [[nodiscard]] inline Vec3DUint operator*(double number) const {
-        return {static_cast<uint>(r*number),
-                static_cast<uint>(g*number),
-                static_cast<uint>(b*number)};
+// It works both with the lights of the object and the lights of the cluster
+template<typename Lights>
+inline void illuminateBatch(const Lights& lights, LightingBatch& batch) {
+    for (const auto& light: lights) {
+        light->illuminate(batch);
     }
-};
+}
 
+// Light is in 0..255 scale: r, g, b are x, y, z
+inline Color litColor(const Color& color, const Vec3DFloat& l) {
+    return Color(std::clamp<int>(color.r()*l.x()/255, 0, 255),
+                 std::clamp<int>(color.g()*l.y()/255, 0, 255),
+                 std::clamp<int>(color.b()*l.z()/255, 0, 255), color.a());
+}
 
-std::tuple<Vec3DUint, Vec3DUint, Vec3DUint> computeLightingForThreePoints(const Triangle &Mtriangle,
-                                                    const std::vector<std::shared_ptr<LightSource>>& lights, const Vec3D& cameraPos,
-                                                    double nearDistance, double farDistance) {
-    Vec3DUint l1, l2, l3;
+// Barycentric coordinates on the screen to the ones in the world space (z_hom is 1/w interpolated on the screen)
+inline Vec3D dehomogenizedAbg(const Vec3D tc[3], const Vec3D& abg, double z_hom) {
+    return Vec3D(abg.x() * tc[0].z() / z_hom, abg.y() * tc[1].z() / z_hom, abg.z() * tc[2].z() / z_hom);
+}
 
-    Vec3D fromTriToCamera = cameraPos - Vec3D(Mtriangle[0]);
-    double distance = fromTriToCamera.abs();
+inline Vec3D worldPosition(const ProjectedTriangle& triangle, const Vec3D& dehom_abg) {
+    return triangle[0].worldPosition() * dehom_abg.x() +
+           triangle[1].worldPosition() * dehom_abg.y() +
+           triangle[2].worldPosition() * dehom_abg.z();
+}
 
-    double simplCoef = 0.0;
-    if(distance > farDistance) {
-        simplCoef = 1.0;
-    } else if (distance > nearDistance && distance <= farDistance) {
-        simplCoef = (distance-nearDistance)/(farDistance - nearDistance);
+bool Screen::needsVertexLighting(const Material *material) const {
+    if (!_enableLighting || _enableTrueLighting) {
+        return false;
     }
+    // Textured materials are lit only with illum 1 (see drawLitTriangle())
+    return !material || !material->texture() || !_enableTexturing || material->illum() == 1;
+}
 
-    for (const auto& lightSource: lights) {
-        auto light = std::dynamic_pointer_cast<LightSource>(lightSource);
-
-        auto c1 = light->illuminate(Mtriangle.norm(), Vec3D(Mtriangle[0]), simplCoef);
-        auto c2 = light->illuminate(Mtriangle.norm(), Vec3D(Mtriangle[1]), simplCoef);
-        auto c3 = light->illuminate(Mtriangle.norm(), Vec3D(Mtriangle[2]), simplCoef);
+void Screen::addVertexLighting(const ProjectedTriangle &triangle, const Vec3D &cameraPosition) {
+    double distance = (cameraPosition - triangle[0].worldPosition()).abs();
+    double simplCoef = lightingSimplification(distance, _lightingLODNearDistance, _lightingLODFarDistance);
 
-        l1 += {c1.r(), c1.g(), c1.b()};
-        l2 += {c2.r(), c2.g(), c2.b()};
-        l3 += {c3.r(), c3.g(), c3.b()};
+    Vec3D normal = triangle.worldNormal();
+    for (int i = 0; i < 3; i++) {
+        _lightingBatch.add(triangle[i].worldPosition(), normal, simplCoef);
     }
-
-    return {l1, l2, l3};
 }
 
+Screen::VertexLights Screen::lightVertices(const ProjectedTriangle &triangle,
+                                           const std::vector<std::shared_ptr<LightSource>> &lights,
+                                           const Vec3D &cameraPosition) {
+    _lightingBatch.clear();
+    addVertexLighting(triangle, cameraPosition);
+    illuminateBatch(lights, _lightingBatch);
+    if (_stats) {
+        _stats->lightsEvaluated += 3*lights.size();
+    }
+    return vertexLights(0);
+}
 
-void Screen::drawTriangleWithLighting(const Triangle &projectedTriangle, const Triangle &Mtriangle,
-                                      const std::vector<std::shared_ptr<LightSource>>& lights,
-                                      const Vec3D& cameraPosition, Material* material) {
+Screen::VertexLights Screen::vertexLights(size_t first) const {
+    const auto& batch = _lightingBatch;
+    return {Vec3DFloat(batch.r[first], batch.g[first], batch.b[first]),
+            Vec3DFloat(batch.r[first + 1], batch.g[first + 1], batch.b[first + 1]),
+            Vec3DFloat(batch.r[first + 2], batch.g[first + 2], batch.b[first + 2])};
+}
 
-    if(!_enableLighting) {
-        drawTriangle(projectedTriangle, material);
-        return;
-    }
+uint64_t Screen::illuminatePixels(const std::vector<std::shared_ptr<LightSource>> &lights, const Vec3D &normal) {
+    _pixelLights.resize(_litPixels.size());
+    uint64_t lightsEvaluated = 0;
+
+    for (size_t from = 0; from < _litPixels.size();) {
+        size_t to = _litPixels.size();
+        std::span<const LightSource* const> clusterLights;
+        if (_lightGrid) {
+            // Clusters are TILE_SIZE pixels wide, so most of the span goes in a few runs
+            const auto& first = _litPixels[from];
+            clusterLights = _lightGrid->lights(first.x, first.y, first.depth);
+            for (to = from + 1; to < _litPixels.size(); to++) {
+                const auto& pixel = _litPixels[to];
+                auto pixelLights = _lightGrid->lights(pixel.x, pixel.y, pixel.depth);
+                if (pixelLights.data() != clusterLights.data() || pixelLights.size() != clusterLights.size()) {
+                    break;
+                }
+            }
+        }
 
-    if (!material || !material->texture() || !_enableTexturing) {
-        Color color;
-        if (material == nullptr) {
-            color = Color::RED;
+        _pixelLightingBatch.clear();
+        for (size_t i = from; i < to; i++) {
+            _pixelLightingBatch.add(_litPixels[i].position, normal, 0);
+        }
+        if (_lightGrid) {
+            illuminateBatch(clusterLights, _pixelLightingBatch);
+            lightsEvaluated += (to - from) * clusterLights.size();
         } else {
-            color = material->ambient();
-            color[3] *= material->d();
+            illuminateBatch(lights, _pixelLightingBatch);
+            lightsEvaluated += (to - from) * lights.size();
         }
-        drawTriangleWithLighting(projectedTriangle, Mtriangle, lights, cameraPosition, color);
-        return;
-    }
 
-    if(material->illum() != 1) {
-        drawTriangle(projectedTriangle, material);
-        return;
+        for (size_t i = from; i < to; i++) {
+            const auto& batch = _pixelLightingBatch;
+            _pixelLights[i] = Vec3DFloat(batch.r[i - from], batch.g[i - from], batch.b[i - from]);
+        }
+        from = to;
     }
 
-    // Filling inside
-    auto x_min = std::clamp<uint16_t>(std::ceil(std::min({projectedTriangle[0].x(), projectedTriangle[1].x(), projectedTriangle[2].x()})), 0, _width - 1);
-    auto y_min = std::clamp<uint16_t>(std::ceil(std::min({projectedTriangle[0].y(), projectedTriangle[1].y(), projectedTriangle[2].y()})), 0, _height - 1);
-    auto x_max = std::clamp<uint16_t>(std::floor(std::max({projectedTriangle[0].x(), projectedTriangle[1].x(), projectedTriangle[2].x()})), 0, _width - 1);
-    auto y_max = std::clamp<uint16_t>(std::floor(std::max({projectedTriangle[0].y(), projectedTriangle[1].y(), projectedTriangle[2].y()})), 0, _height - 1);
+    return lightsEvaluated;
+}
 
-    if (x_min > x_max || y_min > y_max) return;
+template<typename PixelShader>
+void Screen::drawTexturedTriangle(const ProjectedTriangle &triangle, const Texture &texture, double d, PixelShader &&shader) {
+    drawTexturedTriangle(triangle, texture, d, [](uint16_t, uint16_t, const Vec3D&, uint8_t) {}, shader);
+}
+
+template<typename QuadShader, typename PixelShader>
+void Screen::drawTexturedTriangle(const ProjectedTriangle &triangle, const Texture &texture, double d,
+                                  QuadShader &&quadShader, PixelShader &&shader) {
+    // Texels are opaque unless the texture has transparent pixels or the material is transparent
+    BlendMode blend = blendMode(texture.isTransparent() || d < 1.0);
+    dispatchFlags([&]<bool DepthTest, BlendMode Blend, bool Borders, bool Mipmapping>() {
+        rasterizeTexturedTriangle<DepthTest, Blend, Borders, Mipmapping>(triangle, texture, d, quadShader, shader);
+    }, _depthTest, blend, _enableTriangleBorders, _enableMipmapping);
+}
+
+template<bool DepthTest, BlendMode Blend, bool Borders, bool Mipmapping, typename QuadShader, typename PixelShader>
+void Screen::rasterizeTexturedTriangle(const ProjectedTriangle &triangle, const Texture &texture, double d,
+                                       QuadShader &quadShader, PixelShader &shader) {
+    // Filling inside
+    uint16_t x_min, y_min, x_max, y_max;
+    if (!screenBounds(triangle, rasterArea(), x_min, y_min, x_max, y_max)) return;
+    ScreenRect clip = ScreenRect{x_min, y_min, x_max, y_max}.intersected(_scissor);
+    if (clip.empty()) return;
 
-    auto& tc = projectedTriangle.textureCoordinates();
-    auto texture = material->texture();
-    Color color = material->ambient();
+    const Vec3D tc[3] = {homogeneousUV(triangle[0]), homogeneousUV(triangle[1]), homogeneousUV(triangle[2])};
+    uint32_t tested = 0;
+    uint32_t written = 0;
+    std::array<uint32_t, RenderStats::MIP_LEVELS> mipSamples{};
 
-    auto abg_origin = projectedTriangle.abgBarycCoord(Vec2D(x_min, y_min));
+    auto abg_origin = abgBarycCoord(triangle, Vec2D(x_min, y_min));
     /*
      * Here we calculate the change of abg coordinates when we
      * 1) add one pixel in X: abg_dx = abg(triangle[0] + dx) - abg(triangle[0]) = abg(triangle[0] + dx) - {1, 0, 0}
      * 2) add one pixel in Y: abg_dy = abg(triangle[0] + dy) - abg(triangle[0]) = abg(triangle[0] + dy) - {1, 0, 0}
      */
-    auto abg_dx = projectedTriangle.abgBarycCoord(Vec2D(projectedTriangle[0]) + Vec2D(1, 0)) - Vec3D(1, 0, 0);
-    auto abg_dy = projectedTriangle.abgBarycCoord(Vec2D(projectedTriangle[0]) + Vec2D(0, 1)) - Vec3D(1, 0, 0);
+    auto abg_dx = abgBarycCoord(triangle, Vec2D(triangle[0].x + 1, triangle[0].y)) - Vec3D(1, 0, 0);
+    auto abg_dy = abgBarycCoord(triangle, Vec2D(triangle[0].x, triangle[0].y + 1)) - Vec3D(1, 0, 0);
 
+    /*
+     * Homogeneous UV coordinates: the third component is 1/w interpolated linearly over the screen,
+     * so it is the same as z_hom we use for de-homogenization.
+     */
     Vec3D uv_hom_origin, uv_hom_dx, uv_hom_dy;
 
     uv_hom_origin = tc[0] + (tc[1] - tc[0]) * abg_origin.y() + (tc[2] - tc[0]) * abg_origin.z();
     uv_hom_dx = (tc[1] - tc[0]) * abg_dx.y() + (tc[2] - tc[0]) * abg_dx.z();
     uv_hom_dy = (tc[1] - tc[0]) * abg_dy.y() + (tc[2] - tc[0]) * abg_dy.z();
 
-    // Let us try to do lighting not for every pixel, but for the triangle.
-    auto [l1, l2, l3] = computeLightingForThreePoints(Mtriangle, lights, cameraPosition,
-                                                      _lightingLODNearDistance, _lightingLODFarDistance);
-
-    for (uint16_t y = y_min; y <= y_max; y++) {
-        uint16_t x_cur_min, x_cur_max;
-        if (!lineLimits(abg_origin + abg_dy*(y - y_min), abg_dx, x_min, x_max, x_cur_min, x_cur_max)) continue;
-
-        Vec3D abg = abg_origin + abg_dy*(y - y_min) + abg_dx*(x_cur_min - x_min);
-        Vec3D uv_hom = uv_hom_origin + uv_hom_dy*(y-y_min) + uv_hom_dx*(x_cur_min - x_min);
-
-        // Instead of exact area we compute average for each horizontal line:
-        Vec3D uv_hom_x_avr = uv_hom_origin + uv_hom_dy*(y-y_min) + uv_hom_dx*((x_cur_min+x_cur_max)/2 - x_min);
-        Vec2D uv_dehom_x_avr(uv_hom_x_avr.x() / uv_hom_x_avr.z(), uv_hom_x_avr.y() / uv_hom_x_avr.z());
-
-        double area = 0;
-        if(_enableMipmapping) {
-            area = areaDuDv(uv_hom_x_avr,
-                            uv_dehom_x_avr, uv_hom_dx, uv_hom_dy,
-                            (x_min+x_max)/2, y, x_min, y_min,
-                            texture->width(), texture->height());
+    // Offsets of the pixels of a 2x2 quad from its first pixel
+    Vec3D triangle_z(triangle[0].z, triangle[1].z, triangle[2].z);
+    const Vec3D abg_offset[4] = {Vec3D(0), abg_dx, abg_dy, abg_dx + abg_dy};
+    const Vec3D uv_hom_offset[4] = {Vec3D(0), uv_hom_dx, uv_hom_dy, uv_hom_dx + uv_hom_dy};
+    const double z_offset[4] = {0, triangle_z.dot(abg_dx), triangle_z.dot(abg_dy), triangle_z.dot(abg_dx + abg_dy)};
+
+    Texture::Footprint footprint{&texture.get_level(0)};
+
+    // Quads go from y_min and from the start of the row span regardless of the scissor: mip levels do not depend on it
+    for (uint16_t y = y_min; y <= clip.y1; y += 2) {
+        if (y + 1 < clip.y0) continue;
+        // The row of quads covers lines y and y+1, so we go over the union of their limits
+        uint16_t x0_min, x0_max, x1_min, x1_max;
+        bool line0 = lineLimits(abg_origin + abg_dy*(y - y_min), abg_dx, x_min, x_max, x0_min, x0_max);
+        bool line1 = y + 1 <= y_max && lineLimits(abg_origin + abg_dy*(y + 1 - y_min), abg_dx, x_min, x_max, x1_min, x1_max);
+        if (!line0 && !line1) continue;
+
+        uint16_t x_from = !line1 ? x0_min : (!line0 ? x1_min : std::min(x0_min, x1_min));
+        uint16_t x_to = !line1 ? x0_max : (!line0 ? x1_max : std::max(x0_max, x1_max));
+
+        Vec3D abg_quad = abg_origin + abg_dy*(y - y_min) + abg_dx*(x_from - x_min);
+        Vec3D uv_hom_quad = uv_hom_origin + uv_hom_dy*(y - y_min) + uv_hom_dx*(x_from - x_min);
+        for (; x_from + 1 < clip.x0 && x_from <= x_to; x_from += 2) {
+            abg_quad += abg_dx*2;
+            uv_hom_quad += uv_hom_dx*2;
         }
-        const Image& sample = texture->get_sample(area);
-
-        for (uint16_t x = x_cur_min; x <= x_cur_max; x++) {
-            double non_linear_z_hom = projectedTriangle[0].z() * abg.x() + projectedTriangle[1].z() * abg.y() + projectedTriangle[2].z() * abg.z();
-            double z_hom = tc[0].z()*abg.x() + tc[1].z()*abg.y() + tc[2].z()*abg.z();
+        x_to = std::min<int>(x_to, clip.x1);
+
+        for (uint16_t x = x_from; x <= x_to; x += 2) {
+            // First we find which pixels of the quad are visible: most of the quads are hidden by closer triangles
+            double z_quad = triangle_z.dot(abg_quad);
+            uint8_t visible = 0;
+            for (int i = 0; i < 4; i++) {
+                uint16_t px = x + (i & 1);
+                uint16_t py = y + (i >> 1);
+                if (px >= clip.x0 && px <= clip.x1 && py >= clip.y0 && py <= clip.y1 &&
+                    isInsideTriangleAbg(abg_quad + abg_offset[i], Consts::EPS)) {
+                    tested++;
+                    if (testDepth<DepthTest>(px, py, z_quad + z_offset[i])) {
+                        visible |= 1 << i;
+                    }
+                }
+            }
 
-            if(checkPixelDepth(x, y, non_linear_z_hom) && isInsideTriangleAbg(abg, Consts::EPS)) {
-                // de-homogenize UV coordinates
-                Vec2D uv_dehom(uv_hom.x() / z_hom, uv_hom.y() / z_hom);
+            if (Mipmapping && visible && uv_hom_quad.z() > Consts::EPS) {
                 /*
-                 * We can calculate the area of Du*Dv for each pixel, but it is computationally inefficient.
-                 * Instead, we use averaged area for the horizontal line (calculation is above).
-                */
-                //double area = areaDuDv(uv_hom, uv_dehom, uv_hom_dx, uv_hom_dy, x, y, x_min, y_min, texture->width(), texture->height());
-                //color = texture->get_pixel_from_UV(uv_dehom, area);
-                color = sample.get_pixel_from_UV(uv_dehom);
-                color[3] *= material->d();
-
+                 * Derivatives of the de-homogenized UV in the first pixel of the quad (quotient rule).
+                 * Pixels outside the triangle still define the derivatives, the same as GPUs do with 'helper' pixels.
+                 */
+                double inv_z = 1.0 / uv_hom_quad.z();
+                Vec2D uv(uv_hom_quad.x() * inv_z, uv_hom_quad.y() * inv_z);
+                Vec2D duvdx = (Vec2D(uv_hom_dx.x(), uv_hom_dx.y()) - uv * uv_hom_dx.z()) * inv_z;
+                Vec2D duvdy = (Vec2D(uv_hom_dy.x(), uv_hom_dy.y()) - uv * uv_hom_dy.z()) * inv_z;
+                footprint = texture.footprint(duvdx, duvdy, _maxAnisotropy);
+            }
+            if (visible) {
+                quadShader(x, y, abg_quad, visible);
+            }
 
-                // Exact calculation of light (non linear and computationally expensive)
-                // Here we do homogination and de-homogination part to do the same as we did for textures
-                Vec3D dehom_abg(abg.x() * tc[0].z() / z_hom, abg.y() * tc[1].z() / z_hom, abg.z() * tc[2].z() / z_hom);
+            for (int i = 0; visible && i < 4; i++) {
+                if (!(visible & (1 << i))) continue;
 
-                Vec3DUint l;
-                if(!_enableTrueLighting) {
-                    // Linearization of light:
-                    l = l1*dehom_abg.x() + l2*dehom_abg.y() + l3*dehom_abg.z();
+                uint16_t px = x + (i & 1);
+                uint16_t py = y + (i >> 1);
 
-                    // Constant for the whole triangle
-                    //Vec3DUint l = l1;
+                Vec3D abg = abg_quad + abg_offset[i];
+                double non_linear_z_hom = z_quad + z_offset[i];
 
-                } else {
-                    auto dehomPixelPosition = Vec4D(
-                            Mtriangle[0] * dehom_abg.x() +
-                            Mtriangle[1] * dehom_abg.y() +
-                            Mtriangle[2] * dehom_abg.z());
-                    for (const auto &lightSource: lights) {
-                        auto light = std::dynamic_pointer_cast<LightSource>(lightSource);
-                        auto cl = light->illuminate(Mtriangle.norm(), Vec3D(dehomPixelPosition), 0);
-                        l += {cl.r(), cl.g(), cl.b()};
-                    }
-                }
+                // de-homogenize UV coordinates
+                Vec3D uv_hom = uv_hom_quad + uv_hom_offset[i];
+                Vec2D uv_dehom(uv_hom.x() / uv_hom.z(), uv_hom.y() / uv_hom.z());
 
-                Color resColor(std::clamp<int>(color.r()*l.r/255, 0, 255),
-                               std::clamp<int>(color.g()*l.g/255, 0, 255),
-                               std::clamp<int>(color.b()*l.b/255, 0, 255), color.a());
+                Color color = texture.get_pixel_from_UV(uv_dehom, footprint);
+                color[3] *= d;
+                written++;
+                mipSamples[std::min<size_t>(footprint.mip, RenderStats::MIP_LEVELS - 1)] += footprint.samples;
 
-                if(!_enableTriangleBorders || isInsideTriangleAbg(abg, -Consts::ABG_TRIANGLE_BORDER_WIDTH)) {
-                    drawPixelUnsafe(x, y, non_linear_z_hom, resColor);
+                if(!Borders || isInsideTriangleAbg(abg, -Consts::ABG_TRIANGLE_BORDER_WIDTH)) {
+                    writePixel<Blend>(px, py, non_linear_z_hom, shader(px, py, abg, uv_hom.z(), color));
                 } else {
                     // Drawing edge
-                    drawPixelUnsafe(x, y, non_linear_z_hom, Color::BLACK);
+                    writePixel<Blend>(px, py, non_linear_z_hom, Color::BLACK);
                 }
             }
-            abg += abg_dx;
-            uv_hom += uv_hom_dx;
+
+            abg_quad += abg_dx*2;
+            uv_hom_quad += uv_hom_dx*2;
+        }
+    }
+
+    PROFILE_COUNT("pixels shaded", written);
+    if (_stats) {
+        _stats->pixelsTested += tested;
+        _stats->pixelsWritten += written;
+        for (size_t i = 0; i < RenderStats::MIP_LEVELS; i++) {
+            _stats->textureSamples[i] += mipSamples[i];
         }
     }
 }
 
-void Screen::drawTriangleWithLighting(const Triangle &projectedTriangle, const Triangle &Mtriangle,
+void Screen::drawTriangleWithLighting(const ProjectedTriangle &triangle,
+                                      const std::vector<std::shared_ptr<LightSource>>& lights,
+                                      const Vec3D& cameraPosition, Material* material) {
+    VertexLights light{};
+    if (needsVertexLighting(material)) {
+        light = lightVertices(triangle, lights, cameraPosition);
+    }
+    drawLitTriangle(triangle, lights, light, material);
+}
+
+void Screen::drawTriangleWithLighting(const ProjectedTriangle &triangle,
                                       const std::vector<std::shared_ptr<LightSource>> &lights,
                                       const Vec3D& cameraPosition, const Color &color) {
+    VertexLights light{};
+    if (needsVertexLighting(nullptr)) {
+        light = lightVertices(triangle, lights, cameraPosition);
+    }
+    drawLitTriangle(triangle, lights, light, color);
+}
+
+void Screen::drawTrianglesWithLighting(const DrawList &triangles,
+                                       const std::vector<std::vector<std::shared_ptr<LightSource>>> &lights,
+                                       const std::vector<Material*> &materials, const Vec3D &cameraPosition) {
+    for (size_t from = 0; from < triangles.size();) {
+        // A run of triangles with the same lights (usually of one mesh): one virtual call per light for all of them
+        uint32_t lightList = triangles[from].lights;
+        size_t to = from + 1;
+        while (to < triangles.size() && to - from < LIGHTING_RUN_TRIANGLES && triangles[to].lights == lightList) {
+            to++;
+        }
+
+        _lightingBatch.clear();
+        for (size_t i = from; i < to; i++) {
+            if (needsVertexLighting(materials[triangles[i].material])) {
+                addVertexLighting(triangles[i], cameraPosition);
+            }
+        }
+        if (_lightingBatch.size() > 0) {
+            illuminateBatch(lights[lightList], _lightingBatch);
+            if (_stats) {
+                _stats->lightsEvaluated += _lightingBatch.size()*lights[lightList].size();
+            }
+        }
+
+        size_t vertex = 0;
+        for (size_t i = from; i < to; i++) {
+            Material* material = materials[triangles[i].material];
+            VertexLights light{};
+            if (needsVertexLighting(material)) {
+                light = vertexLights(vertex);
+                vertex += 3;
+            }
+            drawLitTriangle(triangles[i], lights[lightList], light, material);
+        }
+        from = to;
+    }
+}
+
+void Screen::drawLitTriangle(const ProjectedTriangle &triangle,
+                             const std::vector<std::shared_ptr<LightSource>>& lights,
+                             const VertexLights& vertexLights, Material* material) {
 
     if(!_enableLighting) {
-        drawTriangle(projectedTriangle, color);
+        drawTriangle(triangle, material);
         return;
     }
 
-    // Filling inside
-    auto x_min = std::clamp<uint16_t>(std::ceil(std::min({projectedTriangle[0].x(), projectedTriangle[1].x(), projectedTriangle[2].x()})), 0, _width - 1);
-    auto y_min = std::clamp<uint16_t>(std::ceil(std::min({projectedTriangle[0].y(), projectedTriangle[1].y(), projectedTriangle[2].y()})), 0, _height - 1);
-    auto x_max = std::clamp<uint16_t>(std::floor(std::max({projectedTriangle[0].x(), projectedTriangle[1].x(), projectedTriangle[2].x()})), 0, _width - 1);
-    auto y_max = std::clamp<uint16_t>(std::floor(std::max({projectedTriangle[0].y(), projectedTriangle[1].y(), projectedTriangle[2].y()})), 0, _height - 1);
+    if (!material || !material->texture() || !_enableTexturing) {
+        Color color;
+        if (material == nullptr) {
+            color = Color::RED;
+        } else {
+            color = material->ambient();
+            color[3] *= material->d();
+        }
+        drawLitTriangle(triangle, lights, vertexLights, color);
+        return;
+    }
+
+    if(material->illum() != 1) {
+        drawTriangle(triangle, material);
+        return;
+    }
+
+    const Vec3D tc[3] = {homogeneousUV(triangle[0]), homogeneousUV(triangle[1]), homogeneousUV(triangle[2])};
+    const auto& [l1, l2, l3] = vertexLights;
+    uint64_t lightsEvaluated = 0;
+
+    dispatchFlags([&]<bool TrueLighting>() {
+        if constexpr (!TrueLighting) {
+            drawTexturedTriangle(triangle, *material->texture(), material->d(),
+                                 [&](uint16_t, uint16_t, const Vec3D& abg, double z_hom, const Color& color) {
+                // Linearization of light: here we do homogination and de-homogination part to do the same as we did for textures
+                Vec3D dehom_abg = dehomogenizedAbg(tc, abg, z_hom);
+                return litColor(color, l1*dehom_abg.x() + l2*dehom_abg.y() + l3*dehom_abg.z());
+            });
+        } else {
+            // Exact calculation of light (non linear and computationally expensive): the visible pixels of a quad are lit at once
+            Vec3D normal = triangle.worldNormal();
+            auto abg_dx = abgBarycCoord(triangle, Vec2D(triangle[0].x + 1, triangle[0].y)) - Vec3D(1, 0, 0);
+            auto abg_dy = abgBarycCoord(triangle, Vec2D(triangle[0].x, triangle[0].y + 1)) - Vec3D(1, 0, 0);
+            const Vec3D abg_offset[4] = {Vec3D(0), abg_dx, abg_dy, abg_dx + abg_dy};
+
+            uint16_t quad_x = 0, quad_y = 0;
+            std::array<uint8_t, 4> quadPixel{}; // index in _pixelLights of the pixel i of the quad
+            drawTexturedTriangle(triangle, *material->texture(), material->d(),
+                                 [&](uint16_t x, uint16_t y, const Vec3D& abg_quad, uint8_t visible) {
+                quad_x = x;
+                quad_y = y;
+                _litPixels.clear();
+                for (int i = 0; i < 4; i++) {
+                    if (!(visible & (1 << i))) continue;
+
+                    Vec3D abg = abg_quad + abg_offset[i];
+                    double z_hom = tc[0].z()*abg.x() + tc[1].z()*abg.y() + tc[2].z()*abg.z();
+                    quadPixel[i] = static_cast<uint8_t>(_litPixels.size());
+                    _litPixels.push_back({static_cast<uint16_t>(x + (i & 1)), static_cast<uint16_t>(y + (i >> 1)), 0,
+                                          1.0 / z_hom, abg, worldPosition(triangle, dehomogenizedAbg(tc, abg, z_hom))});
+                }
+                lightsEvaluated += illuminatePixels(lights, normal);
+            }, [&](uint16_t x, uint16_t y, const Vec3D&, double, const Color& color) {
+                return litColor(color, _pixelLights[quadPixel[(x - quad_x) + 2*(y - quad_y)]]);
+            });
+        }
+    }, _enableTrueLighting);
+
+    if (_stats) {
+        _stats->lightsEvaluated += lightsEvaluated;
+    }
+}
+
+void Screen::drawLitTriangle(const ProjectedTriangle &triangle,
+                             const std::vector<std::shared_ptr<LightSource>> &lights,
+                             const VertexLights& vertexLights, const Color &color) {
+
+    if(!_enableLighting) {
+        drawTriangle(triangle, color);
+        return;
+    }
 
-    if (x_min > x_max || y_min > y_max) return;
+    dispatchFlags([&]<bool DepthTest, BlendMode Blend, bool Borders, bool TrueLighting>() {
+        rasterizeLitTriangle<DepthTest, Blend, Borders, TrueLighting>(triangle, lights, vertexLights, color);
+    }, _depthTest, blendMode(color.a() != 255), _enableTriangleBorders, _enableTrueLighting);
+}
 
-    auto& tc = projectedTriangle.textureCoordinates();
+template<bool DepthTest, BlendMode Blend, bool Borders, bool TrueLighting>
+void Screen::rasterizeLitTriangle(const ProjectedTriangle &triangle,
+                                  const std::vector<std::shared_ptr<LightSource>> &lights,
+                                  const VertexLights& vertexLights, const Color &color) {
+    // Filling inside
+    uint16_t x_min, y_min, x_max, y_max;
+    if (!screenBounds(triangle, rasterArea(), x_min, y_min, x_max, y_max)) return;
+    ScreenRect clip = ScreenRect{x_min, y_min, x_max, y_max}.intersected(_scissor);
+    if (clip.empty()) return;
 
-    auto abg_origin = projectedTriangle.abgBarycCoord(Vec2D(x_min, y_min));
+    const Vec3D tc[3] = {homogeneousUV(triangle[0]), homogeneousUV(triangle[1]), homogeneousUV(triangle[2])};
+    uint32_t tested = 0;
+    uint32_t written = 0;
+
+    auto abg_origin = abgBarycCoord(triangle, Vec2D(x_min, y_min));
     /*
      * Here we calculate the change of abg coordinates when we
      * 1) add one pixel in X: abg_dx = abg(triangle[0] + dx) - abg(triangle[0]) = abg(triangle[0] + dx) - {1, 0, 0}
      * 2) add one pixel in Y: abg_dy = abg(triangle[0] + dy) - abg(triangle[0]) = abg(triangle[0] + dy) - {1, 0, 0}
      */
-    auto abg_dx = projectedTriangle.abgBarycCoord(Vec2D(projectedTriangle[0]) + Vec2D(1, 0)) - Vec3D(1, 0, 0);
-    auto abg_dy = projectedTriangle.abgBarycCoord(Vec2D(projectedTriangle[0]) + Vec2D(0, 1)) - Vec3D(1, 0, 0);
+    auto abg_dx = abgBarycCoord(triangle, Vec2D(triangle[0].x + 1, triangle[0].y)) - Vec3D(1, 0, 0);
+    auto abg_dy = abgBarycCoord(triangle, Vec2D(triangle[0].x, triangle[0].y + 1)) - Vec3D(1, 0, 0);
+
+    Vec3D normal = triangle.worldNormal();
+    const auto& [l1, l2, l3] = vertexLights;
+    uint64_t lightsEvaluated = 0;
 
-    auto [l1, l2, l3] = computeLightingForThreePoints(Mtriangle, lights, cameraPosition,
-                                                      _lightingLODNearDistance, _lightingLODFarDistance);
+    auto shade = [&](uint16_t x, uint16_t y, double non_linear_z_hom, const Vec3D& abg, const Vec3DFloat& l) {
+        if(!Borders || isInsideTriangleAbg(abg, -Consts::ABG_TRIANGLE_BORDER_WIDTH)) {
+            writePixel<Blend>(x, y, non_linear_z_hom, litColor(color, l));
+        } else {
+            // Drawing edge
+            writePixel<Blend>(x, y, non_linear_z_hom, Color::BLACK);
+        }
+    };
 
-    for (uint16_t y = y_min; y <= y_max; y++) {
+    for (uint16_t y = clip.y0; y <= clip.y1; y++) {
         uint16_t x_cur_min, x_cur_max;
         if (!lineLimits(abg_origin + abg_dy*(y - y_min), abg_dx, x_min, x_max, x_cur_min, x_cur_max)) continue;
 
         Vec3D abg = abg_origin + abg_dy*(y - y_min) + abg_dx*(x_cur_min - x_min);
 
-        for (int x = x_cur_min; x <= x_cur_max; x++) {
-            double non_linear_z_hom = projectedTriangle[0].z() * abg.x() + projectedTriangle[1].z() * abg.y() + projectedTriangle[2].z() * abg.z();
+        // Pixels to the left of the scissor are stepped over, so abg is the same as without it
+        int x = x_cur_min;
+        for (; x < clip.x0 && x <= x_cur_max; x++) {
+            abg += abg_dx;
+        }
+        if constexpr (TrueLighting) {
+            _litPixels.clear();
+        }
+        for (int x_end = std::min<int>(x_cur_max, clip.x1); x <= x_end; x++) {
+            double non_linear_z_hom = triangle[0].z * abg.x() + triangle[1].z * abg.y() + triangle[2].z * abg.z();
             double z_hom = tc[0].z()*abg.x() + tc[1].z()*abg.y() + tc[2].z()*abg.z();
 
-            if (checkPixelDepth(x, y, non_linear_z_hom) && isInsideTriangleAbg(abg, Consts::EPS)) {
-                Vec3D dehom_abg(abg.x() * tc[0].z() / z_hom, abg.y() * tc[1].z() / z_hom, abg.z() * tc[2].z() / z_hom);
+            bool inside = isInsideTriangleAbg(abg, Consts::EPS);
+            tested += inside;
 
-                Vec3DUint l;
-                if(!_enableTrueLighting) {
-                    // Linearization of light:
-                    l = l1*dehom_abg.x() + l2*dehom_abg.y() + l3*dehom_abg.z();
+            if (inside && testDepth<DepthTest>(x, y, non_linear_z_hom)) {
+                Vec3D dehom_abg = dehomogenizedAbg(tc, abg, z_hom);
 
-                    // Constant for the whole triangle
-                    //Vec3DUint l = l1;
+                written++;
 
+                if constexpr (!TrueLighting) {
+                    // Linearization of light:
+                    shade(x, y, non_linear_z_hom, abg, l1*dehom_abg.x() + l2*dehom_abg.y() + l3*dehom_abg.z());
                 } else {
-                    auto dehomPixelPosition = Vec4D(
-                            Mtriangle[0] * dehom_abg.x() +
-                            Mtriangle[1] * dehom_abg.y() +
-                            Mtriangle[2] * dehom_abg.z());
-                    for (const auto &lightSource: lights) {
-                        auto light = std::dynamic_pointer_cast<LightSource>(lightSource);
-                        auto cl = light->illuminate(Mtriangle.norm(), Vec3D(dehomPixelPosition), 0);
-                        l += {cl.r(), cl.g(), cl.b()};
-                    }
-                }
-
-                Color resColor(std::clamp<int>(color.r()*l.r/255, 0, 255),
-                               std::clamp<int>(color.g()*l.g/255, 0, 255),
-                               std::clamp<int>(color.b()*l.b/255, 0, 255), color.a());
-
-                if(!_enableTriangleBorders || isInsideTriangleAbg(abg, -Consts::ABG_TRIANGLE_BORDER_WIDTH)) {
-                    drawPixelUnsafe(x, y, non_linear_z_hom, resColor);
-                } else {
-                    // Drawing edge
-                    drawPixelUnsafe(x, y, non_linear_z_hom, Color::BLACK);
+                    // Exact lighting goes after the span: the pixels of a triangle do not overlap, so they can wait
+                    _litPixels.push_back({static_cast<uint16_t>(x), y, non_linear_z_hom, 1.0 / z_hom, abg,
+                                          worldPosition(triangle, dehom_abg)});
                 }
             }
 
             abg += abg_dx;
         }
+
+        if constexpr (TrueLighting) {
+            lightsEvaluated += illuminatePixels(lights, normal);
+            for (size_t i = 0; i < _litPixels.size(); i++) {
+                const auto& pixel = _litPixels[i];
+                shade(pixel.x, pixel.y, pixel.z, pixel.abg, _pixelLights[i]);
+            }
+        }
+    }
+
+    PROFILE_COUNT("pixels shaded", written);
+    if (_stats) {
+        _stats->pixelsTested += tested;
+        _stats->pixelsWritten += written;
+        _stats->lightsEvaluated += lightsEvaluated;
     }
 }
 
 void Screen::drawTriangle(const Triangle &triangle, Material *material) {
+    _wholeWindow = true;
+    drawTriangle(screenTriangle(triangle), material);
+    _wholeWindow = false;
+}
+
+void Screen::drawTriangle(const Triangle &triangle, const Color &color) {
+    _wholeWindow = true;
+    drawTriangle(screenTriangle(triangle), color);
+    _wholeWindow = false;
+}
+
+void Screen::drawTriangle(const ProjectedTriangle &triangle, Material *material) {
     if (!material || !material->texture() || !_enableTexturing) {
         Color color;
         if (!material) {
@@ -658,119 +1187,72 @@ void Screen::drawTriangle(const Triangle &triangle, Material *material) {
         return;
     }
 
-    // Filling inside
-    auto x_min = std::clamp<uint16_t>(std::ceil(std::min({ triangle[0].x(), triangle[1].x(), triangle[2].x()})), 0, _width - 1);
-    auto y_min = std::clamp<uint16_t>(std::ceil(std::min({ triangle[0].y(), triangle[1].y(), triangle[2].y()})), 0, _height - 1);
-    auto x_max = std::clamp<uint16_t>(std::floor(std::max({triangle[0].x(), triangle[1].x(), triangle[2].x()})), 0, _width - 1);
-    auto y_max = std::clamp<uint16_t>(std::floor(std::max({triangle[0].y(), triangle[1].y(), triangle[2].y()})), 0, _height - 1);
-
-    if (x_min > x_max || y_min > y_max) return;
-
-    auto& tc = triangle.textureCoordinates();
-    auto texture = material->texture();
-    Color color = material->ambient();
-
-    auto abg_origin = triangle.abgBarycCoord(Vec2D(x_min, y_min));
-    /*
-     * Here we calculate the change of abg coordinates when we
-     * 1) add one pixel in X: abg_dx = abg(triangle[0] + dx) - abg(triangle[0]) = abg(triangle[0] + dx) - {1, 0, 0}
-     * 2) add one pixel in Y: abg_dy = abg(triangle[0] + dy) - abg(triangle[0]) = abg(triangle[0] + dy) - {1, 0, 0}
-     */
-    auto abg_dx = triangle.abgBarycCoord(Vec2D(triangle[0]) + Vec2D(1, 0)) - Vec3D(1, 0, 0);
-    auto abg_dy = triangle.abgBarycCoord(Vec2D(triangle[0]) + Vec2D(0, 1)) - Vec3D(1, 0, 0);
-
-    Vec3D uv_hom_origin, uv_hom_dx, uv_hom_dy;
-
-    uv_hom_origin = tc[0] + (tc[1] - tc[0]) * abg_origin.y() + (tc[2] - tc[0]) * abg_origin.z();
-    uv_hom_dx = (tc[1] - tc[0]) * abg_dx.y() + (tc[2] - tc[0]) * abg_dx.z();
-    uv_hom_dy = (tc[1] - tc[0]) * abg_dy.y() + (tc[2] - tc[0]) * abg_dy.z();
-
-    for (uint16_t y = y_min; y <= y_max; y++) {
-        uint16_t x_cur_min, x_cur_max;
-
-        if (!lineLimits(abg_origin + abg_dy*(y - y_min), abg_dx, x_min, x_max, x_cur_min, x_cur_max)) continue;
-
-        Vec3D abg = abg_origin + abg_dy*(y - y_min) + abg_dx*(x_cur_min - x_min);
-        Vec3D uv_hom = uv_hom_origin + uv_hom_dy*(y-y_min) + uv_hom_dx*(x_cur_min - x_min);
-
-        // Instead of exact area we compute average for each horizontal line:
-        Vec3D uv_hom_x_avr = uv_hom_origin + uv_hom_dy*(y-y_min) + uv_hom_dx*((x_cur_min+x_cur_max)/2 - x_min);
-        Vec2D uv_dehom_x_avr(uv_hom_x_avr.x() / uv_hom_x_avr.z(), uv_hom_x_avr.y() / uv_hom_x_avr.z());
-
-        double area = 0;
-        if(_enableMipmapping) {
-            area = areaDuDv(uv_hom_x_avr, uv_dehom_x_avr, uv_hom_dx, uv_hom_dy, (x_min+x_max)/2, y, x_min, y_min, texture->width(), texture->height());
-        }
-        const Image& sample = texture->get_sample(area);
-
-        for (uint16_t x = x_cur_min; x <= x_cur_max; x++) {
-            double non_linear_z_hom = triangle[0].z() * abg.x() + triangle[1].z() * abg.y() + triangle[2].z() * abg.z();
-            double z_hom = tc[0].z()*abg.x() + tc[1].z()*abg.y() + tc[2].z()*abg.z();
+    drawTexturedTriangle(triangle, *material->texture(), material->d(),
+                         [](uint16_t, uint16_t, const Vec3D&, double, const Color& color) {
+        return color;
+    });
+}
 
-            if(checkPixelDepth(x, y, non_linear_z_hom) && isInsideTriangleAbg(abg, Consts::EPS)) {
-                // de-homogenize UV coordinates
-                Vec2D uv_dehom(uv_hom.x() / z_hom, uv_hom.y() / z_hom);
-                /*
-                 * We can calculate the area of Du*Dv for each pixel, but it is computationally inefficient.
-                 * Instead, we use averaged area for the horizontal line (calculation is above).
-                */
-                //double area = areaDuDv(uv_hom, uv_dehom, uv_hom_dx, uv_hom_dy, x, y, x_min, y_min, texture->width(), texture->height());
-                //color = texture->get_pixel_from_UV(uv_dehom, area);
-                color = sample.get_pixel_from_UV(uv_dehom);
-                color[3] *= material->d();
-
-                if(!_enableTriangleBorders || isInsideTriangleAbg(abg, -Consts::ABG_TRIANGLE_BORDER_WIDTH)) {
-                    drawPixelUnsafe(x, y, non_linear_z_hom, color);
-                } else {
-                    // Drawing edge
-                    drawPixelUnsafe(x, y, non_linear_z_hom, Color::BLACK);
-                }
-            }
-            abg += abg_dx;
-            uv_hom += uv_hom_dx;
-        }
-    }
+void Screen::drawTriangle(const ProjectedTriangle &triangle, const Color &color) {
+    dispatchFlags([&]<bool DepthTest, BlendMode Blend, bool Borders>() {
+        rasterizeTriangle<DepthTest, Blend, Borders>(triangle, color);
+    }, _depthTest, blendMode(color.a() != 255), _enableTriangleBorders);
 }
 
-void Screen::drawTriangle(const Triangle &triangle, const Color &color) {
+template<bool DepthTest, BlendMode Blend, bool Borders>
+void Screen::rasterizeTriangle(const ProjectedTriangle &triangle, const Color &color) {
     // Filling inside
-    auto x_min = std::clamp<uint16_t>(std::ceil(std::min({triangle[0].x(), triangle[1].x(), triangle[2].x()})), 0, _width - 1);
-    auto y_min = std::clamp<uint16_t>(std::ceil(std::min({triangle[0].y(), triangle[1].y(), triangle[2].y()})), 0, _height - 1);
-    auto x_max = std::clamp<uint16_t>(std::floor(std::max({triangle[0].x(), triangle[1].x(), triangle[2].x()})), 0, _width - 1);
-    auto y_max = std::clamp<uint16_t>(std::floor(std::max({triangle[0].y(), triangle[1].y(), triangle[2].y()})), 0, _height - 1);
+    uint16_t x_min, y_min, x_max, y_max;
+    if (!screenBounds(triangle, rasterArea(), x_min, y_min, x_max, y_max)) return;
+    ScreenRect clip = ScreenRect{x_min, y_min, x_max, y_max}.intersected(_scissor);
+    if (clip.empty()) return;
 
-    if (x_min > x_max || y_min > y_max) return;
-
-    auto abg_origin = triangle.abgBarycCoord(Vec2D(x_min, y_min));
+    auto abg_origin = abgBarycCoord(triangle, Vec2D(x_min, y_min));
     /*
      * Here we calculate the change of abg coordinates when we
      * 1) add one pixel in X: abg_dx = abg(triangle[0] + dx) - abg(triangle[0]) = abg(triangle[0] + dx) - {1, 0, 0}
      * 2) add one pixel in Y: abg_dy = abg(triangle[0] + dy) - abg(triangle[0]) = abg(triangle[0] + dy) - {1, 0, 0}
      */
-    auto abg_dx = triangle.abgBarycCoord(Vec2D(triangle[0]) + Vec2D(1, 0)) - Vec3D(1, 0, 0);
-    auto abg_dy = triangle.abgBarycCoord(Vec2D(triangle[0]) + Vec2D(0, 1)) - Vec3D(1, 0, 0);
+    auto abg_dx = abgBarycCoord(triangle, Vec2D(triangle[0].x + 1, triangle[0].y)) - Vec3D(1, 0, 0);
+    auto abg_dy = abgBarycCoord(triangle, Vec2D(triangle[0].x, triangle[0].y + 1)) - Vec3D(1, 0, 0);
 
-    for (uint16_t y = y_min; y <= y_max; y++) {
+    uint32_t tested = 0;
+    uint32_t written = 0;
+    for (uint16_t y = clip.y0; y <= clip.y1; y++) {
         uint16_t x_cur_min, x_cur_max;
         if (!lineLimits(abg_origin + abg_dy*(y - y_min), abg_dx, x_min, x_max, x_cur_min, x_cur_max)) continue;
 
         Vec3D abg = abg_origin + abg_dy*(y - y_min) + abg_dx*(x_cur_min - x_min);
 
-        for (int x = x_cur_min; x <= x_cur_max; x++) {
+        // Pixels to the left of the scissor are stepped over, so abg is the same as without it
+        int x = x_cur_min;
+        for (; x < clip.x0 && x <= x_cur_max; x++) {
+            abg += abg_dx;
+        }
+        for (int x_end = std::min<int>(x_cur_max, clip.x1); x <= x_end; x++) {
             if(isInsideTriangleAbg(abg, Consts::EPS)) {
-                double non_linear_z_hom = triangle[0].z() * abg.x() + triangle[1].z() * abg.y() + triangle[2].z() * abg.z();
-
-                if(!_enableTriangleBorders || isInsideTriangleAbg(abg, -Consts::ABG_TRIANGLE_BORDER_WIDTH)) {
-                    drawPixelUnsafe(x, y, non_linear_z_hom, color);
-                } else {
-                    // Drawing edge
-                    drawPixelUnsafe(x, y, non_linear_z_hom, Color::BLACK);
+                double non_linear_z_hom = triangle[0].z * abg.x() + triangle[1].z * abg.y() + triangle[2].z * abg.z();
+                tested++;
+
+                if(testDepth<DepthTest>(x, y, non_linear_z_hom)) {
+                    written++;
+                    if(!Borders || isInsideTriangleAbg(abg, -Consts::ABG_TRIANGLE_BORDER_WIDTH)) {
+                        writePixel<Blend>(x, y, non_linear_z_hom, color);
+                    } else {
+                        // Drawing edge
+                        writePixel<Blend>(x, y, non_linear_z_hom, Color::BLACK);
+                    }
                 }
             }
 
             abg += abg_dx;
         }
     }
+
+    if (_stats) {
+        _stats->pixelsTested += tested;
+        _stats->pixelsWritten += written;
+    }
 }
 
 void Screen::setTitle(const std::string &title) {
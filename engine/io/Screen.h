@@ -1,6 +1,9 @@
 #ifndef IO_SCREEN_H
 #define IO_SCREEN_H
 
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <string>
 #include <map>
 
@@ -9,12 +12,51 @@
 #include <Consts.h>
 #include <utils/Font.h>
 #include <utils/Time.h>
+#include <utils/RenderStats.h>
 #include <objects/Camera.h>
+#include <linalg/Vec3DFloat.h>
 #include <components/geometry/Triangle.h>
 #include <components/geometry/TriangleMesh.h>
 #include <components/lighting/LightSource.h>
+#include <components/lighting/LightGrid.h>
 
 
+// Rectangle of pixels with inclusive bounds (x0 > x1 or y0 > y1 is empty)
+struct ScreenRect final {
+    int x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+
+    [[nodiscard]] bool empty() const { return x0 > x1 || y0 > y1; }
+    [[nodiscard]] uint64_t area() const {
+        return empty() ? 0 : static_cast<uint64_t>(x1 - x0 + 1) * static_cast<uint64_t>(y1 - y0 + 1);
+    }
+    [[nodiscard]] bool intersects(const ScreenRect& rect) const {
+        return !empty() && !rect.empty() && x0 <= rect.x1 && rect.x0 <= x1 && y0 <= rect.y1 && rect.y0 <= y1;
+    }
+    [[nodiscard]] ScreenRect intersected(const ScreenRect& rect) const {
+        return {std::max(x0, rect.x0), std::max(y0, rect.y0), std::min(x1, rect.x1), std::min(y1, rect.y1)};
+    }
+    void merge(const ScreenRect& rect) {
+        if (rect.empty()) {
+            return;
+        }
+        if (empty()) {
+            *this = rect;
+            return;
+        }
+        x0 = std::min(x0, rect.x0);
+        y0 = std::min(y0, rect.y0);
+        x1 = std::max(x1, rect.x1);
+        y1 = std::max(y1, rect.y1);
+    }
+};
+
+// How the rasterizer writes the pixels of a triangle (chosen once per triangle)
+enum class BlendMode : uint8_t {
+    Opaque,           // every pixel replaces the color and the depth
+    Blend,            // transparent pixels are blended over the screen without writing the depth
+    OrderIndependent  // transparent pixels are accumulated (see Screen::resolveTransparency())
+};
+
 class Screen final {
 private:
     SDL_Renderer* _renderer = nullptr;
@@ -26,6 +68,28 @@ private:
 
     uint16_t _width;
     uint16_t _height;
+    // The scene is shown in this top left part of the screen (the rest is left to the UI)
+    uint16_t _viewportWidth = 0;
+    uint16_t _viewportHeight = 0;
+    // Triangles are rasterized in the top left part of the viewport of this size, upscale() stretches it
+    uint16_t _renderWidth = 0;
+    uint16_t _renderHeight = 0;
+    // The scene at the render resolution and the source pixels of the columns (reused by upscale())
+    std::vector<uint32_t> _upscaleBuffer;
+    std::vector<std::pair<uint32_t, uint32_t>> _upscaleColumns;
+    /*
+     * Triangles are not rasterized outside of it. It only cuts the loops of the rasterizers: the pixels inside
+     * are computed exactly the same way as without the scissor (incremental rendering relies on it).
+     */
+    ScreenRect _scissor{0, 0, std::numeric_limits<uint16_t>::max(), std::numeric_limits<uint16_t>::max()};
+    // Triangles of the callers (not projected by the engine) may cover the whole window, not only the 3D viewport
+    bool _wholeWindow = false;
+    // The scene at the render resolution without the UI (incremental rendering, see saveScene())
+    std::vector<uint32_t> _sceneBuffer;
+    uint16_t _sceneWidth = 0;
+    uint16_t _sceneHeight = 0;
+    // Changes with every setting which changes the rendered scene
+    uint32_t _settingsVersion = 0;
     bool _depthTest = false;
 
     bool _renderVideo = false;
@@ -39,6 +103,8 @@ private:
     Color _background;
 
     bool _isOpen = false;
+    // Headless screen renders into the buffers only: there is no window (used for benchmarks)
+    bool _headless = false;
 
     bool _enableLighting = true;
     bool _enableTrueLighting = false;
@@ -46,6 +112,33 @@ private:
     bool _enableTriangleBorders = false;
     bool _enableTexturing = true;
     bool _enableMipmapping = true;
+    uint16_t _maxAnisotropy = 1;
+    /*
+     * Weighted blended order independent transparency (McGuire and Bavoil): transparent pixels are not blended
+     * one over another, they are accumulated with weights which fall with the depth, resolveTransparency()
+     * puts the weighted average over the opaque scene. It needs no sorting and handles intersecting triangles.
+     */
+    bool _orderIndependentTransparency = false;
+    std::vector<std::array<float, 4>> _transparentAccum; // color * alpha * weight and alpha * weight
+    std::vector<float> _transparentRevealage;             // product of (1 - alpha): how much of the scene is seen
+    ScreenRect _transparentRect;                          // pixels with something accumulated
+    // When it is set, exact (per-pixel) lighting takes lights from the cluster of the pixel
+    const LightGrid* _lightGrid = nullptr;
+    // Reused to reduce allocations: vertices of a run of triangles and pixels of a span or a quad (true lighting)
+    LightingBatch _lightingBatch;
+    LightingBatch _pixelLightingBatch;
+
+    // Pixel of the exact lighting: it is lit after the span (or the quad) is rasterized, then it is written
+    struct LitPixel final {
+        uint16_t x = 0, y = 0;
+        double z = 0;     // non-linear depth for the depth buffer
+        double depth = 0; // view space depth: the cluster of the light grid
+        Vec3D abg;        // barycentric coordinates on the screen (for the borders)
+        Vec3D position;   // in the world space
+    };
+    std::vector<LitPixel> _litPixels;
+    std::vector<Vec3DFloat> _pixelLights; // light of _litPixels in 0..255 scale: r, g, b are x, y, z
+    RenderStats* _stats = nullptr;
 
     double _lightingLODNearDistance = Consts::LIGHTING_LOD_NEAR_DISTANCE;
     double _lightingLODFarDistance = Consts::LIGHTING_LOD_FAR_DISTANCE;
@@ -55,6 +148,17 @@ private:
 
     void drawPixelUnsafe(uint16_t x, uint16_t y, const Color& color); // Without using depth buffer and checks
     void drawPixelUnsafe(uint16_t x, uint16_t y, double z, const Color &color); // With using depth buffer without checks
+    void accumulateTransparent(uint16_t x, uint16_t y, double z, const Color& color);
+    void allocateTransparencyBuffers();
+
+    // Changes the setting and counts the change (see settingsVersion())
+    template<typename T>
+    void changeSetting(T& setting, const T& value) {
+        if (setting != value) {
+            setting = value;
+            _settingsVersion++;
+        }
+    }
 
     void plotLineLow(int x_from, int y_from, int x_to, int y_to, const Color &color, uint16_t thickness);
     void plotLineHigh(int x_from, int y_from, int x_to, int y_to, const Color &color, uint16_t thickness);
@@ -64,6 +168,65 @@ private:
 
     void drawLine(const Vec2D& from, const Vec2D& to, const Color &color, uint16_t thickness = 1);
 
+    // Light of the vertices of a triangle in 0..255 scale (r, g, b are x, y, z), it is interpolated over the triangle
+    using VertexLights = std::array<Vec3DFloat, 3>;
+
+    // Lighting is on and the triangle is lit by the interpolated light of its vertices (not by the exact one)
+    [[nodiscard]] bool needsVertexLighting(const Material* material) const;
+    // Adds the vertices of the triangle to _lightingBatch with the level of detail of its distance to the camera
+    void addVertexLighting(const ProjectedTriangle &triangle, const Vec3D& cameraPosition);
+    // Light of the three vertices of _lightingBatch from the given one
+    [[nodiscard]] VertexLights vertexLights(size_t first) const;
+    // Lighting of the vertices of one triangle
+    [[nodiscard]] VertexLights lightVertices(const ProjectedTriangle &triangle,
+                                             const std::vector<std::shared_ptr<LightSource>>& lights,
+                                             const Vec3D& cameraPosition);
+    void drawLitTriangle(const ProjectedTriangle &triangle, const std::vector<std::shared_ptr<LightSource>>& lights,
+                         const VertexLights& vertexLights, Material* material);
+    void drawLitTriangle(const ProjectedTriangle &triangle, const std::vector<std::shared_ptr<LightSource>>& lights,
+                         const VertexLights& vertexLights, const Color &color);
+    /*
+     * Exact lighting of _litPixels into _pixelLights: the pixels which go one after another with the same lights
+     * (the same cluster of the light grid, or all of them without it) are lit in one batch.
+     * Returns the number of the evaluated lights.
+     */
+    uint64_t illuminatePixels(const std::vector<std::shared_ptr<LightSource>>& lights, const Vec3D& normal);
+
+    /*
+     * Rasterizes textured triangle by 2x2 pixel quads: UV derivatives are taken from the neighbour pixels
+     * of the quad, so the mip level is chosen for every quad separately.
+     * For every covered pixel, shader(x, y, abg, z_hom, texel) returns the final color of the pixel.
+     * quadShader(x, y, abg, visible) is called before the pixels of every quad with visible pixels:
+     * abg is of the pixel (x, y), bit i of visible is the pixel (x + i%2, y + i/2).
+     */
+    template<typename PixelShader>
+    void drawTexturedTriangle(const ProjectedTriangle &triangle, const Texture &texture, double d, PixelShader &&shader);
+    template<typename QuadShader, typename PixelShader>
+    void drawTexturedTriangle(const ProjectedTriangle &triangle, const Texture &texture, double d,
+                              QuadShader &&quadShader, PixelShader &&shader);
+
+    /*
+     * Kernels of the rasterizer: the settings are template parameters, so the inner loops do not check them
+     * for every pixel. The draw functions choose the kernel once per triangle (see dispatchFlags() in Screen.cpp).
+     */
+    template<bool DepthTest, BlendMode Blend, bool Borders>
+    void rasterizeTriangle(const ProjectedTriangle &triangle, const Color &color);
+    template<bool DepthTest, BlendMode Blend, bool Borders, bool TrueLighting>
+    void rasterizeLitTriangle(const ProjectedTriangle &triangle, const std::vector<std::shared_ptr<LightSource>>& lights,
+                              const VertexLights& vertexLights, const Color &color);
+    template<bool DepthTest, BlendMode Blend, bool Borders, bool Mipmapping, typename QuadShader, typename PixelShader>
+    void rasterizeTexturedTriangle(const ProjectedTriangle &triangle, const Texture &texture, double d,
+                                   QuadShader &quadShader, PixelShader &shader);
+
+    template<bool DepthTest>
+    [[nodiscard]] bool testDepth(uint16_t x, uint16_t y, double z) const;
+    // The pixel passed the depth test
+    template<BlendMode Blend>
+    void writePixel(uint16_t x, uint16_t y, double z, const Color &color);
+    [[nodiscard]] BlendMode blendMode(bool transparent) const;
+    // Pixels the rasterizers may cover: the render resolution of the scene or the whole window (see _wholeWindow)
+    [[nodiscard]] ScreenRect rasterArea() const;
+
 public:
     Screen& operator=(const Screen& scr) = delete;
 
@@ -79,6 +242,8 @@ public:
     void drawLine(const Line& line, const Color &color, uint16_t thickness = 1);
     void drawTriangle(const Triangle &triangle, Material* material = nullptr);
     void drawTriangle(const Triangle &triangle, const Color &color);
+    void drawTriangle(const ProjectedTriangle &triangle, Material* material = nullptr);
+    void drawTriangle(const ProjectedTriangle &triangle, const Color &color);
     void drawRectangle(int x, int y, uint16_t width, uint16_t height, const Color &color);
     void drawRectangle(int x, int y, uint16_t width, uint16_t height, Material* material = nullptr);
     void drawCircle(int x, int y, uint16_t r, const Color &fillColor);
@@ -89,29 +254,74 @@ public:
     void drawImage(int x, int y, std::shared_ptr<Image> img);
     void drawPlot(const std::vector<std::pair<double, double>>& data, int x, int y, uint16_t w, uint16_t h);
 
-    void drawTriangleWithLighting(const Triangle &projectedTriangle, const Triangle &Mtriangle,
+    // Lights should be prepared for the current frame (see LightSource::prepare())
+    void drawTriangleWithLighting(const ProjectedTriangle &triangle,
                                   const std::vector<std::shared_ptr<LightSource>>& lights,
                                   const Vec3D& cameraPosition, Material* material = nullptr);
-    void drawTriangleWithLighting(const Triangle &projectedTriangle, const Triangle &Mtriangle,
+    void drawTriangleWithLighting(const ProjectedTriangle &triangle,
                                   const std::vector<std::shared_ptr<LightSource>>& lights,
                                   const Vec3D& cameraPosition, const Color &color);
+    /*
+     * Draws a draw list: ProjectedTriangle::lights and ::material are indices in lights and materials.
+     * The vertices of the triangles which go one after another with the same lights are lit in one batch.
+     */
+    void drawTrianglesWithLighting(const DrawList &triangles,
+                                   const std::vector<std::vector<std::shared_ptr<LightSource>>>& lights,
+                                   const std::vector<Material*>& materials, const Vec3D& cameraPosition);
 
     void setTitle(const std::string &title);
+    // Should be set before open()
+    void setHeadless(bool headless) { _headless = headless; }
     void setDepthTest(bool enable) { _depthTest = enable; };
+    // Should be set after open(): by default it is the whole screen. The render resolution is reset to it
+    void setViewport(uint16_t width, uint16_t height);
+    /*
+     * Internal resolution of the scene (dynamic resolution, see ResolutionController): triangles are rasterized
+     * in the top left corner of the viewport and upscale() stretches them over the whole viewport.
+     */
+    void setRenderResolution(uint16_t width, uint16_t height);
+    // Bilinear upscaling of the scene to the viewport: it goes after the scene and before the UI and the text
+    void upscale();
+    // Blends the accumulated transparent pixels over the scene (order independent transparency)
+    void resolveTransparency();
+
+    // Only the pixels of the rectangle are rasterized until resetScissor()
+    void setScissor(const ScreenRect& rect) { _scissor = rect; }
+    void resetScissor() { setScissor({0, 0, std::numeric_limits<uint16_t>::max(), std::numeric_limits<uint16_t>::max()}); }
+    /*
+     * Incremental rendering: the scene is saved before the UI is drawn over it, in the next frame it is restored
+     * (with the rest of the screen cleared), and only the changed rectangle is cleared with clear(rect) and drawn again.
+     */
+    void saveScene();
+    void restoreScene();
+    void clear(const ScreenRect& rect);
+    // Every setter which changes the look of the scene changes it (except the depth test: it is switched for the UI)
+    [[nodiscard]] uint32_t settingsVersion() const { return _settingsVersion; }
 
-    void setLighting(bool enable) { _enableLighting = enable;}
-    void setTrueLighting(bool enable) { _enableTrueLighting = enable; }
-    void setTransparency(bool enable) { _enableTransparency = enable; }
-    void setTriangleBorders(bool enable) { _enableTriangleBorders = enable; }
-    void setTexturing(bool enable) { _enableTexturing = enable; }
-    void setMipmapping(bool enable) { _enableMipmapping = enable; }
-    void setLightingLODNearDistance(double distance) { _lightingLODNearDistance = distance; }
-    void setLightingLODFarDistance(double distance) { _lightingLODFarDistance = distance; }
+    void setLighting(bool enable) { changeSetting(_enableLighting, enable); }
+    void setTrueLighting(bool enable) { changeSetting(_enableTrueLighting, enable); }
+    void setTransparency(bool enable) { changeSetting(_enableTransparency, enable); }
+    void setTriangleBorders(bool enable) { changeSetting(_enableTriangleBorders, enable); }
+    void setTexturing(bool enable) { changeSetting(_enableTexturing, enable); }
+    void setMipmapping(bool enable) { changeSetting(_enableMipmapping, enable); }
+    void setMaxAnisotropy(uint16_t samples) { changeSetting(_maxAnisotropy, std::max<uint16_t>(samples, 1)); }
+    // Transparent triangles do not have to be sorted, resolveTransparency() is called after the last one
+    void setOrderIndependentTransparency(bool enable);
+    void setLightingLODNearDistance(double distance) { changeSetting(_lightingLODNearDistance, distance); }
+    void setLightingLODFarDistance(double distance) { changeSetting(_lightingLODFarDistance, distance); }
+    void setLightGrid(const LightGrid* lightGrid) { changeSetting(_lightGrid, lightGrid); }
+    // Pixel, texture and lighting counters are added to the stats (nullptr turns them off)
+    void setRenderStats(RenderStats* stats) { _stats = stats; }
 
     [[nodiscard]] std::string title() const { return _title; };
     [[nodiscard]] bool isOpen() const;
     [[nodiscard]] uint16_t width() const { return _width; }
     [[nodiscard]] uint16_t height() const { return _height; }
+    [[nodiscard]] uint16_t viewportWidth() const { return _viewportWidth; }
+    [[nodiscard]] uint16_t viewportHeight() const { return _viewportHeight; }
+    [[nodiscard]] uint16_t renderWidth() const { return _renderWidth; }
+    [[nodiscard]] uint16_t renderHeight() const { return _renderHeight; }
+    [[nodiscard]] bool orderIndependentTransparency() const { return _orderIndependentTransparency; }
 
     void close();
 
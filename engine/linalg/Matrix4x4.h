@@ -20,6 +20,11 @@ public:
     [[nodiscard]] Matrix4x4 operator*(const Matrix4x4 &matrix4X4) const;
     [[nodiscard]] Matrix4x4 operator+(const Matrix4x4 &matrix4X4) const;
     [[nodiscard]] Matrix4x4 operator-(const Matrix4x4 &matrix4X4) const;
+    // Exact comparison (for tracking changes, not for math)
+    [[nodiscard]] bool operator==(const Matrix4x4 &matrix4X4) const = default;
+
+    // Row i of the matrix
+    [[nodiscard]] inline const std::array<double, 4>& operator[](std::size_t i) const { return _arr[i]; }
 
     [[nodiscard]] Vec4D operator*(const Vec4D &point4D) const;
     [[nodiscard]] Vec3D operator*(const Vec3D &vec) const;
@@ -53,6 +58,7 @@ public:
     Matrix4x4 static Rotation(const Vec3D &v, double rv);
     Matrix4x4 static View(const Matrix4x4 &transformMatrix);
     Matrix4x4 static Projection(double fov = 90.0, double aspect = 1.0, double ZNear = 1.0, double ZFar = 10.0);
+    Matrix4x4 static Orthographic(double width, double height, double ZNear = 1.0, double ZFar = 10.0);
     Matrix4x4 static ScreenSpace(uint16_t width, uint16_t height, int shiftX=0, int shiftY=0);
 };
 
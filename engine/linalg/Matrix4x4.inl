@@ -174,6 +174,18 @@ inline Matrix4x4 Matrix4x4::Projection(double fov, double aspect, double ZNear,
     return p;
 }
 
+inline Matrix4x4 Matrix4x4::Orthographic(double width, double height, double ZNear, double ZFar) {
+    Matrix4x4 p{};
+
+    p._arr[0][0] = 2.0 / width;
+    p._arr[1][1] = 2.0 / height;
+    p._arr[2][2] = 1.0 / (ZFar - ZNear);
+    p._arr[2][3] = -ZNear / (ZFar - ZNear);
+    p._arr[3][3] = 1.0;
+
+    return p;
+}
+
 inline Matrix4x4 Matrix4x4::ScreenSpace(uint16_t width, uint16_t height, int shiftX, int shiftY) {
     Matrix4x4 s{};
 
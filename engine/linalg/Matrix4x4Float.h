@@ -0,0 +1,32 @@
+#ifndef LINALG_MATRIX4X4FLOAT_H
+#define LINALG_MATRIX4X4FLOAT_H
+
+#include <array>
+
+#include <linalg/Matrix4x4.h>
+#include <linalg/Vec3DFloat.h>
+
+/*
+ * Single precision copy of a Matrix4x4 for the hot paths of the renderer.
+ * The matrices are built and combined in double precision (Matrix4x4) and converted once before the use.
+ */
+class Matrix4x4Float final {
+private:
+    std::array<std::array<float, 4>, 4> _arr{};
+
+public:
+    Matrix4x4Float() = default;
+    explicit Matrix4x4Float(const Matrix4x4 &matrix4X4);
+
+    // Row i of the matrix
+    [[nodiscard]] inline const std::array<float, 4>& operator[](std::size_t i) const { return _arr[i]; }
+
+    // Transforms the point (w = 1) without the division by w
+    [[nodiscard]] Vec3DFloat transformPoint(const Vec3DFloat &point) const;
+    // Transforms the direction (w = 0)
+    [[nodiscard]] Vec3DFloat transformDirection(const Vec3DFloat &direction) const;
+};
+
+#include "Matrix4x4Float.inl"
+
+#endif //LINALG_MATRIX4X4FLOAT_H
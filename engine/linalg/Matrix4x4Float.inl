@@ -0,0 +1,26 @@
+#include <linalg/Matrix4x4Float.h>
+
+
+inline Matrix4x4Float::Matrix4x4Float(const Matrix4x4 &matrix4X4) {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            _arr[i][j] = static_cast<float>(matrix4X4[i][j]);
+        }
+    }
+}
+
+inline Vec3DFloat Matrix4x4Float::transformPoint(const Vec3DFloat &point) const {
+    return Vec3DFloat(
+            _arr[0][0] * point.x() + _arr[0][1] * point.y() + _arr[0][2] * point.z() + _arr[0][3],
+            _arr[1][0] * point.x() + _arr[1][1] * point.y() + _arr[1][2] * point.z() + _arr[1][3],
+            _arr[2][0] * point.x() + _arr[2][1] * point.y() + _arr[2][2] * point.z() + _arr[2][3]
+    );
+}
+
+inline Vec3DFloat Matrix4x4Float::transformDirection(const Vec3DFloat &direction) const {
+    return Vec3DFloat(
+            _arr[0][0] * direction.x() + _arr[0][1] * direction.y() + _arr[0][2] * direction.z(),
+            _arr[1][0] * direction.x() + _arr[1][1] * direction.y() + _arr[1][2] * direction.z(),
+            _arr[2][0] * direction.x() + _arr[2][1] * direction.y() + _arr[2][2] * direction.z()
+    );
+}
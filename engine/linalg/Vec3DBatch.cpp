@@ -0,0 +1,102 @@
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <linalg/Vec3DBatch.h>
+
+void Vec3DBatch::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    _size = 0;
+}
+
+void Vec3DBatch::add(const Vec3D &point) {
+    if (_size == x.size()) {
+        x.resize(x.size() + LANES, 0.0f);
+        y.resize(y.size() + LANES, 0.0f);
+        z.resize(z.size() + LANES, 0.0f);
+    }
+
+    x[_size] = static_cast<float>(point.x());
+    y[_size] = static_cast<float>(point.y());
+    z[_size] = static_cast<float>(point.z());
+    _size++;
+}
+
+void Vec3DBatch::resize(size_t size) {
+    size_t padded = (size + LANES - 1) / LANES * LANES;
+    x.resize(padded);
+    y.resize(padded);
+    z.resize(padded);
+    _size = size;
+}
+
+#if defined(__SSE2__)
+
+// One row of the matrix applied to four points
+static inline __m128 row(const std::array<float, 4>& m, __m128 px, __m128 py, __m128 pz) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), px), _mm_mul_ps(_mm_set1_ps(m[1]), py)),
+                      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2]), pz), _mm_set1_ps(m[3])));
+}
+
+void Vec3DBatch::transform(const Matrix4x4Float &matrix, const Vec3DBatch &points) {
+    resize(points.size());
+
+    for (size_t i = 0; i < paddedSize(); i += LANES) {
+        __m128 px = _mm_loadu_ps(&points.x[i]);
+        __m128 py = _mm_loadu_ps(&points.y[i]);
+        __m128 pz = _mm_loadu_ps(&points.z[i]);
+
+        _mm_storeu_ps(&x[i], row(matrix[0], px, py, pz));
+        _mm_storeu_ps(&y[i], row(matrix[1], px, py, pz));
+        _mm_storeu_ps(&z[i], row(matrix[2], px, py, pz));
+    }
+}
+
+void Vec3DBatch::project(const Matrix4x4Float &matrix, const Vec3DBatch &points, std::vector<float> &invW) {
+    resize(points.size());
+    invW.resize(paddedSize());
+
+    for (size_t i = 0; i < paddedSize(); i += LANES) {
+        __m128 px = _mm_loadu_ps(&points.x[i]);
+        __m128 py = _mm_loadu_ps(&points.y[i]);
+        __m128 pz = _mm_loadu_ps(&points.z[i]);
+
+        // The padding has w = 0 (for the perspective) and gets infinities: nobody reads them
+        __m128 iw = _mm_div_ps(_mm_set1_ps(1.0f), row(matrix[3], px, py, pz));
+        _mm_storeu_ps(&x[i], _mm_mul_ps(row(matrix[0], px, py, pz), iw));
+        _mm_storeu_ps(&y[i], _mm_mul_ps(row(matrix[1], px, py, pz), iw));
+        _mm_storeu_ps(&z[i], _mm_mul_ps(row(matrix[2], px, py, pz), iw));
+        _mm_storeu_ps(&invW[i], iw);
+    }
+}
+
+#else
+
+void Vec3DBatch::transform(const Matrix4x4Float &matrix, const Vec3DBatch &points) {
+    resize(points.size());
+
+    for (size_t i = 0; i < paddedSize(); i++) {
+        Vec3DFloat point = matrix.transformPoint(points[i]);
+        x[i] = point.x();
+        y[i] = point.y();
+        z[i] = point.z();
+    }
+}
+
+void Vec3DBatch::project(const Matrix4x4Float &matrix, const Vec3DBatch &points, std::vector<float> &invW) {
+    resize(points.size());
+    invW.resize(paddedSize());
+
+    for (size_t i = 0; i < paddedSize(); i++) {
+        float px = points.x[i], py = points.y[i], pz = points.z[i];
+        float iw = 1.0f / (matrix[3][0] * px + matrix[3][1] * py + matrix[3][2] * pz + matrix[3][3]);
+        x[i] = (matrix[0][0] * px + matrix[0][1] * py + matrix[0][2] * pz + matrix[0][3]) * iw;
+        y[i] = (matrix[1][0] * px + matrix[1][1] * py + matrix[1][2] * pz + matrix[1][3]) * iw;
+        z[i] = (matrix[2][0] * px + matrix[2][1] * py + matrix[2][2] * pz + matrix[2][3]) * iw;
+        invW[i] = iw;
+    }
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef LINALG_VEC3DBATCH_H
+#define LINALG_VEC3DBATCH_H
+
+#include <vector>
+
+#include <linalg/Matrix4x4Float.h>
+
+/*
+ * Points in the SoA layout for the SIMD kernels: every coordinate is in its own array.
+ * Arrays are padded up to a multiple of LANES, so the kernels never need a scalar tail.
+ */
+struct Vec3DBatch final {
+    static constexpr size_t LANES = 4;
+
+    std::vector<float> x, y, z;
+
+    [[nodiscard]] size_t size() const { return _size; }
+    [[nodiscard]] size_t paddedSize() const { return x.size(); }
+    [[nodiscard]] Vec3DFloat operator[](size_t i) const { return Vec3DFloat(x[i], y[i], z[i]); }
+
+    // Removes all points (memory is kept for the next use)
+    void clear();
+    void add(const Vec3D& point);
+
+    // Replaces the points with matrix * points (w = 1, no division by w). points can be this batch
+    void transform(const Matrix4x4Float& matrix, const Vec3DBatch& points);
+    // Replaces the points with the projection of points: matrix * points divided by w, invW is 1/w
+    void project(const Matrix4x4Float& matrix, const Vec3DBatch& points, std::vector<float>& invW);
+
+private:
+    size_t _size = 0;
+
+    void resize(size_t size);
+};
+
+#endif //LINALG_VEC3DBATCH_H
@@ -0,0 +1,53 @@
+#ifndef LINALG_VEC3DFLOAT_H
+#define LINALG_VEC3DFLOAT_H
+
+#include <array>
+
+#include <linalg/Vec3D.h>
+
+/*
+ * Single precision counterpart of Vec3D for the hot paths of the renderer (projection, rasterization, lighting).
+ * Geometry, physics and the editor keep the double precision Vec3D.
+ */
+class Vec3DFloat final {
+private:
+    std::array<float, 3> _arr_point{};
+
+public:
+    Vec3DFloat() = default;
+    explicit Vec3DFloat(const Vec3D &vec);
+    explicit Vec3DFloat(float x, float y = 0.0f, float z = 0.0f);
+
+    [[nodiscard]] inline const float& x() const { return _arr_point[0]; }
+    [[nodiscard]] inline const float& y() const { return _arr_point[1]; }
+    [[nodiscard]] inline const float& z() const { return _arr_point[2]; }
+
+    [[nodiscard]] inline float& operator[](std::size_t i) { return _arr_point[i]; }
+    [[nodiscard]] inline const float& operator[](std::size_t i) const { return _arr_point[i]; }
+
+    [[nodiscard]] Vec3DFloat operator-() const;
+
+    // Operations with Vec3DFloat
+    Vec3DFloat &operator+=(const Vec3DFloat &vec);
+    [[nodiscard]] Vec3DFloat operator+(const Vec3DFloat &vec) const;
+
+    Vec3DFloat &operator-=(const Vec3DFloat &vec);
+    [[nodiscard]] Vec3DFloat operator-(const Vec3DFloat &vec) const;
+
+    [[nodiscard]] float dot(const Vec3DFloat &vec) const; // Returns dot product
+    [[nodiscard]] Vec3DFloat cross(const Vec3DFloat &vec) const; // Returns cross product
+
+    // Operations with numbers
+    Vec3DFloat &operator*=(float number);
+    [[nodiscard]] Vec3DFloat operator*(float number) const;
+
+    // Other useful methods
+    [[nodiscard]] float sqrAbs() const; // Returns squared vector length
+    [[nodiscard]] float abs() const; // Returns vector length
+    [[nodiscard]] Vec3DFloat normalized() const; // Returns normalized vector without changing
+    [[nodiscard]] Vec3D toVec3D() const;
+};
+
+#include "Vec3DFloat.inl"
+
+#endif //LINALG_VEC3DFLOAT_H
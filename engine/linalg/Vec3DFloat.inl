@@ -0,0 +1,91 @@
+#include <cmath>
+
+#include <ScalarConsts.h>
+#include <linalg/Vec3DFloat.h>
+
+
+inline Vec3DFloat::Vec3DFloat(const Vec3D &vec) : _arr_point{static_cast<float>(vec.x()),
+                                                             static_cast<float>(vec.y()),
+                                                             static_cast<float>(vec.z())} {}
+
+inline Vec3DFloat::Vec3DFloat(float x, float y, float z) : _arr_point{x, y, z} {}
+
+
+inline Vec3DFloat Vec3DFloat::operator-() const {
+    return Vec3DFloat(-x(), -y(), -z());
+}
+
+// Operations with Vec3DFloat
+
+inline Vec3DFloat &Vec3DFloat::operator+=(const Vec3DFloat &vec) {
+    _arr_point[0] += vec._arr_point[0];
+    _arr_point[1] += vec._arr_point[1];
+    _arr_point[2] += vec._arr_point[2];
+    return *this;
+}
+
+inline Vec3DFloat &Vec3DFloat::operator-=(const Vec3DFloat &vec) {
+    _arr_point[0] -= vec._arr_point[0];
+    _arr_point[1] -= vec._arr_point[1];
+    _arr_point[2] -= vec._arr_point[2];
+    return *this;
+}
+
+inline Vec3DFloat &Vec3DFloat::operator*=(float number) {
+    _arr_point[0] *= number;
+    _arr_point[1] *= number;
+    _arr_point[2] *= number;
+    return *this;
+}
+
+
+inline Vec3DFloat Vec3DFloat::operator+(const Vec3DFloat &vec) const {
+    Vec3DFloat res = *this;
+    res += vec;
+    return res;
+}
+
+inline Vec3DFloat Vec3DFloat::operator-(const Vec3DFloat &vec) const {
+    Vec3DFloat res = *this;
+    res -= vec;
+    return res;
+}
+
+inline Vec3DFloat Vec3DFloat::operator*(float number) const {
+    Vec3DFloat res = *this;
+    res *= number;
+    return res;
+}
+
+// Other useful methods
+
+inline float Vec3DFloat::sqrAbs() const {
+    return x() * x() + y() * y() + z() * z();
+}
+
+inline float Vec3DFloat::abs() const {
+    return std::sqrt(sqrAbs());
+}
+
+inline Vec3DFloat Vec3DFloat::normalized() const {
+    float vecAbs = sqrAbs();
+    if (vecAbs > Consts::EPS) {
+        return *this * (1.0f / std::sqrt(vecAbs));
+    } else {
+        return Vec3DFloat(1);
+    }
+}
+
+inline float Vec3DFloat::dot(const Vec3DFloat &vec) const {
+    return vec.x() * x() + vec.y() * y() + vec.z() * z();
+}
+
+inline Vec3DFloat Vec3DFloat::cross(const Vec3DFloat &vec) const {
+    return Vec3DFloat{y() * vec.z() - vec.y() * z(),
+                      z() * vec.x() - vec.z() * x(),
+                      x() * vec.y() - vec.x() * y()};
+}
+
+inline Vec3D Vec3DFloat::toVec3D() const {
+    return Vec3D(x(), y(), z());
+}
@@ -4,105 +4,244 @@
 #include <objects/Camera.h>
 #include <Consts.h>
 
-std::vector<std::pair<Triangle, Triangle>> Camera::project(const TriangleMesh& triangleMesh) {
+std::optional<uint8_t> Camera::cullBounds(const Bounds& bounds, uint8_t planes) const {
+    const auto& [center, extents] = bounds;
+    uint8_t crossed = 0;
 
-    std::vector<std::pair<Triangle, Triangle>> result{};
+    for (size_t i = 0; i < _clipPlanes.size(); i++) {
+        if (!(planes & (1 << i))) {
+            continue;
+        }
+        const auto& plane = _clipPlanes[i];
+        double r =
+            extents.x() * std::abs(plane.normal.x()) +
+            extents.y() * std::abs(plane.normal.y()) +
+            extents.z() * std::abs(plane.normal.z());
+        double distance = plane.distance(center);
+
+        if (distance + r < 0) {
+            return std::nullopt;
+        }
+        if (distance - r < 0) {
+            crossed |= 1 << i;
+        }
+    }
+    return crossed;
+}
 
+std::optional<uint8_t> Camera::frustumTest(const Bounds& bounds, uint8_t planes) {
+    if (!_ready) {
+        init(Consts::STANDARD_SCREEN_WIDTH, Consts::STANDARD_SCREEN_HEIGHT);
+    }
+    return cullBounds(bounds*_transformMatrix->fullInvModel(), planes);
+}
+
+size_t Camera::project(const TriangleMesh& triangleMesh, DrawList& result, uint8_t planes) {
     if (!_ready) {
         init(Consts::STANDARD_SCREEN_WIDTH, Consts::STANDARD_SCREEN_HEIGHT);
     }
 
     if (!triangleMesh.isVisible()) {
-        return result;
+        return 0;
     }
     // Model transform matrix: translate _tris in the origin of body.
     Matrix4x4 objectToCamera = _transformMatrix->fullInvModel() * triangleMesh.getComponent<TransformMatrix>()->fullModel();
 
-    Matrix4x4 cameraToWorld = _transformMatrix->fullModel();
+    return projectInstance(triangleMesh, objectToCamera, _transformMatrix->fullModel(), result, planes);
+}
 
-    // Transform mesh bounds into camera coordinates
-    auto [center, extents] = triangleMesh.bounds()*objectToCamera;
+size_t Camera::project(const TriangleMesh &triangleMesh, const Instance &instance, DrawList &result) {
+    if (!_ready) {
+        init(Consts::STANDARD_SCREEN_WIDTH, Consts::STANDARD_SCREEN_HEIGHT);
+    }
 
-    // Check if object bounds is inside camera frustum
-    for (auto &plane : _clipPlanes) {
-        double r =
-            extents.x() * std::abs(plane.normal.x()) +
-            extents.y() * std::abs(plane.normal.y()) +
-            extents.z() * std::abs(plane.normal.z());
+    if (!triangleMesh.isVisible()) {
+        return 0;
+    }
+    return projectInstance(triangleMesh, _transformMatrix->fullInvModel() * instance.model, _transformMatrix->fullModel(),
+                           result, instance.planes);
+}
 
-        if (plane.distance(center) + r < 0)
-            return result;
+size_t Camera::project(const TriangleMesh &triangleMesh, const std::vector<Instance> &instances, DrawList &result,
+                       std::vector<size_t> &ends) {
+    size_t first = result.size();
+    ends.clear();
+
+    if (!_ready) {
+        init(Consts::STANDARD_SCREEN_WIDTH, Consts::STANDARD_SCREEN_HEIGHT);
     }
 
-    for (auto &t : triangleMesh.triangles()) {
+    if (!triangleMesh.isVisible()) {
+        ends.resize(instances.size(), first);
+        return 0;
+    }
 
-        // TODO: here we apply the same objectToCamera matrix every single frame. Might be improved by cashing.
-        Triangle MTriangle = t * objectToCamera;
-        double dot = MTriangle.norm().dot(Vec3D(MTriangle[0]));
+    // The camera matrices are the same for all the instances
+    Matrix4x4 worldToCamera = _transformMatrix->fullInvModel();
+    Matrix4x4 cameraToWorld = _transformMatrix->fullModel();
+
+    for (const auto& instance : instances) {
+        projectInstance(triangleMesh, worldToCamera * instance.model, cameraToWorld, result, instance.planes);
+        ends.push_back(result.size());
+    }
+
+    return result.size() - first;
+}
+
+void Camera::projectVertex(const Vec3D &position, const Vec3D &uv, const Matrix4x4 &cameraToWorld) {
+    // Projection from 3D -> 2D and transformation to the screen space (in pixels)
+    Vec4D tmp = _SP * position.makePoint4D();
+    Vec4D world = cameraToWorld * position.makePoint4D();
+    double invW = 1.0 / tmp.w();
+
+    _projectedBuffer.push_back({tmp.z()*invW,
+                                static_cast<float>(tmp.x()*invW),
+                                static_cast<float>(tmp.y()*invW),
+                                static_cast<float>(uv.z()*invW),
+                                static_cast<float>(uv.x()*invW),
+                                static_cast<float>(uv.y()*invW),
+                                {static_cast<float>(world.x()),
+                                 static_cast<float>(world.y()),
+                                 static_cast<float>(world.z())}});
+}
+
+void Camera::addProjectedVertex(size_t i, const Vec3D &uv) {
+    // The depth is computed again in double from the camera space position (see ProjectedVertex)
+    double x = _cameraVertices.x[i], y = _cameraVertices.y[i], z = _cameraVertices.z[i];
+    double depth = (_SP[2][0]*x + _SP[2][1]*y + _SP[2][2]*z + _SP[2][3]) /
+                   (_SP[3][0]*x + _SP[3][1]*y + _SP[3][2]*z + _SP[3][3]);
+
+    _projectedBuffer.push_back({depth,
+                                _screenVertices.x[i],
+                                _screenVertices.y[i],
+                                static_cast<float>(uv.z()*_invW[i]),
+                                static_cast<float>(uv.x()*_invW[i]),
+                                static_cast<float>(uv.y()*_invW[i]),
+                                {_worldVertices.x[i], _worldVertices.y[i], _worldVertices.z[i]}});
+}
+
+size_t Camera::projectInstance(const TriangleMesh &triangleMesh, const Matrix4x4 &objectToCamera,
+                               const Matrix4x4 &cameraToWorld, DrawList &result, uint8_t planes) {
+    size_t first = result.size();
+
+    // Check if object bounds (in camera coordinates) is inside camera frustum
+    auto crossed = cullBounds(triangleMesh.bounds()*objectToCamera, planes);
+    if (!crossed) {
+        if (_stats) {
+            _stats->objectsFrustumCulled++;
+        }
+        return 0;
+    }
+
+    // All the vertices of the mesh are transformed at once (SIMD), the triangles only pick them from the batches
+    const auto& triangles = triangleMesh.triangles();
+    _cameraVertices.transform(Matrix4x4Float(objectToCamera), triangleMesh.vertices());
+    _screenVertices.project(Matrix4x4Float(_SP * objectToCamera), triangleMesh.vertices(), _invW);
+    _worldVertices.transform(Matrix4x4Float(cameraToWorld * objectToCamera), triangleMesh.vertices());
+    Matrix4x4Float cameraToWorldFloat(cameraToWorld);
+
+    /*
+     * Back-face culling is done in the object space with the normals of the mesh: single precision is not enough
+     * for small triangles seen almost edge-on. A mirroring transform turns the triangles inside out.
+     */
+    Matrix4x4 cameraToObject = objectToCamera.inverse();
+    Vec3D cameraOrigin = Vec3D(cameraToObject * Vec4D(0, 0, 0, 1));
+    Vec3D viewDirection = cameraToObject * Vec3D(0, 0, 1);
+    double handedness = objectToCamera.x().dot(objectToCamera.y().cross(objectToCamera.z())) < 0 ? -1 : 1;
+
+    for (size_t t = 0; t < triangles.size(); t++) {
+        const Triangle& triangle = triangles[t];
+        // For the orthographic projection all rays are parallel to the Z axis
+        double dot = handedness * triangle.norm().dot(_orthographic ? viewDirection : Vec3D(triangle[0]) - cameraOrigin);
 
         if (dot > 0) {
+            if (_stats) {
+                _stats->trianglesBackfaceCulled++;
+            }
             continue;
         }
 
-        // In the beginning we need to translate triangle from object local coordinate to world coordinates:
-        // After that we apply clipping for all planes from _clipPlanes
+        /*
+         * Outcodes: the planes from _clipPlanes (only the ones the bounds of the mesh cross) every vertex is behind.
+         * A triangle behind one plane with all the vertices is invisible, a triangle with no outcodes is not clipped.
+         * Only the near and the far planes really need clipping, the side planes clip the triangles
+         * which go beyond the guard band: the rest is cut by the bounding box of the rasterizer.
+         */
+        const auto& uv = triangle.textureCoordinates();
+        std::array<Vec3DFloat, 3> cameraPositions = {_cameraVertices[3*t], _cameraVertices[3*t + 1], _cameraVertices[3*t + 2]};
+        std::array<Vec3D, 3> positions = {cameraPositions[0].toVec3D(), cameraPositions[1].toVec3D(), cameraPositions[2].toVec3D()};
+        uint8_t outsideAll = *crossed;
+        uint8_t outsideAny = 0;
+        uint8_t outsideGuard = 0;
+        for (const auto& position : positions) {
+            uint8_t outcode = 0;
+            for (size_t p = 0; p < _clipPlanes.size(); p++) {
+                if ((*crossed & (1 << p)) && _clipPlanes[p].distance(position) < 0) {
+                    outcode |= 1 << p;
+                    if (p >= 2 && _guardPlanes[p - 2].distance(position) < 0) {
+                        outsideGuard |= 1 << p;
+                    }
+                }
+            }
+            outsideAll &= outcode;
+            outsideAny |= outcode;
+        }
+        if (outsideAll != 0) {
+            continue;
+        }
 
-        _clipBuffer2.emplace_back(Vec3D(MTriangle.points()[0]), MTriangle.textureCoordinates()[0]);
-        _clipBuffer2.emplace_back(Vec3D(MTriangle.points()[1]), MTriangle.textureCoordinates()[1]);
-        _clipBuffer2.emplace_back(Vec3D(MTriangle.points()[2]), MTriangle.textureCoordinates()[2]);
-        for (auto &plane : _clipPlanes) {
-            _clipBuffer1.swap(_clipBuffer2);
+        _projectedBuffer.clear();
+        // The normal is the same for all the pieces of the clipped triangle
+        // Degenerate triangles have no normal (see Triangle::calculateNormal())
+        Vec3DFloat normal = (cameraPositions[1] - cameraPositions[0]).cross(cameraPositions[2] - cameraPositions[0]);
+        normal = normal.sqrAbs() > Consts::EPS ? normal.normalized() : Vec3DFloat();
+        Vec3DFloat worldNormal = cameraToWorldFloat.transformDirection(normal);
+
+        uint8_t clipPlanes = (outsideAny & NEAR_FAR_PLANES) | outsideGuard;
+        if (clipPlanes == 0) {
+            for (int i = 0; i < 3; i++) {
+                addProjectedVertex(3*t + i, uv[i]);
+            }
+        } else {
+            // New vertices appear on the planes: the clipped triangles are projected one by one
+            for (int i = 0; i < 3; i++) {
+                _clipBuffer2.emplace_back(positions[i], uv[i]);
+            }
+            for (size_t p = 0; p < _clipPlanes.size(); p++) {
+                if (!(clipPlanes & (1 << p))) {
+                    continue;
+                }
+                _clipBuffer1.swap(_clipBuffer2);
+                _clipBuffer2.clear();
+                (p < 2 ? _clipPlanes[p] : _guardPlanes[p - 2]).clip(_clipBuffer1, _clipBuffer2);
+            }
+            if (_stats) {
+                _stats->trianglesClipped++;
+            }
+            for (const auto& [position, uv] : _clipBuffer2) {
+                projectVertex(position, uv, cameraToWorld);
+            }
+
+            // It needs to be cleared because it's reused through iterations. Usually it doesn't free memory.
+            _clipBuffer1.clear();
             _clipBuffer2.clear();
-            plane.clip(_clipBuffer1, _clipBuffer2);
         }
 
-        _clipBuffer1.clear();
-        // It's time to project our clipped polygon from 3D -> 2D
-        // and transform its coordinate to screen space (in pixels):
-        for (auto &vertex : _clipBuffer2) {
-            _clipBuffer1.emplace_back(vertex);
-
-            Vec4D tmp = _SP * vertex.first.makePoint4D();
-            vertex.first = Vec3D(tmp) / tmp.w();
-            vertex.second /= tmp.w();
+        if (_stats && _projectedBuffer.size() > 2) {
+            _stats->trianglesEmitted += _projectedBuffer.size() - 2;
         }
 
         // Finally, create triangle from sorted list of vertices
-        for (size_t i = 2; i < _clipBuffer2.size(); i++) {
-            result.emplace_back(
-                    // The first one is projected triangle
-                    Triangle{std::array<Vec4D, 3>{
-                            _clipBuffer2[0].first.makePoint4D(),
-                            _clipBuffer2[i - 1].first.makePoint4D(),
-                            _clipBuffer2[i].first.makePoint4D()
-                        },
-                             std::array<Vec3D, 3>{
-                            _clipBuffer2[0].second,
-                            _clipBuffer2[i - 1].second,
-                            _clipBuffer2[i].second
-                            }
-                        },
-                    // The second one is in the world space (not projected)
-                        Triangle{std::array<Vec4D, 3>{
-                            cameraToWorld*(_clipBuffer1[0].first.makePoint4D()),
-                            cameraToWorld*(_clipBuffer1[i - 1].first.makePoint4D()),
-                            cameraToWorld*(_clipBuffer1[i].first.makePoint4D())
-                        },
-                                 std::array<Vec3D, 3>{
-                            _clipBuffer1[0].second,
-                            _clipBuffer1[i - 1].second,
-                            _clipBuffer1[i].second
-                        }
-                    }
-            );
+        for (size_t i = 2; i < _projectedBuffer.size(); i++) {
+            ProjectedTriangle& projected = result.emplace_back();
+            projected.vertices = {_projectedBuffer[0], _projectedBuffer[i - 1], _projectedBuffer[i]};
+            projected.normal[0] = worldNormal.x();
+            projected.normal[1] = worldNormal.y();
+            projected.normal[2] = worldNormal.z();
         }
-
-        // It needs to be cleared because it's reused through iterations. Usually it doesn't free memory.
-        _clipBuffer1.clear();
-        _clipBuffer2.clear();
     }
 
-    return result;
+    return result.size() - first;
 }
 
 void Camera::init(int width, int height, double fov, double ZNear, double ZFar) {
@@ -112,6 +251,7 @@ void Camera::init(int width, int height, double fov, double ZNear, double ZFar)
     _zfar = ZFar;
     _fov = fov;
     _aspect = (double) width / (double) height;
+    _orthographic = false;
     Matrix4x4 P = Matrix4x4::Projection(fov, _aspect, ZNear, ZFar);
     Matrix4x4 S = Matrix4x4::ScreenSpace(width, height);
 
@@ -121,6 +261,7 @@ void Camera::init(int width, int height, double fov, double ZNear, double ZFar)
     // Motivation: we are not interested in _tris that we cannot see.
     double thetta1 = Consts::PI * fov * 0.5 / 180.0;
     double thetta2 = atan(_aspect * tan(thetta1));
+    _clipPlanes.clear();
     _clipPlanes.reserve(6);
     _clipPlanes.emplace_back(Vec3D{0, 0, 1}, Vec3D{0, 0, ZNear}); // near plane
     _clipPlanes.emplace_back(Vec3D{0, 0, -1}, Vec3D{0, 0, ZFar}); // far plane
@@ -129,19 +270,62 @@ void Camera::init(int width, int height, double fov, double ZNear, double ZFar)
     _clipPlanes.emplace_back(Vec3D{0, cos(thetta1), sin(thetta1)}, -Consts::EPS); // down plane
     _clipPlanes.emplace_back(Vec3D{0, -cos(thetta1), sin(thetta1)}, -Consts::EPS); // up plane
 
+    double guardX = Consts::CLIP_GUARD_BAND * tan(thetta2);
+    double guardY = Consts::CLIP_GUARD_BAND * tan(thetta1);
+    _guardPlanes = {Plane(Vec3D{-1, 0, guardX}.normalized(), 0),
+                    Plane(Vec3D{1, 0, guardX}.normalized(), 0),
+                    Plane(Vec3D{0, 1, guardY}.normalized(), 0),
+                    Plane(Vec3D{0, -1, guardY}.normalized(), 0)};
+
     // 3 vertices from triangle, 1 vertex from each plane clip
     _clipBuffer1.reserve(9);
     _clipBuffer2.reserve(9);
+    _projectedBuffer.reserve(9);
+
+    _ready = true;
+    LOG_DEBUG("Camera::init(): camera successfully initialized.");
+}
+
+void Camera::initOrthographic(int width, int height, double viewWidth, double viewHeight, double ZNear, double ZFar) {
+    _znear = ZNear;
+    _zfar = ZFar;
+    _fov = 0;
+    _aspect = viewWidth / viewHeight;
+    _orthographic = true;
+    Matrix4x4 P = Matrix4x4::Orthographic(viewWidth, viewHeight, ZNear, ZFar);
+    Matrix4x4 S = Matrix4x4::ScreenSpace(width, height);
+
+    _SP = S * P;
+
+    // The view volume is a box, so all planes are parallel to the axes
+    _clipPlanes.clear();
+    _clipPlanes.reserve(6);
+    _clipPlanes.emplace_back(Vec3D{0, 0, 1}, Vec3D{0, 0, ZNear}); // near plane
+    _clipPlanes.emplace_back(Vec3D{0, 0, -1}, Vec3D{0, 0, ZFar}); // far plane
+    _clipPlanes.emplace_back(Vec3D{1, 0, 0}, Vec3D{-viewWidth/2, 0, 0}); // left plane
+    _clipPlanes.emplace_back(Vec3D{-1, 0, 0}, Vec3D{viewWidth/2, 0, 0}); // right plane
+    _clipPlanes.emplace_back(Vec3D{0, 1, 0}, Vec3D{0, -viewHeight/2, 0}); // down plane
+    _clipPlanes.emplace_back(Vec3D{0, -1, 0}, Vec3D{0, viewHeight/2, 0}); // up plane
+
+    double guardX = Consts::CLIP_GUARD_BAND * viewWidth/2;
+    double guardY = Consts::CLIP_GUARD_BAND * viewHeight/2;
+    _guardPlanes = {Plane(Vec3D{1, 0, 0}, Vec3D{-guardX, 0, 0}),
+                    Plane(Vec3D{-1, 0, 0}, Vec3D{guardX, 0, 0}),
+                    Plane(Vec3D{0, 1, 0}, Vec3D{0, -guardY, 0}),
+                    Plane(Vec3D{0, -1, 0}, Vec3D{0, guardY, 0})};
+
+    _clipBuffer1.reserve(9);
+    _clipBuffer2.reserve(9);
+    _projectedBuffer.reserve(9);
 
     _ready = true;
-    Log::log("Camera::init(): camera successfully initialized.");
 }
 
 std::vector<Line> Camera::project(const LineMesh &lineMesh) {
     std::vector<Line> result{};
 
     if (!_ready) {
-        Log::log("Camera::project(): cannot project lineMesh without camera initialization ( Camera::init(); ) ");
+        LOG_WARNING("Camera::project(): cannot project lineMesh without camera initialization ( Camera::init(); ) ");
         return result;
     }
 
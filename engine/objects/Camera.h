@@ -1,29 +1,98 @@
 #ifndef OBJECTS_CAMERA_H
 #define OBJECTS_CAMERA_H
 
+#include <array>
+#include <cstdint>
+#include <optional>
 #include <vector>
 
+#include <linalg/Vec3DBatch.h>
+#include <components/geometry/Bounds.h>
 #include <components/geometry/Plane.h>
 #include <components/geometry/TriangleMesh.h>
 #include <components/geometry/LineMesh.h>
+#include <utils/RenderStats.h>
+#include <utils/FrameArena.h>
+
+// Vertex of a projected triangle: only the attributes which the rasterizer interpolates
+struct ProjectedVertex final {
+    // Non-linear depth: it stays double, in float far surfaces (near 0.1, far 5000) z-fight already at w ~ 1000
+    double z = 0;
+    float x = 0, y = 0;        // in the screen space
+    float invW = 1;            // 1/w: perspective-correct interpolation goes through it
+    float u = 0, v = 0;        // texture coordinates divided by w
+    float world[3]{};          // position in the world space (for the lighting)
+
+    [[nodiscard]] Vec3D worldPosition() const { return Vec3D(world[0], world[1], world[2]); }
+};
+
+/*
+ * Triangle ready for the rasterization. It is single precision (except the depth) and keeps only what the sort
+ * and the rasterizer read: one record takes three cache lines (two full Triangle copies took about 400 bytes).
+ */
+struct alignas(64) ProjectedTriangle final {
+    std::array<ProjectedVertex, 3> vertices;
+    float normal[3]{};     // in the world space
+    uint32_t material = 0; // index of the material in the material table of the frame (see Engine)
+    uint32_t lights = 0;   // index of the light list of the object (see Engine)
+
+    [[nodiscard]] const ProjectedVertex& operator[](int i) const { return vertices[i]; }
+    [[nodiscard]] Vec3D worldNormal() const { return Vec3D(normal[0], normal[1], normal[2]); }
+};
+
+static_assert(sizeof(ProjectedTriangle) == 192);
+
+// Usually backed by the frame arena, so appending to it does not touch the heap
+using DrawList = ArenaVector<ProjectedTriangle>;
 
 class Camera final : public Object {
 private:
     std::vector<Plane> _clipPlanes;
+    // Left, right, down and up planes moved Consts::CLIP_GUARD_BAND times away from the center of the view
+    std::array<Plane, 4> _guardPlanes;
     double _znear = 0;
     double _zfar = 0;
     double _fov = 0;
     bool _ready = false;
     double _aspect = 0;
+    bool _orthographic = false;
 
     // Internal variables to reduce allocations
     std::vector<std::pair<Vec3D, Vec3D>> _clipBuffer1;
     std::vector<std::pair<Vec3D, Vec3D>> _clipBuffer2;
+    std::vector<ProjectedVertex> _projectedBuffer;
+    // Vertices of the mesh projected at once in single precision: in the camera, the screen and the world space
+    Vec3DBatch _cameraVertices;
+    Vec3DBatch _screenVertices;
+    Vec3DBatch _worldVertices;
+    std::vector<float> _invW;
 
     Matrix4x4 _SP;
 
+    RenderStats* _stats = nullptr;
+
     std::shared_ptr<TransformMatrix> _transformMatrix;
+
+    // Tests camera space bounds against the planes of the mask (see frustumTest())
+    [[nodiscard]] std::optional<uint8_t> cullBounds(const Bounds& bounds, uint8_t planes) const;
+    // Everything after the setup of the camera matrices: culling, clipping and projection of one placement of the mesh
+    // Appends the camera space vertex to _projectedBuffer
+    void projectVertex(const Vec3D& position, const Vec3D& uv, const Matrix4x4& cameraToWorld);
+    // Appends the vertex i of the batches (it was not clipped) to _projectedBuffer
+    void addProjectedVertex(size_t i, const Vec3D& uv);
+    size_t projectInstance(const TriangleMesh& triangleMesh, const Matrix4x4& objectToCamera,
+                           const Matrix4x4& cameraToWorld, DrawList& result, uint8_t planes);
 public:
+    // Bit i of a plane mask is the plane i of the frustum (near, far, left, right, down, up)
+    static constexpr uint8_t ALL_PLANES = 0x3F;
+    static constexpr uint8_t NEAR_FAR_PLANES = 0x03;
+
+    // Placement of a mesh given by the caller instead of the TransformMatrix of the mesh
+    struct Instance final {
+        Matrix4x4 model;               // object space -> world space
+        uint8_t planes = ALL_PLANES;   // frustum planes the instance may cross
+    };
+
     Camera() : Object(ObjectTag("Camera")) {
         _transformMatrix = addComponent<TransformMatrix>();
     };
@@ -31,11 +100,42 @@ public:
     Camera(const Camera &camera) = delete;
 
     void init(int width, int height, double fov = 90.0, double ZNear = 0.1, double ZFar = 5000.0);
+    // The view box is viewWidth x viewHeight in the camera space (used for the shadow maps of directional lights)
+    void initOrthographic(int width, int height, double viewWidth, double viewHeight, double ZNear, double ZFar);
+
+    /*
+     * Tests world space bounds against the frustum planes of the mask. Returns std::nullopt if the bounds are
+     * outside of one of the planes, otherwise the mask of the planes the bounds cross (the rest of them
+     * have the bounds completely inside, so the objects inside the bounds do not need to be tested against them).
+     */
+    [[nodiscard]] std::optional<uint8_t> frustumTest(const Bounds& bounds, uint8_t planes = ALL_PLANES);
 
-    std::vector<std::pair<Triangle, Triangle>> project(const TriangleMesh& triangleMesh);
+    /*
+     * Appends the visible triangles of the mesh to the list, returns how many were added.
+     * The mesh is known to be inside the planes which are not in the mask, so it is tested and clipped only by the rest.
+     * material and lights of the added records are left zero: they are set by the caller.
+     */
+    size_t project(const TriangleMesh& triangleMesh, DrawList& result, uint8_t planes = ALL_PLANES);
+    size_t project(const TriangleMesh& triangleMesh, const Instance& instance, DrawList& result);
+    /*
+     * Instanced projection: the mesh is projected for every instance, the camera matrices are computed once.
+     * ends[i] is the size of the list after the triangles of the instance i, so the caller can tell them apart.
+     */
+    size_t project(const TriangleMesh& triangleMesh, const std::vector<Instance>& instances, DrawList& result,
+                   std::vector<size_t>& ends);
     std::vector<Line> project(const LineMesh& lineMesh);
 
     std::shared_ptr<TransformMatrix> transformMatrix() const { return _transformMatrix; }
+
+    // Culling and clipping counters are added to the stats (nullptr turns them off)
+    void setRenderStats(RenderStats* stats) { _stats = stats; }
+
+    [[nodiscard]] double fov() const { return _fov; }
+    [[nodiscard]] double aspect() const { return _aspect; }
+    [[nodiscard]] double zNear() const { return _znear; }
+    [[nodiscard]] double zFar() const { return _zfar; }
+    // Maps camera space to the screen space: (x, y) in pixels after division by w (w is the depth in camera space)
+    [[nodiscard]] const Matrix4x4& screenSpaceProjection() const { return _SP; }
 };
 
 
@@ -67,7 +67,7 @@ bool Group::remove(const ObjectTag &tag) {
         }
     }
 
-    Log::log("Group::remove(): cannot remove '" + tag.str() + "' from the group '" + name().str() + "': there are no such object");
+    LOG_WARNING("Group::remove(): cannot remove '" + tag.str() + "' from the group '" + name().str() + "': there are no such object");
     return false;
 }
 
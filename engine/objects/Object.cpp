@@ -3,6 +3,10 @@
 #include <linalg/Matrix4x4.h>
 #include <objects/Object.h>
 #include <components/Component.h>
+#include <components/TransformMatrix.h>
+#include <components/geometry/TriangleMesh.h>
+#include <components/geometry/LineMesh.h>
+#include <components/geometry/MeshInstances.h>
 #include <utils/Time.h>
 
 Object::Object(const ObjectTag &tag) : _tag(tag) {
@@ -57,6 +61,7 @@ void Object::attach(std::shared_ptr<Object> object) {
             if (!object->checkIfAttached(this)) {
                 _attached.emplace(object->name(), object);
                 object->_attachedTo = this;
+                invalidateBounds();
             } else {
                 throw std::invalid_argument{"Object::attach(): You created recursive attachment"};
             }
@@ -80,6 +85,7 @@ void Object::unattach(const ObjectTag &tag) {
         _attached[tag]->_attachedTo = nullptr;
     }
     _attached.erase(tag);
+    invalidateBounds();
 }
 
 void Object::unattachAll() {
@@ -95,6 +101,7 @@ void Object::unattachAll() {
         it = _attached.erase(it);
     }
     _attached.clear();
+    invalidateBounds();
 }
 
 Object::~Object() {
@@ -106,6 +113,64 @@ Object::~Object() {
     unattachAll();
 }
 
+void Object::invalidateBounds() {
+    // If an object is outdated, all the objects above it are outdated as well, so we can stop there
+    for (Object* object = this; object && !object->_boundsDirty; object = object->_attachedTo) {
+        object->_boundsDirty = true;
+    }
+}
+
+void Object::updateSubtreeBounds() {
+    std::optional<Bounds> bounds;
+    bool bounded = true;
+    auto add = [&bounds](const Bounds& other) {
+        bounds = bounds ? bounds->merged(other) : other;
+    };
+
+    if (auto triangleMesh = getComponent<TriangleMesh>()) {
+        auto instances = getComponent<MeshInstances>();
+        if (!instances) {
+            add(triangleMesh->bounds());
+        } else if (auto instancesBounds = instances->bounds(triangleMesh->bounds())) {
+            add(*instancesBounds);
+        }
+    }
+    if (auto lineMesh = getComponent<LineMesh>()) {
+        add(lineMesh->bounds());
+    }
+
+    for (const auto& [tag, object] : _attached) {
+        auto objectBounds = object->subtreeBounds();
+        bounded &= object->isSubtreeBounded();
+
+        auto transformMatrix = object->getComponent<TransformMatrix>();
+        if (!transformMatrix) {
+            bounded &= object->numberOfAttached() == 0;
+        }
+        if (objectBounds) {
+            add(transformMatrix ? *objectBounds * transformMatrix->model() : *objectBounds);
+        }
+    }
+
+    _subtreeBounds = bounds;
+    _subtreeBounded = bounded;
+    _boundsDirty = false;
+}
+
+std::optional<Bounds> Object::subtreeBounds() {
+    if (_boundsDirty) {
+        updateSubtreeBounds();
+    }
+    return _subtreeBounds;
+}
+
+bool Object::isSubtreeBounded() {
+    if (_boundsDirty) {
+        updateSubtreeBounds();
+    }
+    return _subtreeBounded;
+}
+
 void Object::updateComponents() {
     double deltaTime = Time::time() - _lastUpdate;
     _lastUpdate = Time::time();
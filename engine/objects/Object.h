@@ -7,9 +7,11 @@
 #include <utility>
 #include <memory>
 #include <chrono>
+#include <optional>
 
 #include <components/props/Color.h>
 #include <components/geometry/Triangle.h>
+#include <components/geometry/Bounds.h>
 #include <linalg/Matrix4x4.h>
 #include <linalg/Vec3D.h>
 #include <Consts.h>
@@ -49,6 +51,13 @@ private:
     // fix fixed time updates
     double _lag = 0;
     double _lastUpdate = 0;
+
+    // Cache of subtreeBounds()
+    std::optional<Bounds> _subtreeBounds;
+    bool _subtreeBounded = true;
+    bool _boundsDirty = true;
+
+    void updateSubtreeBounds();
 protected:
     std::map<ObjectTag, std::shared_ptr<Object>> _attached;
     std::vector<std::shared_ptr<Component>> _components;
@@ -84,6 +93,7 @@ public:
         component->assignTo(this);
         _components.emplace_back(component);
         component->start();
+        invalidateBounds();
         return component;
     }
 
@@ -110,6 +120,21 @@ public:
 
     void updateComponents();
 
+    /*
+     * Bounds of the meshes of the object and of all the objects attached to it, in the coordinates of the object
+     * (multiply them by the full model matrix of the object to get the world space). std::nullopt means that
+     * there is no geometry in the subtree. The bounds are cached: changes of transforms, meshes and attachments
+     * invalidate the cache of the objects above them (see invalidateBounds()), so only those are recalculated.
+     */
+    [[nodiscard]] std::optional<Bounds> subtreeBounds();
+    /*
+     * False when an object of the subtree has no TransformMatrix but has attached objects: the objects attached to it
+     * do not follow the transforms above them (see TransformMatrix::fullModel()), so subtreeBounds() cannot cover them.
+     */
+    [[nodiscard]] bool isSubtreeBounded();
+    // Marks the cached bounds of the object and of all the objects above it as outdated
+    void invalidateBounds();
+
     std::map<ObjectTag, std::shared_ptr<Object>>::iterator begin() { return _attached.begin(); }
     std::map<ObjectTag, std::shared_ptr<Object>>::iterator end() { return _attached.end(); }
     std::map<ObjectTag, std::shared_ptr<Object>>::const_iterator begin() const { return _attached.begin(); }
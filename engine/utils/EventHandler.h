@@ -71,8 +71,9 @@ public:
             }
         }
 
-        Log::log("EventHandler::call(): event <" + event.str()
-                 + "> happened (" + std::to_string(_instance->_callBacks[event].size()) + " listeners)");
+        LOG_DEBUG("EventHandler::call(): event <" + event.str() + "> happened (" +
+                  std::to_string(functionListIterator != _instance->_callBacks.end() ?
+                                 functionListIterator->second.size() : 0) + " listeners)");
     }
 
     template<typename Argtype>
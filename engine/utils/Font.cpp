@@ -21,7 +21,7 @@ TTF_Font* Font::getFont(uint16_t fontSize) {
     TTF_Font* font = TTF_OpenFont(_fileName.str().c_str(), fontSize);
     // Confirm that it was loaded
     if(!font){
-        Log::log("Font::getFont(): Could not load font " + _fileName.str());
+        LOG_ERROR("Font::getFont(): Could not load font " + _fileName.str());
         return nullptr;
     }
     _fonts.insert({fontSize,font});
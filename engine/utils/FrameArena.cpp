@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include <utils/FrameArena.h>
+
+void FrameArena::addBlock(size_t size) {
+    // The memory is not zeroed: it is overwritten by every frame anyway
+    _blocks.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+    while (true) {
+        if (_block < _blocks.size()) {
+            auto& block = _blocks[_block];
+            auto base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t aligned = ((base + _offset + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+
+            if (aligned + bytes <= block.size) {
+                _used += aligned + bytes - _offset;
+                _offset = aligned + bytes;
+                return block.data.get() + aligned;
+            }
+            if (_block + 1 < _blocks.size()) {
+                _block++;
+                _offset = 0;
+                continue;
+            }
+        }
+
+        // Big requests get a block of their own size
+        addBlock(std::max(_blockSize, bytes + alignment));
+        _block = _blocks.size() - 1;
+        _offset = 0;
+    }
+}
+
+void FrameArena::reset() {
+    // If the frame needed several blocks, they are replaced by one big block for the next frames
+    if (_blocks.size() > 1) {
+        size_t total = capacity();
+        _blocks.clear();
+        addBlock(total);
+    }
+    _block = 0;
+    _offset = 0;
+    _used = 0;
+}
+
+size_t FrameArena::capacity() const {
+    size_t total = 0;
+    for (const auto& block : _blocks) {
+        total += block.size;
+    }
+    return total;
+}
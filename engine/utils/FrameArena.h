@@ -0,0 +1,94 @@
+#ifndef UTILS_FRAMEARENA_H
+#define UTILS_FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <ScalarConsts.h>
+
+/*
+ * Linear (bump) allocator for the data which lives for one frame: allocation is an increment of the offset,
+ * nothing is freed separately, reset() frees everything at once. Memory blocks are kept between frames,
+ * so in the steady state the frame does not touch the heap at all. Not thread-safe.
+ */
+class FrameArena final {
+private:
+    struct Block final {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> _blocks;
+    size_t _block = 0;  // the block we allocate from
+    size_t _offset = 0; // in the current block
+    size_t _used = 0;   // bytes allocated since the last reset() (with padding)
+    size_t _blockSize;
+
+    void addBlock(size_t size);
+public:
+    explicit FrameArena(size_t blockSize = Consts::FRAME_ARENA_BLOCK_SIZE) : _blockSize(blockSize) {}
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    [[nodiscard]] void* allocate(size_t bytes, size_t alignment);
+
+    // Frees everything allocated since the previous reset(): all the pointers into the arena become invalid
+    void reset();
+
+    [[nodiscard]] size_t used() const { return _used; }
+    [[nodiscard]] size_t capacity() const;
+};
+
+/*
+ * STL allocator on top of FrameArena: std::vector<T, ArenaAllocator<T>> is an arena-backed list.
+ * deallocate() does nothing, the memory comes back with FrameArena::reset().
+ * A default constructed allocator (without an arena) uses the heap as std::allocator does.
+ */
+template<typename T>
+class ArenaAllocator {
+private:
+    FrameArena* _arena = nullptr;
+
+    template<typename U>
+    friend class ArenaAllocator;
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() = default;
+    explicit ArenaAllocator(FrameArena* arena) : _arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other._arena) {}
+
+    [[nodiscard]] T* allocate(size_t n) {
+        if (_arena) {
+            return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        if (!_arena) {
+            std::allocator<T>().deallocate(ptr, n);
+        }
+    }
+
+    [[nodiscard]] FrameArena* arena() const { return _arena; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return _arena == other._arena; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return _arena != other._arena; }
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif //UTILS_FRAMEARENA_H
@@ -1,23 +1,284 @@
 #define _CRT_SECURE_NO_WARNINGS
 
+#include <chrono>
+#include <cstdlib>
 #include <ctime>
 #include <iomanip>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 #include <utils/Time.h>
 #include <utils/Log.h>
 #include <Consts.h>
 #include <utils/monitoring.h>
 
+namespace {
+    constexpr auto WRITER_PERIOD = std::chrono::milliseconds(10);
+    constexpr auto MEMORY_SAMPLE_PERIOD = std::chrono::seconds(1);
+
+    struct Record final {
+        std::chrono::system_clock::time_point time;
+        Log::Level level = Log::Level::Info;
+        unsigned int fps = 0;
+        std::string message;
+    };
+
+    /*
+     * Bounded lock-free queue with many producers and one consumer.
+     * The sequence number of a cell tells whose turn it is: the producer of the position 'pos' waits for pos,
+     * the consumer waits for pos + 1, and gives the cell back to the producers of the next round (pos + CAPACITY).
+     */
+    class LogQueue final {
+    public:
+        static constexpr size_t CAPACITY = 1 << 12;
+    private:
+        struct Cell final {
+            std::atomic<size_t> sequence = 0;
+            Record record;
+        };
+
+        std::unique_ptr<Cell[]> _cells = std::make_unique<Cell[]>(CAPACITY);
+        alignas(64) std::atomic<size_t> _pushPos = 0;
+        alignas(64) size_t _popPos = 0;
+    public:
+        LogQueue() {
+            for (size_t i = 0; i < CAPACITY; i++) {
+                _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // Returns false if the queue is full
+        bool push(Record &&record) {
+            size_t pos = _pushPos.load(std::memory_order_relaxed);
+            while (true) {
+                Cell &cell = _cells[pos % CAPACITY];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+                if (diff == 0) {
+                    if (_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.record = std::move(record);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = _pushPos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Only the writer thread pops
+        bool pop(Record &record) {
+            Cell &cell = _cells[_popPos % CAPACITY];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence != _popPos + 1) {
+                return false;
+            }
+            record = std::move(cell.record);
+            cell.sequence.store(_popPos + CAPACITY, std::memory_order_release);
+            _popPos++;
+            return true;
+        }
+
+        [[nodiscard]] size_t pushed() const { return _pushPos.load(std::memory_order_acquire); }
+    };
+
+    const char *levelName(Log::Level level) {
+        switch (level) {
+            case Log::Level::Debug:
+                return "DEBUG";
+            case Log::Level::Info:
+                return "INFO";
+            case Log::Level::Warning:
+                return "WARNING";
+            case Log::Level::Error:
+                return "ERROR";
+        }
+        return "";
+    }
+
+    class Logger final {
+    private:
+        LogQueue _queue;
+        std::atomic<Log::Level> _level = Log::Level::Debug;
+        std::atomic<size_t> _written = 0;
+        std::atomic<uint64_t> _dropped = 0;
+        std::atomic<bool> _running = true;
+
+        // Used by the writer thread only (and by log() after the writer is stopped)
+        std::ofstream _file;
+        int _memoryMB = -1;
+        std::chrono::steady_clock::time_point _lastMemorySample;
+        std::mutex _writeMutex;
+
+        std::thread _writer;
+
+        void write(const Record &record) {
+            auto now = std::chrono::steady_clock::now();
+            if (_memoryMB < 0 || now - _lastMemorySample > MEMORY_SAMPLE_PERIOD) {
+                _memoryMB = getProcessSizeMB();
+                _lastMemorySample = now;
+            }
+
+            std::time_t time = std::chrono::system_clock::to_time_t(record.time);
+            std::tm localTime{};
+#if defined(_WIN32) || defined(_WIN64)
+            localtime_s(&localTime, &time);
+#else
+            localtime_r(&time, &localTime);
+#endif
+            std::ostringstream line;
+            line << std::put_time(&localTime, "%F %T") << " | Mem: " << _memoryMB << "MB " << "\t"
+                 << levelName(record.level) << " " << record.message << " (" << record.fps << " fps)\n";
+
+            _file << line.str();
+            std::cout << line.str();
+        }
+
+        void run() {
+            Record record;
+            while (true) {
+                // Messages pushed before the stop are still written
+                bool running = _running.load(std::memory_order_acquire);
+
+                size_t written = 0;
+                {
+                    std::lock_guard<std::mutex> lock(_writeMutex);
+                    while (_queue.pop(record)) {
+                        write(record);
+                        written++;
+                    }
+                    uint64_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+                    if (dropped > 0) {
+                        write({std::chrono::system_clock::now(), Log::Level::Warning, 0,
+                               "Log: " + std::to_string(dropped) + " messages were dropped (the queue is full)"});
+                    }
+                    if (written > 0 || dropped > 0) {
+                        _file.flush();
+                        std::cout.flush();
+                    }
+                }
+                _written.fetch_add(written, std::memory_order_release);
+
+                if (!running) {
+                    return;
+                }
+                if (written == 0) {
+                    std::this_thread::sleep_for(WRITER_PERIOD);
+                }
+            }
+        }
+    public:
+        Logger() : _file("engine.log", std::ios::out | std::ios::app) {
+            _writer = std::thread(&Logger::run, this);
+        }
+
+        void log(Log::Level level, std::string &&message) {
+            Record record{std::chrono::system_clock::now(), level, Time::fps(), std::move(message)};
+
+            if (!_running.load(std::memory_order_acquire)) {
+                // The writer is stopped at exit: the message is written immediately
+                std::lock_guard<std::mutex> lock(_writeMutex);
+                write(record);
+                _file.flush();
+                std::cout.flush();
+                return;
+            }
+
+            if (!_queue.push(std::move(record))) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void setLevel(Log::Level level) { _level.store(level, std::memory_order_relaxed); }
+        [[nodiscard]] bool isEnabled(Log::Level level) const { return level >= _level.load(std::memory_order_relaxed); }
+
+        void flush() {
+            size_t pushed = _queue.pushed();
+            while (_running.load(std::memory_order_acquire) && _written.load(std::memory_order_acquire) < pushed) {
+                std::this_thread::yield();
+            }
+        }
+
+        void stop() {
+            _running.store(false, std::memory_order_release);
+            if (_writer.joinable()) {
+                _writer.join();
+            }
+
+            // Messages pushed while the writer was finishing
+            std::lock_guard<std::mutex> lock(_writeMutex);
+            Record record;
+            while (_queue.pop(record)) {
+                write(record);
+            }
+            _file.flush();
+            std::cout.flush();
+        }
+    };
+
+    // The logger is never destroyed: it can be used by the destructors of the other static objects
+    Logger &logger() {
+        static Logger *instance = [] {
+            auto created = new Logger();
+            std::atexit([] { logger().stop(); });
+            return created;
+        }();
+        return *instance;
+    }
+}
+
 namespace Log {
+    void log(Level level, std::string message) {
+        if (Consts::USE_LOG_FILE && logger().isEnabled(level)) {
+            logger().log(level, std::move(message));
+        }
+    }
+
     void log(const std::string &message) {
+        log(Level::Info, message);
+    }
+
+    void setLevel(Level level) {
+        logger().setLevel(level);
+    }
+
+    bool isEnabled(Level level) {
+        return Consts::USE_LOG_FILE && logger().isEnabled(level);
+    }
+
+    void flush() {
         if (Consts::USE_LOG_FILE) {
-            auto dt = Time::getLocalTimeInfo();
-            std::fstream file("engine.log", std::ios::out | std::ios::app);
-            file << dt << " | Mem: " << getProcessSizeMB() << "MB " << "\t" << message << " (" << Time::fps() << " fps)" << std::endl;
-            std::cout << dt << " | Mem: " << getProcessSizeMB() << "MB " << "\t" << message << " (" << Time::fps() << " fps)" << std::endl;
-            file.close();
+            logger().flush();
+        }
+    }
+
+    bool RateLimit::allow(uint32_t &suppressed) {
+        int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        int64_t last = _second.load(std::memory_order_relaxed);
+        if (last != second && _second.compare_exchange_strong(last, second, std::memory_order_relaxed)) {
+            _messages.store(0, std::memory_order_relaxed);
+        }
+
+        if (_messages.fetch_add(1, std::memory_order_relaxed) < MAX_MESSAGES) {
+            suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+        _suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    std::string withSuppressed(std::string message, uint32_t suppressed) {
+        if (suppressed > 0) {
+            message += " (" + std::to_string(suppressed) + " similar messages were suppressed)";
         }
+        return message;
     }
 }
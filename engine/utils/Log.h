@@ -1,11 +1,98 @@
 #ifndef UTILS_LOG_H
 #define UTILS_LOG_H
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 
+/*
+ * Asynchronous logger.
+ *
+ * Log::log() only puts the message into a lock-free queue, a background thread writes the queue
+ * into engine.log and the standard output. The memory usage printed with every line is sampled
+ * by the writer once per second. When the queue is full the messages are dropped and counted.
+ *
+ * Usage:
+ *     LOG_DEBUG("Camera::init(): camera successfully initialized.");
+ *     LOG_ERROR("ResourceManager::loadObjects(): cannot open '" + file.str() + "'");
+ *
+ * LOG_* macros do not build the message when the level is off, limit the number of messages
+ * from one call site per second (see RateLimit), and are removed from the build completely
+ * for the levels below LOG_MIN_LEVEL (cmake -DLOG_MIN_LEVEL=1 removes debug messages).
+ */
+
+// 0 - debug, 1 - info, 2 - warning, 3 - error
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
 namespace Log {
+    enum class Level : uint8_t {
+        Debug = 0,
+        Info = 1,
+        Warning = 2,
+        Error = 3
+    };
+
+    void log(Level level, std::string message);
+    // Info message
     void log(const std::string &message);
-};
 
+    // Messages below the level are dropped at runtime
+    void setLevel(Level level);
+    [[nodiscard]] bool isEnabled(Level level);
+
+    // Blocks until all the messages logged so far are written
+    void flush();
+
+    /*
+     * At most MAX_MESSAGES messages per second from one call site are allowed,
+     * the number of the dropped ones is reported with the next allowed message.
+     */
+    class RateLimit final {
+    public:
+        static constexpr uint32_t MAX_MESSAGES = 10;
+    private:
+        std::atomic<int64_t> _second = 0;
+        std::atomic<uint32_t> _messages = 0;
+        std::atomic<uint32_t> _suppressed = 0;
+    public:
+        // suppressed is set to the number of messages dropped since the last allowed one
+        bool allow(uint32_t &suppressed);
+    };
+
+    std::string withSuppressed(std::string message, uint32_t suppressed);
+}
+
+#define LOG_MESSAGE(level, message)                                                    \
+    do {                                                                               \
+        if (Log::isEnabled(level)) {                                                   \
+            static Log::RateLimit _logRateLimit;                                       \
+            uint32_t _logSuppressed = 0;                                               \
+            if (_logRateLimit.allow(_logSuppressed)) {                                 \
+                Log::log(level, Log::withSuppressed((message), _logSuppressed));         \
+            }                                                                          \
+        }                                                                              \
+    } while (false)
+
+#if LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(message) LOG_MESSAGE(Log::Level::Debug, message)
+#else
+#define LOG_DEBUG(message) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= 1
+#define LOG_INFO(message) LOG_MESSAGE(Log::Level::Info, message)
+#else
+#define LOG_INFO(message) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= 2
+#define LOG_WARNING(message) LOG_MESSAGE(Log::Level::Warning, message)
+#else
+#define LOG_WARNING(message) ((void)0)
+#endif
+
+#define LOG_ERROR(message) LOG_MESSAGE(Log::Level::Error, message)
 
 #endif //UTILS_LOG_H
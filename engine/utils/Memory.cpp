@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <utils/Memory.h>
+
+std::array<MemoryTagStats, Memory::TAGS> Memory::_lastFrame{};
+
+namespace {
+    // Atomics with static storage are zero-initialized before any allocation can happen
+    std::array<std::atomic<int64_t>, Memory::TAGS> bytes;
+    std::array<std::atomic<int64_t>, Memory::TAGS> blocks;
+    std::array<std::atomic<uint64_t>, Memory::TAGS> totalAllocations;
+    std::array<std::atomic<uint64_t>, Memory::TAGS> totalBytes;
+
+    thread_local MemoryTag currentMemoryTag = MemoryTag::Other;
+
+    constexpr std::array<const char*, Memory::TAGS> TAG_NAMES = {
+            "other", "meshes", "textures", "physics", "draw lists", "animation", "gui"
+    };
+    // Profiler counters of the memory used by every tag
+    constexpr std::array<const char*, Memory::TAGS> HEAP_COUNTER_NAMES = {
+            "heap KB: other", "heap KB: meshes", "heap KB: textures", "heap KB: physics",
+            "heap KB: draw lists", "heap KB: animation", "heap KB: gui"
+    };
+}
+
+const char *Memory::tagName(MemoryTag tag) {
+    return TAG_NAMES[static_cast<size_t>(tag)];
+}
+
+MemoryTag Memory::currentTag() {
+    return currentMemoryTag;
+}
+
+MemoryTag Memory::setCurrentTag(MemoryTag tag) {
+    MemoryTag previous = currentMemoryTag;
+    currentMemoryTag = tag;
+    return previous;
+}
+
+void Memory::recordAllocation(MemoryTag tag, size_t size) {
+    auto i = static_cast<size_t>(tag);
+    bytes[i].fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    blocks[i].fetch_add(1, std::memory_order_relaxed);
+    totalAllocations[i].fetch_add(1, std::memory_order_relaxed);
+    totalBytes[i].fetch_add(size, std::memory_order_relaxed);
+}
+
+void Memory::recordFree(MemoryTag tag, size_t size) {
+    auto i = static_cast<size_t>(tag);
+    bytes[i].fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+    blocks[i].fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Memory::endFrame() {
+    if (!TRACKING) {
+        return;
+    }
+
+    static std::array<uint64_t, TAGS> previousAllocations{};
+    static std::array<uint64_t, TAGS> previousBytes{};
+    static const std::array<ProfileZoneId, TAGS> heapCounters = [] {
+        std::array<ProfileZoneId, TAGS> counters{};
+        for (size_t i = 0; i < TAGS; i++) {
+            counters[i] = Profiler::registerCounter(HEAP_COUNTER_NAMES[i]);
+        }
+        return counters;
+    }();
+
+    for (size_t i = 0; i < TAGS; i++) {
+        uint64_t allocations = totalAllocations[i].load(std::memory_order_relaxed);
+        uint64_t allocatedBytes = totalBytes[i].load(std::memory_order_relaxed);
+
+        auto& stats = _lastFrame[i];
+        stats.bytes = bytes[i].load(std::memory_order_relaxed);
+        stats.blocks = blocks[i].load(std::memory_order_relaxed);
+        stats.frameAllocations = allocations - previousAllocations[i];
+        stats.frameBytes = allocatedBytes - previousBytes[i];
+
+        previousAllocations[i] = allocations;
+        previousBytes[i] = allocatedBytes;
+
+        Profiler::count(heapCounters[i], stats.bytes / 1024);
+    }
+
+    PROFILE_COUNT("allocations", static_cast<int64_t>(lastFrameAllocations()));
+    PROFILE_COUNT("allocated bytes", static_cast<int64_t>(lastFrameBytes()));
+}
+
+uint64_t Memory::lastFrameAllocations() {
+    uint64_t allocations = 0;
+    for (const auto& stats : _lastFrame) {
+        allocations += stats.frameAllocations;
+    }
+    return allocations;
+}
+
+uint64_t Memory::lastFrameBytes() {
+    uint64_t allocatedBytes = 0;
+    for (const auto& stats : _lastFrame) {
+        allocatedBytes += stats.frameBytes;
+    }
+    return allocatedBytes;
+}
+
+#ifdef TRACK_ALLOCATIONS
+
+/*
+ * Every block starts with a header which tells how big the block is and which tag it belongs to.
+ * The user memory follows the header; for over-aligned allocations there can be a gap before the header.
+ */
+namespace {
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) AllocationHeader final {
+        size_t size;
+        uint32_t offset; // from the start of the malloc() block to the user memory
+        MemoryTag tag;
+    };
+
+    void* trackedAllocate(size_t size, size_t alignment) {
+        alignment = std::max(alignment, alignof(AllocationHeader));
+        size_t extra = sizeof(AllocationHeader) + alignment - alignof(AllocationHeader);
+
+        while (true) {
+            void *block = std::malloc(size + extra);
+            if (block) {
+                auto start = reinterpret_cast<uintptr_t>(block);
+                uintptr_t user = (start + sizeof(AllocationHeader) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+
+                MemoryTag tag = Memory::currentTag();
+                auto header = reinterpret_cast<AllocationHeader*>(user) - 1;
+                header->size = size;
+                header->offset = static_cast<uint32_t>(user - start);
+                header->tag = tag;
+
+                Memory::recordAllocation(tag, size);
+                return reinterpret_cast<void*>(user);
+            }
+
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) {
+                return nullptr;
+            }
+            handler();
+        }
+    }
+
+    void trackedFree(void *ptr) {
+        if (!ptr) {
+            return;
+        }
+        auto header = static_cast<AllocationHeader*>(ptr) - 1;
+        Memory::recordFree(header->tag, header->size);
+        std::free(static_cast<char*>(ptr) - header->offset);
+    }
+
+    void* allocateOrThrow(size_t size, size_t alignment) {
+        void *ptr = trackedAllocate(size, alignment);
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+}
+
+void* operator new(size_t size) { return allocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[](size_t size) { return allocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<size_t>(alignment)); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+
+#endif
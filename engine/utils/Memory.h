@@ -0,0 +1,97 @@
+#ifndef UTILS_MEMORY_H
+#define UTILS_MEMORY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <utils/Profiler.h>
+
+/*
+ * Heap accounting by subsystems.
+ *
+ * Tracking is opt-in (cmake -DTRACK_ALLOCATIONS=ON): then the global operator new/delete count every
+ * allocation and its bytes for the memory tag of the calling thread. The tag is set for the rest of the scope:
+ *     MEMORY_TAG(Physics);
+ * Nested tags override the outer ones, allocations outside of any tag are counted as Other.
+ * A block is always freed from the tag it was allocated by.
+ *
+ * Memory::endFrame() (called by Engine every frame) takes the allocations of the frame
+ * and adds them to the profiler counters, so they are in the debug info and in the profiler captures.
+ * Without TRACK_ALLOCATIONS the tags compile to nothing and all the stats are zero.
+ */
+
+enum class MemoryTag : uint8_t {
+    Other = 0,
+    Meshes,
+    Textures,
+    Physics,
+    DrawLists,
+    Animation,
+    GUI,
+    Count
+};
+
+struct MemoryTagStats final {
+    // Currently allocated
+    int64_t bytes = 0;
+    int64_t blocks = 0;
+    // Allocated during the last frame
+    uint64_t frameAllocations = 0;
+    uint64_t frameBytes = 0;
+};
+
+class Memory final {
+public:
+    static constexpr size_t TAGS = static_cast<size_t>(MemoryTag::Count);
+#ifdef TRACK_ALLOCATIONS
+    static constexpr bool TRACKING = true;
+#else
+    static constexpr bool TRACKING = false;
+#endif
+private:
+    static std::array<MemoryTagStats, TAGS> _lastFrame;
+public:
+    Memory() = delete;
+
+    [[nodiscard]] static const char* tagName(MemoryTag tag);
+
+    [[nodiscard]] static MemoryTag currentTag();
+    // Returns the previous tag of the thread
+    static MemoryTag setCurrentTag(MemoryTag tag);
+
+    // Used by the tracking operator new/delete
+    static void recordAllocation(MemoryTag tag, size_t bytes);
+    static void recordFree(MemoryTag tag, size_t bytes);
+
+    /*
+     * Takes the allocations since the previous call as the allocations of the frame
+     * and adds them to the profiler counters. Should be called before Profiler::endFrame().
+     */
+    static void endFrame();
+
+    [[nodiscard]] static const MemoryTagStats& lastFrame(MemoryTag tag) {
+        return _lastFrame[static_cast<size_t>(tag)];
+    }
+    [[nodiscard]] static uint64_t lastFrameAllocations();
+    [[nodiscard]] static uint64_t lastFrameBytes();
+};
+
+class MemoryScope final {
+private:
+    MemoryTag _previous;
+public:
+    explicit MemoryScope(MemoryTag tag) : _previous(Memory::setCurrentTag(tag)) {}
+    ~MemoryScope() { Memory::setCurrentTag(_previous); }
+
+    MemoryScope(const MemoryScope &) = delete;
+    MemoryScope &operator=(const MemoryScope &) = delete;
+};
+
+#ifdef TRACK_ALLOCATIONS
+#define MEMORY_TAG(tag) MemoryScope PROFILE_CONCAT(_memoryScope, __LINE__)(MemoryTag::tag)
+#else
+#define MEMORY_TAG(tag) ((void)0)
+#endif
+
+#endif //UTILS_MEMORY_H
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <map>
+#include <queue>
+
+#include <utils/MeshSimplifier.h>
+
+namespace {
+    // The planes along the borders of open meshes weigh more than the planes of the triangles
+    constexpr double BORDER_WEIGHT = 100;
+
+    // Sum of the squared distances to a set of planes: symmetric 4x4 matrix (a^2, ab, ac, ad, b^2, bc, bd, c^2, cd, d^2)
+    struct Quadric final {
+        std::array<double, 10> q{};
+
+        Quadric() = default;
+        // Plane n*x + d = 0 (n is normalized)
+        Quadric(const Vec3D &n, double d, double weight) {
+            double a = n.x(), b = n.y(), c = n.z();
+            q = {a*a, a*b, a*c, a*d, b*b, b*c, b*d, c*c, c*d, d*d};
+            for (auto& value : q) {
+                value *= weight;
+            }
+        }
+
+        Quadric& operator+=(const Quadric &other) {
+            for (size_t i = 0; i < q.size(); i++) {
+                q[i] += other.q[i];
+            }
+            return *this;
+        }
+
+        [[nodiscard]] double error(const Vec3D &v) const {
+            double x = v.x(), y = v.y(), z = v.z();
+            return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x +
+                   q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y +
+                   q[7]*z*z + 2*q[8]*z + q[9];
+        }
+    };
+
+    struct Face final {
+        std::array<uint32_t, 3> v;
+        bool removed = false;
+
+        [[nodiscard]] bool contains(uint32_t vertex) const {
+            return v[0] == vertex || v[1] == vertex || v[2] == vertex;
+        }
+    };
+
+    // Moves the vertex from into the vertex to
+    struct Collapse final {
+        double cost;
+        uint32_t from, to;
+        uint32_t fromVersion, toVersion;
+
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    Vec3D faceNormal(const std::vector<Vec3D> &positions, const std::array<uint32_t, 3> &v) {
+        return (positions[v[1]] - positions[v[0]]).cross(positions[v[2]] - positions[v[0]]);
+    }
+}
+
+std::vector<Triangle> simplifyMesh(const std::vector<Triangle> &triangles, size_t targetTriangles) {
+    if (triangles.size() <= targetTriangles) {
+        return triangles;
+    }
+
+    // Triangle soup -> indexed mesh: the same position with the same texture coordinates is the same vertex
+    std::vector<Vec3D> positions;
+    std::vector<Vec3D> uvs;
+    std::vector<Face> faces;
+    faces.reserve(triangles.size());
+    {
+        std::map<std::array<double, 5>, uint32_t> indices;
+        for (const auto& triangle : triangles) {
+            Face face{};
+            for (int i = 0; i < 3; i++) {
+                const Vec4D& p = triangle[i];
+                const Vec3D& uv = triangle.textureCoordinates()[i];
+                auto [it, inserted] = indices.try_emplace({p.x(), p.y(), p.z(), uv.x(), uv.y()},
+                                                          static_cast<uint32_t>(positions.size()));
+                if (inserted) {
+                    positions.emplace_back(p.x(), p.y(), p.z());
+                    uvs.push_back(uv);
+                }
+                face.v[i] = it->second;
+            }
+            if (face.v[0] != face.v[1] && face.v[1] != face.v[2] && face.v[0] != face.v[2]) {
+                faces.push_back(face);
+            }
+        }
+    }
+
+    size_t numVertices = positions.size();
+    std::vector<Quadric> quadrics(numVertices);
+    std::vector<std::vector<uint32_t>> vertexFaces(numVertices);
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> edgeFaces; // number of triangles of every edge
+
+    auto edgeKey = [](uint32_t a, uint32_t b) { return std::make_pair(std::min(a, b), std::max(a, b)); };
+
+    for (uint32_t f = 0; f < faces.size(); f++) {
+        const auto& v = faces[f].v;
+        Vec3D normal = faceNormal(positions, v);
+        double doubleArea = normal.abs();
+        for (int i = 0; i < 3; i++) {
+            vertexFaces[v[i]].push_back(f);
+            edgeFaces[edgeKey(v[i], v[(i + 1) % 3])]++;
+        }
+        if (doubleArea < Consts::EPS) {
+            continue;
+        }
+        normal /= doubleArea;
+        // Bigger triangles matter more
+        Quadric plane(normal, -normal.dot(positions[v[0]]), doubleArea / 2);
+        for (int i = 0; i < 3; i++) {
+            quadrics[v[i]] += plane;
+        }
+    }
+
+    // Border edges get a plane which goes through the edge perpendicular to the triangle
+    for (const auto& face : faces) {
+        Vec3D normal = faceNormal(positions, face.v);
+        if (normal.abs() < Consts::EPS) {
+            continue;
+        }
+        for (int i = 0; i < 3; i++) {
+            uint32_t a = face.v[i], b = face.v[(i + 1) % 3];
+            if (edgeFaces[edgeKey(a, b)] != 1) {
+                continue;
+            }
+            Vec3D edge = positions[b] - positions[a];
+            Vec3D borderNormal = edge.cross(normal);
+            if (borderNormal.abs() < Consts::EPS) {
+                continue;
+            }
+            borderNormal = borderNormal.normalized();
+            Quadric border(borderNormal, -borderNormal.dot(positions[a]), BORDER_WEIGHT * edge.sqrAbs());
+            quadrics[a] += border;
+            quadrics[b] += border;
+        }
+    }
+
+    // Collapses of a vertex are outdated when its version changes
+    std::vector<uint32_t> versions(numVertices, 0);
+    std::vector<bool> removed(numVertices, false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> queue;
+
+    auto addEdge = [&](uint32_t a, uint32_t b) {
+        Quadric sum = quadrics[a];
+        sum += quadrics[b];
+        queue.push({sum.error(positions[b]), a, b, versions[a], versions[b]});
+        queue.push({sum.error(positions[a]), b, a, versions[b], versions[a]});
+    };
+
+    for (const auto& [edge, count] : edgeFaces) {
+        addEdge(edge.first, edge.second);
+    }
+    edgeFaces.clear();
+
+    size_t liveFaces = faces.size();
+    std::vector<uint32_t> neighbours;
+
+    while (liveFaces > targetTriangles && !queue.empty()) {
+        Collapse collapse = queue.top();
+        queue.pop();
+
+        uint32_t from = collapse.from, to = collapse.to;
+        if (removed[from] || removed[to] || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) {
+            continue;
+        }
+
+        // The edge could disappear with the collapses around it; the triangles which keep the edge are removed,
+        // the rest of the triangles of the vertex should not turn over
+        bool hasEdge = false;
+        bool flips = false;
+        for (uint32_t f : vertexFaces[from]) {
+            const auto& face = faces[f];
+            if (face.removed) {
+                continue;
+            }
+            if (face.contains(to)) {
+                hasEdge = true;
+                continue;
+            }
+            // A face which is already degenerate has no side to turn over
+            Vec3D normal = faceNormal(positions, face.v);
+            if (normal.sqrAbs() <= Consts::EPS) {
+                continue;
+            }
+            auto moved = face.v;
+            std::replace(moved.begin(), moved.end(), from, to);
+            if (faceNormal(positions, moved).dot(normal) <= 0) {
+                flips = true;
+                break;
+            }
+        }
+        if (!hasEdge || flips) {
+            continue;
+        }
+
+        for (uint32_t f : vertexFaces[from]) {
+            auto& face = faces[f];
+            if (face.removed) {
+                continue;
+            }
+            if (face.contains(to)) {
+                face.removed = true;
+                liveFaces--;
+            } else {
+                std::replace(face.v.begin(), face.v.end(), from, to);
+                vertexFaces[to].push_back(f);
+            }
+        }
+        removed[from] = true;
+        vertexFaces[from].clear();
+        quadrics[to] += quadrics[from];
+        versions[to]++;
+
+        std::erase_if(vertexFaces[to], [&faces](uint32_t f) { return faces[f].removed; });
+
+        // The cost of every edge of the vertex has changed
+        neighbours.clear();
+        for (uint32_t f : vertexFaces[to]) {
+            for (uint32_t v : faces[f].v) {
+                if (v != to) {
+                    neighbours.push_back(v);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (uint32_t v : neighbours) {
+            addEdge(to, v);
+        }
+    }
+
+    std::vector<Triangle> result;
+    result.reserve(liveFaces);
+    for (const auto& face : faces) {
+        if (face.removed) {
+            continue;
+        }
+        std::array<Vec4D, 3> points;
+        std::array<Vec3D, 3> uv;
+        for (int i = 0; i < 3; i++) {
+            const Vec3D& p = positions[face.v[i]];
+            points[i] = Vec4D(p.x(), p.y(), p.z(), 1.0);
+            uv[i] = uvs[face.v[i]];
+        }
+        result.emplace_back(points, uv);
+    }
+    return result;
+}
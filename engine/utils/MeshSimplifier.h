@@ -0,0 +1,20 @@
+#ifndef UTILS_MESHSIMPLIFIER_H
+#define UTILS_MESHSIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <components/geometry/Triangle.h>
+
+/*
+ * Simplification of a triangle soup by edge collapses with the quadric error metric (Garland & Heckbert):
+ * every vertex accumulates the planes of its triangles, the edge which moves its vertex the least away
+ * from those planes is collapsed first. Corners with the same position and texture coordinates are welded.
+ * A collapse moves one vertex into the other end of the edge, so the vertices keep valid texture coordinates.
+ * Edges with only one triangle (borders of open meshes and texture seams) are kept in place by extra planes,
+ * collapses which flip triangles are rejected.
+ * Returns at most targetTriangles triangles unless there is nothing left to collapse.
+ */
+[[nodiscard]] std::vector<Triangle> simplifyMesh(const std::vector<Triangle>& triangles, size_t targetTriangles);
+
+#endif //UTILS_MESHSIMPLIFIER_H
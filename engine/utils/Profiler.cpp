@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <utils/Profiler.h>
+#include <utils/Log.h>
+
+Profiler *Profiler::_instance = nullptr;
+std::atomic<uint32_t> Profiler::_generations = 0;
+std::mutex Profiler::_instanceMutex;
+
+/*
+ * Timeline of the current thread. It is returned to the profiler when the thread finishes.
+ * The generation tells if the timeline belongs to the current instance (Profiler can be re-initialized).
+ */
+struct ProfileThreadHandle final {
+    ProfileTimeline* timeline = nullptr;
+    uint32_t generation = 0;
+
+    ~ProfileThreadHandle() {
+        Profiler::releaseTimeline(generation, timeline);
+    }
+};
+
+static thread_local ProfileThreadHandle threadHandle;
+
+template<size_t N>
+uint16_t Profiler::Registry<N>::add(const char *name) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t n = size.load(std::memory_order_relaxed);
+    for (size_t i = 1; i < n; i++) {
+        if (std::strcmp(names[i], name) == 0) {
+            return static_cast<uint16_t>(i);
+        }
+    }
+
+    if (n == N) {
+        // All the extra names are measured together as the last one
+        return static_cast<uint16_t>(N - 1);
+    }
+
+    names[n] = name;
+    size.store(n + 1, std::memory_order_release);
+    return static_cast<uint16_t>(n);
+}
+
+Profiler::Registry<Profiler::MAX_ZONES>& Profiler::zones() {
+    static Registry<MAX_ZONES> zoneRegistry;
+    return zoneRegistry;
+}
+
+Profiler::Registry<Profiler::MAX_COUNTERS>& Profiler::counters() {
+    static Registry<MAX_COUNTERS> counterRegistry;
+    return counterRegistry;
+}
+
+void Profiler::init() {
+    if (_instance) {
+        Profiler::free();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_instanceMutex);
+        _instance = new Profiler(++_generations);
+        for (auto& enabled : _instance->_zoneEnabled) {
+            enabled.store(true, std::memory_order_relaxed);
+        }
+        for (auto& counter : _instance->_counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Log::log("Profiler::init(): profiler was initialized");
+}
+
+void Profiler::free() {
+    {
+        std::lock_guard<std::mutex> lock(_instanceMutex);
+        delete _instance;
+        _instance = nullptr;
+    }
+
+    Log::log("Profiler::free(): pointer to 'Profiler' was freed");
+}
+
+ProfileZoneId Profiler::registerZone(const char *name) {
+    return zones().add(name);
+}
+
+size_t Profiler::numberOfZones() {
+    return zones().size.load(std::memory_order_acquire);
+}
+
+const char *Profiler::zoneName(ProfileZoneId zone) {
+    if (zone == NO_ZONE || zone >= numberOfZones()) {
+        return "";
+    }
+    return zones().names[zone];
+}
+
+ProfileZoneId Profiler::registerCounter(const char *name) {
+    return counters().add(name);
+}
+
+size_t Profiler::numberOfCounters() {
+    return counters().size.load(std::memory_order_acquire);
+}
+
+const char *Profiler::counterName(ProfileZoneId counter) {
+    if (counter == 0 || counter >= numberOfCounters()) {
+        return "";
+    }
+    return counters().names[counter];
+}
+
+void Profiler::setEnabled(bool enabled) {
+    if (!_instance) {
+        return;
+    }
+    _instance->_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::isEnabled() {
+    if (!_instance) {
+        return false;
+    }
+    return _instance->_enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::setZoneEnabled(ProfileZoneId zone, bool enabled) {
+    if (!_instance || zone >= MAX_ZONES) {
+        return;
+    }
+    _instance->_zoneEnabled[zone].store(enabled, std::memory_order_relaxed);
+}
+
+ProfileTimeline* Profiler::threadTimeline() {
+    if (threadHandle.timeline && threadHandle.generation == _instance->_generation) {
+        return threadHandle.timeline;
+    }
+
+    std::lock_guard<std::mutex> lock(_instance->_timelinesMutex);
+
+    ProfileTimeline* timeline = nullptr;
+    for (auto& t : _instance->_timelines) {
+        if (!t->_inUse) {
+            timeline = t.get();
+            break;
+        }
+    }
+    if (!timeline) {
+        auto index = static_cast<uint32_t>(_instance->_timelines.size());
+        _instance->_timelines.emplace_back(std::make_unique<ProfileTimeline>(index, "thread " + std::to_string(index)));
+        timeline = _instance->_timelines.back().get();
+    }
+    timeline->_inUse = true;
+    timeline->_depth = 0;
+
+    threadHandle.timeline = timeline;
+    threadHandle.generation = _instance->_generation;
+    return timeline;
+}
+
+void Profiler::releaseTimeline(uint32_t generation, ProfileTimeline *timeline) {
+    // Threads finish whenever they want: the profiler must not be freed while the timeline is returned
+    std::lock_guard<std::mutex> instanceLock(_instanceMutex);
+    if (!_instance || !timeline || generation != _instance->_generation) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_instance->_timelinesMutex);
+    timeline->_inUse = false;
+}
+
+void Profiler::setThreadName(const std::string &name) {
+    if (!_instance) {
+        return;
+    }
+
+    auto timeline = threadTimeline();
+    std::lock_guard<std::mutex> lock(_instance->_timelinesMutex);
+    timeline->_name = name;
+}
+
+void Profiler::endFrame() {
+    if (!_instance) {
+        return;
+    }
+
+    auto& stats = _instance->_frameStats;
+    stats.assign(numberOfZones(), ProfileZoneStats());
+
+    {
+        std::lock_guard<std::mutex> lock(_instance->_timelinesMutex);
+        for (auto& timeline : _instance->_timelines) {
+            uint64_t written = timeline->written();
+            // Events older than CAPACITY are already overwritten
+            uint64_t first = std::max(timeline->_read, written > ProfileTimeline::CAPACITY ?
+                                                       written - ProfileTimeline::CAPACITY : 0);
+
+            for (uint64_t i = first; i < written; i++) {
+                const auto& event = timeline->event(i);
+                if (event.zone >= stats.size()) {
+                    continue;
+                }
+                auto& zoneStats = stats[event.zone];
+                zoneStats.seconds += static_cast<double>(event.end - event.start) * 1e-9;
+                zoneStats.calls++;
+                zoneStats.parent = event.parent;
+
+                if (_instance->_captureFrames > 0) {
+                    _instance->_capturedEvents.push_back({event, timeline->index()});
+                }
+            }
+            timeline->_read = written;
+        }
+    }
+
+    int64_t time = now();
+    size_t numCounters = numberOfCounters();
+    for (size_t i = 1; i < numCounters; i++) {
+        _instance->_lastFrameCounters[i] = _instance->_counters[i].exchange(0, std::memory_order_relaxed);
+        if (_instance->_captureFrames > 0) {
+            _instance->_capturedCounters.push_back({time, static_cast<ProfileZoneId>(i), _instance->_lastFrameCounters[i]});
+        }
+    }
+
+    std::swap(_instance->_frameStats, _instance->_lastFrameStats);
+    _instance->_frame.fetch_add(1, std::memory_order_relaxed);
+
+    if (_instance->_captureFrames > 0 && --_instance->_captureFrames == 0) {
+        writeCapture();
+    }
+}
+
+void Profiler::startCapture(uint32_t frames, const FilePath &file) {
+    if (!_instance || frames == 0) {
+        return;
+    }
+
+    _instance->_captureFrames = frames;
+    _instance->_captureFile = file;
+    _instance->_capturedEvents.clear();
+    _instance->_capturedCounters.clear();
+
+    // Memory for the capture is taken in advance, so recording does not change the timings much
+    _instance->_capturedEvents.reserve(frames * 256);
+    _instance->_capturedCounters.reserve(frames * MAX_COUNTERS);
+
+    Log::log("Profiler::startCapture(): capturing " + std::to_string(frames) + " frames to " + file.str());
+}
+
+void Profiler::stopCapture() {
+    if (!_instance || _instance->_captureFrames == 0) {
+        return;
+    }
+
+    _instance->_captureFrames = 0;
+    writeCapture();
+}
+
+bool Profiler::isCapturing() {
+    return _instance && _instance->_captureFrames > 0;
+}
+
+static std::string escapeJson(const std::string& str) {
+    std::string result;
+    result.reserve(str.size());
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            result += ' ';
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+void Profiler::writeCapture() {
+    std::ofstream out(_instance->_captureFile.str());
+    if (!out.is_open()) {
+        LOG_ERROR("Profiler::writeCapture(): cannot open " + _instance->_captureFile.str());
+        return;
+    }
+
+    // Timestamps of Trace Event format are in microseconds
+    out << std::fixed;
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    auto separator = [&first, &out]() {
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(_instance->_timelinesMutex);
+        for (const auto& timeline : _instance->_timelines) {
+            separator();
+            out << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << timeline->index()
+                << R"(,"args":{"name":")" << escapeJson(timeline->name()) << "\"}}";
+        }
+    }
+
+    for (const auto& [event, timeline] : _instance->_capturedEvents) {
+        separator();
+        out << R"({"name":")" << escapeJson(zoneName(event.zone)) << R"(","ph":"X","pid":1,"tid":)" << timeline
+            << ",\"ts\":" << static_cast<double>(event.start) * 1e-3
+            << ",\"dur\":" << static_cast<double>(event.end - event.start) * 1e-3
+            << ",\"args\":{\"frame\":" << event.frame << "}}";
+    }
+
+    for (const auto& [time, counter, value] : _instance->_capturedCounters) {
+        separator();
+        out << R"({"name":")" << escapeJson(counterName(counter)) << R"(","ph":"C","pid":1,"ts":)"
+            << static_cast<double>(time) * 1e-3 << ",\"args\":{\"value\":" << value << "}}";
+    }
+
+    out << "\n]}\n";
+
+    Log::log("Profiler::writeCapture(): " + std::to_string(_instance->_capturedEvents.size()) + " events were written to " +
+             _instance->_captureFile.str());
+
+    _instance->_capturedEvents.clear();
+    _instance->_capturedCounters.clear();
+}
+
+const std::vector<ProfileZoneStats>& Profiler::lastFrame() {
+    static const std::vector<ProfileZoneStats> empty;
+    if (!_instance) {
+        return empty;
+    }
+    return _instance->_lastFrameStats;
+}
+
+double Profiler::lastFrameSeconds(ProfileZoneId zone) {
+    const auto& stats = lastFrame();
+    if (zone >= stats.size()) {
+        return 0;
+    }
+    return stats[zone].seconds;
+}
+
+int64_t Profiler::lastFrameCounter(ProfileZoneId counter) {
+    if (!_instance || counter >= MAX_COUNTERS) {
+        return 0;
+    }
+    return _instance->_lastFrameCounters[counter];
+}
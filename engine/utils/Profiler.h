@@ -0,0 +1,281 @@
+#ifndef UTILS_PROFILER_H
+#define UTILS_PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <utils/FilePath.h>
+
+/*
+ * Hierarchical frame profiler.
+ *
+ * Zones are registered once at the start of the program (see ProfileZone), so entering a zone is only
+ * a clock read and a write into the ring buffer of the current thread: no strings, no maps and no allocations.
+ * Every thread gets its own timeline; timelines of finished threads are reused by the new ones,
+ * so short-lived worker threads (see utils/parallel.h) do not grow the profiler.
+ *
+ * Usage:
+ *     PROFILE_SCOPE("projections");   // measures the rest of the enclosing scope
+ *     PROFILE_COUNT("triangles projected", n);   // adds n to the counter of the current frame
+ *
+ * startCapture() records zones of every thread and counters for the next frames
+ * into a Chrome Trace Event JSON file (chrome://tracing, ui.perfetto.dev).
+ *
+ * Zones can be switched off at runtime (setEnabled(), setZoneEnabled()) or removed from the build
+ * completely with the DISABLE_PROFILER definition (cmake -DDISABLE_PROFILER=ON).
+ */
+
+using ProfileZoneId = uint16_t;
+
+struct ProfileEvent final {
+    int64_t start = 0; // nanoseconds since Profiler::init()
+    int64_t end = 0;
+    uint32_t frame = 0;
+    ProfileZoneId zone = 0;
+    ProfileZoneId parent = 0;
+    uint16_t depth = 0;
+};
+
+// Zone time of the last finished frame, summed over all threads
+struct ProfileZoneStats final {
+    double seconds = 0;
+    uint32_t calls = 0;
+    ProfileZoneId parent = 0;
+};
+
+/*
+ * Events of one thread. Only the owning thread writes into the ring,
+ * the frame owner (Profiler::endFrame()) reads everything up to written() once per frame.
+ */
+class ProfileTimeline final {
+public:
+    static constexpr size_t CAPACITY = 1 << 14;
+    static constexpr size_t MAX_DEPTH = 64;
+private:
+    std::unique_ptr<ProfileEvent[]> _events = std::make_unique<ProfileEvent[]>(CAPACITY);
+    std::atomic<uint64_t> _written = 0;
+    uint64_t _read = 0;
+
+    std::array<ProfileZoneId, MAX_DEPTH> _stack{};
+    uint16_t _depth = 0;
+
+    uint32_t _index;
+    std::string _name;
+    bool _inUse = true;
+
+    friend class Profiler;
+    friend class ProfileScope;
+public:
+    ProfileTimeline(uint32_t index, std::string name) : _index(index), _name(std::move(name)) {}
+
+    [[nodiscard]] uint32_t index() const { return _index; }
+    [[nodiscard]] const std::string& name() const { return _name; }
+    [[nodiscard]] uint64_t written() const { return _written.load(std::memory_order_acquire); }
+    // i-th event ever written (only the last CAPACITY events are kept)
+    [[nodiscard]] const ProfileEvent& event(uint64_t i) const { return _events[i % CAPACITY]; }
+};
+
+class Profiler final {
+public:
+    static constexpr size_t MAX_ZONES = 512;
+    static constexpr size_t MAX_COUNTERS = 64;
+    static constexpr ProfileZoneId NO_ZONE = 0; // the parent of the outermost zones of a thread
+private:
+    // Zones and counters are registered before main(), so their names are stored outside of the instance
+    template<size_t N>
+    struct Registry final {
+        std::array<const char*, N> names{};
+        std::atomic<size_t> size = 1; // 0 is NO_ZONE
+        std::mutex mutex;
+
+        uint16_t add(const char* name);
+    };
+    static Registry<MAX_ZONES>& zones();
+    static Registry<MAX_COUNTERS>& counters();
+
+    struct CapturedEvent final {
+        ProfileEvent event;
+        uint32_t timeline;
+    };
+
+    struct CounterSample final {
+        int64_t time;
+        ProfileZoneId counter;
+        int64_t value;
+    };
+
+    std::chrono::high_resolution_clock::time_point _start = std::chrono::high_resolution_clock::now();
+    std::atomic<bool> _enabled = true;
+    std::array<std::atomic<bool>, MAX_ZONES> _zoneEnabled;
+    std::atomic<uint32_t> _frame = 0;
+    uint32_t _generation;
+
+    std::mutex _timelinesMutex;
+    std::vector<std::unique_ptr<ProfileTimeline>> _timelines;
+
+    std::vector<ProfileZoneStats> _frameStats;
+    std::vector<ProfileZoneStats> _lastFrameStats;
+
+    std::array<std::atomic<int64_t>, MAX_COUNTERS> _counters;
+    std::array<int64_t, MAX_COUNTERS> _lastFrameCounters{};
+
+    uint32_t _captureFrames = 0;
+    FilePath _captureFile;
+    std::vector<CapturedEvent> _capturedEvents;
+    std::vector<CounterSample> _capturedCounters;
+
+    static Profiler *_instance;
+    static std::atomic<uint32_t> _generations;
+    // Guards the creation and the deletion of _instance against the threads which finish at the same time
+    static std::mutex _instanceMutex;
+
+    explicit Profiler(uint32_t generation) : _generation(generation) {}
+
+    static ProfileTimeline* threadTimeline();
+    static void releaseTimeline(uint32_t generation, ProfileTimeline* timeline);
+
+    static void writeCapture();
+
+    friend class ProfileScope;
+    friend struct ProfileThreadHandle;
+public:
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(Profiler &) = delete;
+
+    static void init();
+    static void free();
+
+    // Returns the id of the zone with this name (the same name always gives the same zone)
+    static ProfileZoneId registerZone(const char* name);
+    [[nodiscard]] static size_t numberOfZones();
+    [[nodiscard]] static const char* zoneName(ProfileZoneId zone);
+
+    static ProfileZoneId registerCounter(const char* name);
+    [[nodiscard]] static size_t numberOfCounters();
+    [[nodiscard]] static const char* counterName(ProfileZoneId counter);
+    static void count(ProfileZoneId counter, int64_t value) {
+        if (_instance && _instance->_enabled.load(std::memory_order_relaxed)) {
+            _instance->_counters[counter].fetch_add(value, std::memory_order_relaxed);
+        }
+    }
+
+    static void setEnabled(bool enabled);
+    [[nodiscard]] static bool isEnabled();
+    static void setZoneEnabled(ProfileZoneId zone, bool enabled);
+    [[nodiscard]] static bool isZoneEnabled(ProfileZoneId zone) {
+        return _instance && _instance->_enabled.load(std::memory_order_relaxed) &&
+               _instance->_zoneEnabled[zone].load(std::memory_order_relaxed);
+    }
+
+    // Name of the timeline of the calling thread (threads are named "thread N" by default)
+    static void setThreadName(const std::string& name);
+
+    /*
+     * Collects events of all threads written during the frame and starts the next one.
+     * Should be called by the thread which runs the frame, when no zones of the frame are open.
+     */
+    static void endFrame();
+
+    /*
+     * Records the next 'frames' frames and writes them to the file in Chrome Trace Event format
+     * when the last one ends. stopCapture() writes what was recorded so far.
+     */
+    static void startCapture(uint32_t frames, const FilePath& file);
+    static void stopCapture();
+    [[nodiscard]] static bool isCapturing();
+
+    [[nodiscard]] static uint32_t frame() {
+        return _instance ? _instance->_frame.load(std::memory_order_relaxed) : 0;
+    }
+    [[nodiscard]] static int64_t now() {
+        if (!_instance) {
+            return 0;
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::high_resolution_clock::now() - _instance->_start).count();
+    }
+    // Statistics of the last finished frame indexed by zone id
+    [[nodiscard]] static const std::vector<ProfileZoneStats>& lastFrame();
+    [[nodiscard]] static double lastFrameSeconds(ProfileZoneId zone);
+    [[nodiscard]] static int64_t lastFrameCounter(ProfileZoneId counter);
+};
+
+class ProfileScope final {
+private:
+    ProfileTimeline* _timeline = nullptr;
+    int64_t _start = 0;
+    ProfileZoneId _zone;
+public:
+    explicit ProfileScope(ProfileZoneId zone) : _zone(zone) {
+        if (!Profiler::isZoneEnabled(zone)) {
+            return;
+        }
+        _timeline = Profiler::threadTimeline();
+        if (_timeline->_depth < ProfileTimeline::MAX_DEPTH) {
+            _timeline->_stack[_timeline->_depth] = zone;
+        }
+        _timeline->_depth++;
+        _start = Profiler::now();
+    }
+
+    ~ProfileScope() {
+        if (!_timeline) {
+            return;
+        }
+        int64_t end = Profiler::now();
+
+        uint16_t depth = --_timeline->_depth;
+        ProfileZoneId parent = (depth > 0 && depth <= ProfileTimeline::MAX_DEPTH) ?
+                _timeline->_stack[depth - 1] : Profiler::NO_ZONE;
+
+        uint64_t n = _timeline->_written.load(std::memory_order_relaxed);
+        _timeline->_events[n % ProfileTimeline::CAPACITY] = {_start, end, Profiler::frame(), _zone, parent, depth};
+        _timeline->_written.store(n + 1, std::memory_order_release);
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+// String literal usable as a template argument: every distinct zone name gets its own ProfileZone
+template<size_t N>
+struct ProfileZoneName final {
+    char value[N]{};
+
+    constexpr ProfileZoneName(const char (&name)[N]) {
+        for (size_t i = 0; i < N; i++) {
+            value[i] = name[i];
+        }
+    }
+};
+
+// The id is assigned during the static initialization, before main()
+template<ProfileZoneName name>
+struct ProfileZone final {
+    static inline const ProfileZoneId id = Profiler::registerZone(name.value);
+};
+
+template<ProfileZoneName name>
+struct ProfileCounter final {
+    static inline const ProfileZoneId id = Profiler::registerCounter(name.value);
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifndef DISABLE_PROFILER
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(ProfileZone<name>::id)
+#define PROFILE_COUNT(name, value) Profiler::count(ProfileCounter<name>::id, value)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNT(name, value) ((void)0)
+#endif
+
+#endif //UTILS_PROFILER_H
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <utils/RadixSort.h>
+#include <utils/parallel.h>
+#include <ScalarConsts.h>
+
+namespace {
+    constexpr size_t RADIX_BITS = 8;
+    constexpr size_t BUCKETS = 1 << RADIX_BITS;
+    constexpr size_t PASSES = 32 / RADIX_BITS;
+
+    using Histogram = std::array<size_t, BUCKETS>;
+
+    inline size_t bucket(uint64_t key, size_t pass) {
+        return (key >> (32 + pass*RADIX_BITS)) & (BUCKETS - 1);
+    }
+}
+
+void radixSort(uint64_t* keys, uint64_t* buffer, size_t size) {
+    if (size < 2) {
+        return;
+    }
+
+    size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t numChunks = std::clamp<size_t>(size / Consts::RADIX_SORT_MIN_CHUNK, 1, maxThreads);
+    size_t chunkSize = (size + numChunks - 1) / numChunks;
+
+    // Histograms of every chunk; for the scatter they become the positions where the chunk writes its keys
+    thread_local std::vector<Histogram> threadHistograms;
+    threadHistograms.resize(numChunks);
+    // The workers should use the histograms of this thread, not their own thread_local ones
+    auto& histograms = threadHistograms;
+
+    uint64_t* from = keys;
+    uint64_t* to = buffer;
+
+    for (size_t pass = 0; pass < PASSES; pass++) {
+        parallelFor(0, numChunks, [&](size_t chunkFrom, size_t chunkTo) {
+            for (size_t chunk = chunkFrom; chunk < chunkTo; chunk++) {
+                auto& histogram = histograms[chunk];
+                histogram.fill(0);
+                size_t end = std::min(size, (chunk + 1)*chunkSize);
+                for (size_t i = chunk*chunkSize; i < end; i++) {
+                    histogram[bucket(from[i], pass)]++;
+                }
+            }
+        });
+
+        // Chunks write one after another inside every bucket, so the sort is stable
+        size_t offset = 0;
+        bool trivial = false;
+        for (size_t b = 0; b < BUCKETS; b++) {
+            size_t bucketBegin = offset;
+            for (auto& histogram : histograms) {
+                size_t count = histogram[b];
+                histogram[b] = offset;
+                offset += count;
+            }
+            trivial |= offset - bucketBegin == size;
+        }
+        if (trivial) {
+            continue;
+        }
+
+        parallelFor(0, numChunks, [&](size_t chunkFrom, size_t chunkTo) {
+            for (size_t chunk = chunkFrom; chunk < chunkTo; chunk++) {
+                auto& positions = histograms[chunk];
+                size_t end = std::min(size, (chunk + 1)*chunkSize);
+                for (size_t i = chunk*chunkSize; i < end; i++) {
+                    to[positions[bucket(from[i], pass)]++] = from[i];
+                }
+            }
+        });
+        std::swap(from, to);
+    }
+
+    if (from != keys) {
+        std::copy(from, from + size, keys);
+    }
+}
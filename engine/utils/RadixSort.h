@@ -0,0 +1,27 @@
+#ifndef UTILS_RADIXSORT_H
+#define UTILS_RADIXSORT_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Stable LSD radix sort of 64-bit keys in ascending order of their upper 32 bits. The lower half is carried along
+ * as a payload: usually it is the index of the element, so a list of big records is sorted by its keys
+ * and then permuted once. Four passes of 8 bits; a pass is skipped when all the keys have the same byte.
+ * Big arrays are split between threads (see Consts::RADIX_SORT_MIN_CHUNK).
+ * buffer should have room for size keys; the result is in keys.
+ */
+void radixSort(uint64_t* keys, uint64_t* buffer, size_t size);
+
+// Maps float to uint32_t with the same order (negative values included), so floats can be radix sorted
+[[nodiscard]] inline uint32_t sortableFloat(float value) {
+    auto bits = std::bit_cast<uint32_t>(value);
+    return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+[[nodiscard]] inline uint64_t makeSortKey(uint32_t key, uint32_t index) {
+    return (static_cast<uint64_t>(key) << 32) | index;
+}
+
+#endif //UTILS_RADIXSORT_H
@@ -0,0 +1,55 @@
+#ifndef UTILS_RENDERSTATS_H
+#define UTILS_RENDERSTATS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Counters of one rendered frame. Engine, Camera::project() and Screen add to the stats they were given
+ * (see setRenderStats()), Engine resets them in the beginning of every frame.
+ */
+struct RenderStats final {
+    static constexpr size_t MIP_LEVELS = 16;
+
+    // Objects with a triangle mesh
+    uint64_t objectsVisited = 0;
+    uint64_t objectsFrustumCulled = 0;
+    // Objects skipped together with everything attached to them (see Object::subtreeBounds())
+    uint64_t subtreesFrustumCulled = 0;
+    // Objects hidden behind the occluders (see OcclusionBuffer)
+    uint64_t objectsOcclusionCulled = 0;
+    // Objects drawn with a simplified mesh (see LevelOfDetail)
+    uint64_t objectsSimplified = 0;
+    // Objects outside of the changed part of the screen (see Engine::setIncrementalRendering())
+    uint64_t objectsUnchanged = 0;
+
+    uint64_t trianglesBackfaceCulled = 0;
+    // Triangles cut by the near or the far plane or by the guard band (see Camera::projectInstance())
+    uint64_t trianglesClipped = 0;
+    // Triangles passed to the rasterizer (a clipped triangle can give several of them)
+    uint64_t trianglesEmitted = 0;
+
+    // Pixels covered by the triangles (the depth test was done)
+    uint64_t pixelsTested = 0;
+    // Pixels which passed the depth test and were shaded
+    uint64_t pixelsWritten = 0;
+    uint64_t screenPixels = 0;
+    // Pixels of the changed part of the screen which were drawn again (incremental rendering)
+    uint64_t pixelsRedrawn = 0;
+
+    // Texels fetched from every mip level (anisotropic filtering takes several texels per pixel)
+    std::array<uint64_t, MIP_LEVELS> textureSamples{};
+
+    // Light evaluations: every light for every lit point (vertex or pixel)
+    uint64_t lightsEvaluated = 0;
+
+    void reset() { *this = RenderStats(); }
+
+    // How many times every pixel of the screen was written on average
+    [[nodiscard]] double overdraw() const {
+        return screenPixels > 0 ? static_cast<double>(pixelsWritten) / static_cast<double>(screenPixels) : 0;
+    }
+};
+
+#endif //UTILS_RENDERSTATS_H
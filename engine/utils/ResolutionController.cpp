@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <cmath>
+
+#include <utils/ResolutionController.h>
+
+namespace {
+    // Weight of the last frame in the smoothed frame time
+    constexpr double SMOOTHING = 0.2;
+    // Frames of the new resolution which are skipped: the history of the previous resolution is not valid
+    constexpr uint16_t COOLDOWN_FRAMES = 4;
+    // Frames which are measured before the next decision
+    constexpr uint16_t MIN_SAMPLES = 8;
+    // The scale goes by steps, so the resolution does not change by one pixel every few frames
+    constexpr double SCALE_STEP = 1.0 / 32;
+}
+
+ResolutionController::ResolutionController(double budget, double minScale, double maxScale) :
+    _budget(budget), _minScale(minScale), _maxScale(maxScale), _scale(maxScale) {}
+
+void ResolutionController::setScaleLimits(double minScale, double maxScale) {
+    _minScale = minScale;
+    _maxScale = maxScale;
+    reset();
+}
+
+void ResolutionController::reset() {
+    _scale = _maxScale;
+    _frameTime = 0;
+    _samples = 0;
+    _cooldown = 0;
+}
+
+double ResolutionController::update(double frameSeconds) {
+    if (_cooldown > 0) {
+        _cooldown--;
+        return _scale;
+    }
+
+    _frameTime = _samples == 0 ? frameSeconds : _frameTime + (frameSeconds - _frameTime) * SMOOTHING;
+    // The counter stops at MIN_SAMPLES: while the scale is stable it would wrap and reset the smoothed time
+    _samples = std::min<uint16_t>(_samples + 1, MIN_SAMPLES);
+    if (_samples < MIN_SAMPLES) {
+        return _scale;
+    }
+    if (_frameTime <= _budget && _frameTime >= _budget * (1 - Consts::RESOLUTION_HEADROOM)) {
+        return _scale;
+    }
+
+    // We aim at the middle of the band, so the next frames do not go out of it again right away
+    double target = _budget * (1 - Consts::RESOLUTION_HEADROOM / 2);
+    double scale = _scale * std::sqrt(target / std::max(_frameTime, Consts::EPS));
+    scale = std::clamp(std::round(scale / SCALE_STEP) * SCALE_STEP, _minScale, _maxScale);
+
+    if (scale != _scale) {
+        _scale = scale;
+        _frameTime = 0;
+        _samples = 0;
+        _cooldown = COOLDOWN_FRAMES;
+    }
+    return _scale;
+}
@@ -0,0 +1,42 @@
+#ifndef UTILS_RESOLUTIONCONTROLLER_H
+#define UTILS_RESOLUTIONCONTROLLER_H
+
+#include <cstdint>
+
+#include <ScalarConsts.h>
+
+/*
+ * Dynamic resolution policy: chooses the scale of the internal resolution of the scene, so the frame
+ * fits into the budget. Most of the frame time is proportional to the number of pixels, so the scale
+ * follows the square root of budget / frame time. The frame time is smoothed and the scale
+ * does not change while the frame is between (1 - Consts::RESOLUTION_HEADROOM) * budget and the budget.
+ * After a change the controller waits for a few frames of the new resolution before it measures again.
+ */
+class ResolutionController final {
+private:
+    double _budget;
+    double _minScale;
+    double _maxScale;
+
+    double _scale = 1;
+    double _frameTime = 0; // smoothed over the frames of the current scale
+    uint16_t _samples = 0;
+    uint16_t _cooldown = 0;
+public:
+    explicit ResolutionController(double budget = Consts::RESOLUTION_FRAME_BUDGET,
+                                  double minScale = Consts::RESOLUTION_MIN_SCALE, double maxScale = 1.0);
+
+    // Frame time in seconds without waiting for the display. Returns the scale for the next frame
+    double update(double frameSeconds);
+
+    void setBudget(double seconds) { _budget = seconds; }
+    void setScaleLimits(double minScale, double maxScale);
+    // Starts over from the biggest scale (the measurements are dropped)
+    void reset();
+
+    [[nodiscard]] double budget() const { return _budget; }
+    [[nodiscard]] double scale() const { return _scale; }
+    [[nodiscard]] double frameTime() const { return _frameTime; }
+};
+
+#endif //UTILS_RESOLUTIONCONTROLLER_H
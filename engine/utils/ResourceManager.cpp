@@ -7,6 +7,8 @@
 
 #include <utils/ResourceManager.h>
 #include <utils/Log.h>
+#include <utils/Memory.h>
+#include <components/geometry/LevelOfDetail.h>
 
 ResourceManager *ResourceManager::_instance = nullptr;
 
@@ -23,12 +25,13 @@ void ResourceManager::init() {
 }
 
 std::map<MaterialTag, std::shared_ptr<Material>> ResourceManager::loadMaterials(const FilePath &mtlFile) {
+    MEMORY_TAG(Textures);
 
     std::map<MaterialTag, std::shared_ptr<Material>> materials;
 
     std::ifstream file(mtlFile.str());
     if (!file.is_open()) {
-        Log::log("ResourceManager::loadMaterials(): cannot open '" + mtlFile.str() + "'");
+        LOG_ERROR("ResourceManager::loadMaterials(): cannot open '" + mtlFile.str() + "'");
         return materials;
     }
 
@@ -125,7 +128,16 @@ std::map<MaterialTag, std::shared_ptr<Material>> ResourceManager::loadMaterials(
     return materials;
 }
 
-std::shared_ptr<Group> ResourceManager::loadTriangleMesh(const ObjectTag &tag, const FilePath &meshFile) {
+void ResourceManager::addLevelsOfDetail(Group &objects) {
+    for (const auto& [objTag, obj] : objects) {
+        if (obj->hasComponent<TriangleMesh>() && !obj->hasComponent<LevelOfDetail>()) {
+            obj->addComponent<LevelOfDetail>();
+        }
+    }
+}
+
+std::shared_ptr<Group> ResourceManager::loadTriangleMesh(const ObjectTag &tag, const FilePath &meshFile, bool levelsOfDetail) {
+    MEMORY_TAG(Meshes);
 
     if (_instance == nullptr) {
         return nullptr;
@@ -138,12 +150,15 @@ std::shared_ptr<Group> ResourceManager::loadTriangleMesh(const ObjectTag &tag, c
     // If objects is already loaded - return pointer to it
     auto it = _instance->_objects.find(meshFile);
     if (it != _instance->_objects.end()) {
+        if (levelsOfDetail) {
+            addLevelsOfDetail(*it->second);
+        }
         return std::make_shared<Group>(tag, *it->second);
     }
 
     std::ifstream file(meshFile.str());
     if (!file.is_open()) {
-        Log::log("ResourceManager::loadObjects(): cannot open '" + meshFile.str() + "'");
+        LOG_ERROR("ResourceManager::loadObjects(): cannot open '" + meshFile.str() + "'");
         return objects;
     }
 
@@ -260,6 +275,10 @@ std::shared_ptr<Group> ResourceManager::loadTriangleMesh(const ObjectTag &tag, c
     file.close();
     Log::log("ResourceManager::LoadObjects(): obj '" + meshFile.str() + "' was loaded");
 
+    if (levelsOfDetail) {
+        addLevelsOfDetail(*objects);
+    }
+
     // If success - remember and return vector of objects pointer
     _instance->_objects.emplace(meshFile, objects);
 
@@ -23,6 +23,9 @@ private:
     static void unloadFonts();
     static void unloadAllResources();
 
+    // Adds LevelOfDetail to the meshes of the group which do not have it yet
+    static void addLevelsOfDetail(Group& objects);
+
     // For now this function is only used in ResourceManager::loadObjects(), if it will be necessary
     // we can move it to the public domain.
     static std::map<MaterialTag, std::shared_ptr<Material>> loadMaterials(const FilePath &mtlFile);
@@ -39,7 +42,8 @@ public:
     // This function tries to load texture from the .obj file.
     // If it succeeded - the function returns a pointer to the texture.
     // Otherwise, it returns a nullptr.
-    static std::shared_ptr<Group> loadTriangleMesh(const ObjectTag &tag, const FilePath &meshFile);
+    // With levelsOfDetail the meshes get simplified levels (see LevelOfDetail): they are generated once for the file.
+    static std::shared_ptr<Group> loadTriangleMesh(const ObjectTag &tag, const FilePath &meshFile, bool levelsOfDetail = false);
 
     static std::shared_ptr<Font> loadFont(const FilePath &fontFile);
 };
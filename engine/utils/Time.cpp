@@ -1,6 +1,7 @@
 #include <utils/Time.h>
 #include <utils/Log.h>
 #include <Consts.h>
+#include <iomanip>
 #include <sstream>
 
 using namespace std::chrono;
@@ -46,8 +47,13 @@ void Time::update() {
 
     high_resolution_clock::time_point t = high_resolution_clock::now();
 
-    _instance->_deltaTime = duration<double>(t - _instance->_last).count();
-    _instance->_time = duration<double>(t - _instance->_start).count();
+    if (_instance->_frameStep > 0) {
+        _instance->_deltaTime = _instance->_frameStep;
+        _instance->_time += _instance->_frameStep;
+    } else {
+        _instance->_deltaTime = duration<double>(t - _instance->_last).count();
+        _instance->_time = duration<double>(t - _instance->_start).count();
+    }
     _instance->_last = t;
 
     _instance->_fpsCounter++;
@@ -68,60 +74,8 @@ unsigned int Time::fps() {
     return _instance->_lastFps;
 }
 
-void Time::startTimer(const std::string &timerName) {
-    if (!_instance) {
-        return;
-    }
-
-    if(!_instance->_timers.contains(timerName)) {
-        _instance->_timers.insert({timerName, Timer()});
-    }
-    _instance->_timers[timerName].start();
-}
-
-void Time::pauseTimer(const std::string &timerName) {
-    if (!_instance) {
-        return;
-    }
-    if(_instance->_timers.contains(timerName)) {
-        _instance->_timers[timerName].pause();
-    }
-}
-
-void Time::stopTimer(const std::string &timerName) {
-    if (!_instance) {
-        return;
-    }
-    if(_instance->_timers.contains(timerName)) {
-        _instance->_timers[timerName].stop();
-    }
-}
-
-double Time::elapsedTimerMilliseconds(const std::string &timerName) {
-    if (!_instance) {
-        return 0;
-    }
-    if(_instance->_timers.count(timerName) > 0) {
-        return _instance->_timers[timerName].elapsedMilliseconds();
-    }
-    return 0;
-}
-
-double Time::elapsedTimerSeconds(const std::string &timerName) {
-    if (!_instance) {
-        return 0;
-    }
-    if(_instance->_timers.count(timerName) > 0) {
-        return _instance->_timers[timerName].elapsedSeconds();
-    }
-    return 0;
-}
-
-
 void Time::free() {
     if(_instance) {
-        _instance->_timers.clear();
-
         delete _instance;
         _instance = nullptr;
     }
@@ -129,14 +83,6 @@ void Time::free() {
     Log::log("Time::free(): pointer to 'Time' was freed");
 }
 
-std::optional<std::reference_wrapper<const std::map<std::string, Timer>>> Time::timers() {
-    if (!_instance) {
-        return {};
-    }
-
-    return {_instance->_timers};
-}
-
 std::string Time::getLocalTimeInfo(const std::string &format) {
     std::time_t const now_c = std::time(nullptr);
     auto dt = std::put_time(std::localtime(&now_c), format.c_str());
@@ -160,3 +106,11 @@ void Time::setFixedUpdateInterval(double fixedDeltaTime) {
 
     _instance->_fixedDeltaTime = fixedDeltaTime;
 }
+
+void Time::setFrameStep(double frameStep) {
+    if (!_instance) {
+        return;
+    }
+
+    _instance->_frameStep = frameStep;
+}
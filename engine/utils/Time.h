@@ -2,18 +2,12 @@
 #define UTILS_TIME_H
 
 #include <chrono>
-#include <map>
-#include <optional>
-#include <functional>
 #include <string>
 
-#include <utils/Timer.h>
 #include <Consts.h>
 
 class Time final {
 private:
-    std::map<std::string, Timer> _timers;
-
     // High precision time
     std::chrono::high_resolution_clock::time_point _start = std::chrono::high_resolution_clock::now();
     std::chrono::high_resolution_clock::time_point _last = _start;
@@ -28,6 +22,8 @@ private:
     double _deltaTime = 0;
     unsigned int _frame = 0;
     double _fixedDeltaTime = Consts::FIXED_UPDATE_INTERVAL;
+    // When it is positive, time goes by this step every frame regardless of the real time
+    double _frameStep = 0;
 
     static Time *_instance;
 
@@ -42,20 +38,15 @@ public:
     static void init();
     static void free();
 
-    static void startTimer(const std::string& timerName);
-    static void stopTimer(const std::string& timerName);
-    static void pauseTimer(const std::string& timerName);
-
     static void setFixedUpdateInterval(double fixedDeltaTime);
+    // Makes the simulation reproducible (benchmarks): every frame advances time by frameStep seconds. 0 is the real time.
+    static void setFrameStep(double frameStep);
 
     [[nodiscard]] static unsigned int fps();
     [[nodiscard]] static double time();
     [[nodiscard]] static unsigned int frame();
     [[nodiscard]] static double deltaTime();
     [[nodiscard]] static double fixedDeltaTime();
-    [[nodiscard]] static double elapsedTimerMilliseconds(const std::string& timerName);
-    [[nodiscard]] static double elapsedTimerSeconds(const std::string& timerName);
-    [[nodiscard]] static std::optional<std::reference_wrapper<const std::map<std::string, Timer>>> timers();
 
     [[nodiscard]] static std::string getLocalTimeInfo(const std::string& format = "%F %T");
 };
@@ -1,9 +1,12 @@
 #include <utils/ResourceManager.h>
 #include <utils/WorldEditor.h>
 #include <utils/Log.h>
+#include <utils/Profiler.h>
+#include <utils/Memory.h>
 #include <io/Keyboard.h>
 #include <io/Mouse.h>
 #include <components/lighting/SpotLight.h>
+#include <components/lighting/DirectionalLight.h>
 
 #include <utility>
 
@@ -176,6 +179,7 @@ void WorldEditor::controlPanel() {
 
             mu_text(ctx, "Press 'f1' to make a screenshot");
             mu_text(ctx, "Press 'f2' to start/end screen recording");
+            mu_text(ctx, "Press 'f3' to capture a profiler trace");
 
             mu_end_treenode(ctx);
         }
@@ -402,6 +406,11 @@ void WorldEditor::lightSourceEditor() {
 
         lightSource->setColor(Color(color[0], color[1], color[2]));
 
+        if(_selectedObject->getComponent<SpotLight>() || _selectedObject->getComponent<DirectionalLight>()) {
+            bool castShadows = lightSource->castShadows();
+            mu_checkbox(ctx, "Cast shadows", &castShadows);
+            lightSource->setCastShadows(castShadows);
+        }
 
         auto spotLight = _selectedObject->getComponent<SpotLight>();
         if(spotLight) { // If this light is a spotlight
@@ -546,9 +555,14 @@ void WorldEditor::renderSettings() {
     if (mu_begin_treenode(ctx, "Render Settings")) {
 
         mu_checkbox(ctx, "Transparent objects", &_enableTransparency);
+        mu_checkbox(ctx, "Order independent transparency", &_enableOrderIndependentTransparency);
         mu_checkbox(ctx, "Borders of triangles", &_enableTriangleBorders);
         mu_checkbox(ctx, "Texturing", &_enableTexturing);
         mu_checkbox(ctx, "Texture antialiasing (mipmapping)", &_enableMipmapping);
+        mu_layout_begin_column(ctx);
+        mu_layout_row(ctx, 2, (int[]) { 70, 150 }, 0);
+        mu_label(ctx, "Anisotropy"); mu_slider(ctx, &_maxAnisotropy, 1, 16);
+        mu_layout_end_column(ctx);
         mu_checkbox(ctx, "Depth test", &_enableDepthTest);
 
         if (mu_begin_treenode(ctx, "Lighting")) {
@@ -572,9 +586,11 @@ void WorldEditor::updateScreenSettings() {
     _screen->setLighting(_enableLighting);
     _screen->setTrueLighting(_enableTrueLighting);
     _screen->setTransparency(_enableTransparency);
+    _screen->setOrderIndependentTransparency(_enableOrderIndependentTransparency);
     _screen->setTriangleBorders(_enableTriangleBorders);
     _screen->setTexturing(_enableTexturing);
     _screen->setMipmapping(_enableMipmapping);
+    _screen->setMaxAnisotropy(static_cast<uint16_t>(_maxAnisotropy));
     _screen->setDepthTest(_enableDepthTest);
     _screen->setLightingLODNearDistance(_lightingLODNearDistance);
     _screen->setLightingLODFarDistance(_lightingLODFarDistance);
@@ -636,6 +652,11 @@ void WorldEditor::updateControllers() {
         _isRecording = !_isRecording;
     }
 
+    if(Keyboard::isKeyTapped(SDLK_F3) && !Profiler::isCapturing()) {
+        Profiler::startCapture(Consts::TRACE_CAPTURE_FRAMES,
+                               FilePath("trace_" + Time::getLocalTimeInfo("%F_%H-%M-%S") + ".json"));
+    }
+
     if(_selectedObject && _selectedObject->getComponent<TriangleMesh>()) {
         _selectedObjectBounds->getComponent<LineMesh>()->setVisible(true);
         _selectedObjectBounds->getComponent<TransformMatrix>()->undoTransformations();
@@ -685,6 +706,7 @@ void WorldEditor::updateControllers() {
 }
 
 void WorldEditor::update() {
+    MEMORY_TAG(GUI);
 
     if(!_isControllerActive) {
         handleInputEvents();
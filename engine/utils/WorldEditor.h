@@ -29,6 +29,7 @@ private:
     bool _enableLighting = true;
     bool _enableTrueLighting = false;
     bool _enableTransparency = true;
+    bool _enableOrderIndependentTransparency = false;
     bool _enableTriangleBorders = false;
     bool _enableTexturing = true;
     bool _enableMipmapping = true;
@@ -43,6 +44,7 @@ private:
 
     float _lightingLODNearDistance = Consts::LIGHTING_LOD_NEAR_DISTANCE;
     float _lightingLODFarDistance = Consts::LIGHTING_LOD_FAR_DISTANCE;
+    float _maxAnisotropy = 1;
 
     void handleInputEvents();
     void drawUiIcon(int id, uint16_t x, uint16_t y);
@@ -16,10 +16,10 @@ int getProcessSizeMB() {
 #include <fstream>
 int getProcessSizeMB() {
     std::ifstream statmFile("/proc/self/statm");
-    long pageSizeMB = sysconf(_SC_PAGESIZE) / Consts::MB;
+    long pageSize = sysconf(_SC_PAGESIZE);
     unsigned long vmSize, residentSize;
     if (statmFile >> vmSize >> residentSize) {
-        return residentSize * pageSizeMB;
+        return static_cast<int>(residentSize * pageSize / Consts::MB);
     }
     return -1;
 }
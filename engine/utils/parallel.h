@@ -0,0 +1,46 @@
+#ifndef UTILS_PARALLEL_H
+#define UTILS_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*
+ * Splits [begin, end) into contiguous chunks and calls func(chunkBegin, chunkEnd) for each of them.
+ * Every chunk except the last one runs in its own thread, the last one runs in the calling thread.
+ * Ranges smaller than 2*minChunk are processed without spawning any threads at all.
+ */
+template<typename Func>
+void parallelFor(size_t begin, size_t end, Func&& func, size_t minChunk = 1) {
+    if (end <= begin) {
+        return;
+    }
+
+    size_t size = end - begin;
+    size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t numChunks = std::min(maxThreads, size / std::max<size_t>(minChunk, 1));
+
+    if (numChunks <= 1) {
+        func(begin, end);
+        return;
+    }
+
+    size_t chunkSize = (size + numChunks - 1) / numChunks;
+
+    std::vector<std::thread> workers;
+    workers.reserve(numChunks - 1);
+
+    size_t chunkBegin = begin;
+    for (size_t i = 0; i < numChunks - 1 && chunkBegin + chunkSize < end; i++) {
+        workers.emplace_back([&func, chunkBegin, chunkSize] { func(chunkBegin, chunkBegin + chunkSize); });
+        chunkBegin += chunkSize;
+    }
+    func(chunkBegin, end);
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+#endif //UTILS_PARALLEL_H
@@ -22,7 +22,8 @@ private:
         for (int i = 1; i <= 8; i++) {
             auto car = world->loadObject(
                     ObjectTag("car"+std::to_string(i)),
-                    FilePath("resources/obj/cars/car"+std::to_string(i)+"/Car"+std::to_string(i)+".obj"));
+                    FilePath("resources/obj/cars/car"+std::to_string(i)+"/Car"+std::to_string(i)+".obj"),
+                    Vec3D{1, 1, 1}, true);
             car->getComponent<TransformMatrix>()->rotate(Vec3D{0, Consts::PI, 0});
             car->getComponent<TransformMatrix>()->translate(Vec3D(-13.5 + 3*i, -4, 13));
         }